@@ -0,0 +1,374 @@
+// Parser / grid throughput benchmark
+//
+// Replays byte corpora through process_output_bytes on a headless grid and reports
+// throughput, time per byte and the allocations made while parsing. The built-in corpora
+// are generated from a fixed seed so runs are comparable; files given on the command
+// line (for example captured `script` output) are replayed as extra corpora. Session logs
+// written by `mag-terminal --record` are replayed with their original read boundaries.
+
+#include "globals.h"
+#include "terminal_logic.h"
+#include "session_log.h"
+#include "utf8.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAGTERM_BENCH_COUNT_ALLOCS
+#include <stdatomic.h>
+
+// Linked with -Wl,--wrap so every allocation made by magterm_core passes through here
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+static atomic_size_t alloc_count;
+static atomic_size_t alloc_bytes;
+
+static void count_alloc(size_t bytes) {
+    atomic_fetch_add_explicit(&alloc_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&alloc_bytes, bytes, memory_order_relaxed);
+}
+
+void* __wrap_malloc(size_t size) {
+    count_alloc(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    count_alloc(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    count_alloc(size);
+    return __real_realloc(ptr, size);
+}
+#endif
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} Corpus;
+
+static void corpus_put(Corpus* c, const char* bytes, size_t n) {
+    if (c->len + n > c->cap) {
+        size_t cap = c->cap ? c->cap : 1 << 20;
+        while (cap < c->len + n) cap *= 2;
+        char* data = realloc(c->data, cap);
+        if (!data) {
+            fprintf(stderr, "Corpus could not be allocated");
+            abort();
+        }
+        c->data = data;
+        c->cap = cap;
+    }
+    memcpy(c->data + c->len, bytes, n);
+    c->len += n;
+}
+
+static void corpus_printf(Corpus* c, const char* fmt, ...) {
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n > 0) corpus_put(c, buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+static void corpus_utf8(Corpus* c, uint32_t cp) {
+    char s[4];
+    corpus_put(c, s, (size_t)utf8_encode(cp, s));
+}
+
+// xorshift64*, fixed seed per corpus
+static uint64_t rng_state;
+
+static uint32_t rng(uint32_t bound) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 32) % bound;
+}
+
+static void put_word(Corpus* c) {
+    char word[16];
+    int len = 1 + (int)rng(10);
+    for (int i = 0; i < len; i++) word[i] = (char)('a' + rng(26));
+    corpus_put(c, word, (size_t)len);
+}
+
+// Plain prose: printable ASCII lines of varying length
+static void gen_ascii(Corpus* c, size_t size) {
+    while (c->len < size) {
+        int words = 3 + (int)rng(18);
+        for (int i = 0; i < words; i++) {
+            put_word(c);
+            corpus_put(c, " ", 1);
+        }
+        corpus_put(c, "\r\n", 2);
+    }
+}
+
+// Syntax-highlighter / ls --color style output: an SGR change every word or two
+static void gen_sgr(Corpus* c, size_t size) {
+    while (c->len < size) {
+        int words = 3 + (int)rng(12);
+        for (int i = 0; i < words; i++) {
+            switch (rng(6)) {
+                case 0: corpus_printf(c, "\x1b[%d;3%um", 1 + (int)rng(2), rng(8)); break;
+                case 1: corpus_printf(c, "\x1b[38;5;%um", rng(256)); break;
+                case 2: corpus_printf(c, "\x1b[38;2;%u;%u;%um", rng(256), rng(256), rng(256)); break;
+                case 3: corpus_printf(c, "\x1b[48;5;%u;9%um", rng(256), rng(8)); break;
+                case 4: corpus_printf(c, "\x1b[4:3;58:2::%u:%u:%um", rng(256), rng(256), rng(256)); break;
+                default: corpus_put(c, "\x1b[0m", 4); break;
+            }
+            put_word(c);
+            corpus_put(c, " ", 1);
+        }
+        corpus_put(c, "\x1b[0m\r\n", 6);
+    }
+}
+
+// Full-screen application redraws (top, htop, editors): cursor addressing, erase in line,
+// reverse-video status bars and small scattered updates inside synchronized frames
+static void gen_tui(Corpus* c, size_t size, int cols, int rows) {
+    int frame = 0;
+    while (c->len < size) {
+        corpus_put(c, "\x1b[?2026h", 8);
+        if (frame % 50 == 0) {
+            corpus_put(c, "\x1b[H\x1b[2J", 7);
+            for (int row = 1; row <= rows; row++) {
+                corpus_printf(c, "\x1b[%d;1H", row);
+                if (row == 1 || row == rows) corpus_put(c, "\x1b[7m", 4);
+                for (int col = 0; col < cols - 10; col += 8) put_word(c), corpus_put(c, " ", 1);
+                corpus_put(c, "\x1b[K\x1b[0m", 7);
+            }
+        } else {
+            int updates = 10 + (int)rng(30);
+            for (int i = 0; i < updates; i++) {
+                corpus_printf(c, "\x1b[%u;%uH\x1b[3%um%5.1f\x1b[0m", 2 + rng((uint32_t)rows - 2),
+                              1 + rng((uint32_t)cols - 6), rng(8), rng(1000) / 10.0);
+            }
+            corpus_printf(c, "\x1b[%d;1H\x1b[7m frame %d \x1b[K\x1b[0m", rows, frame);
+        }
+        corpus_put(c, "\x1b[?2026l", 8);
+        frame++;
+    }
+}
+
+// Log flood (tail -f, cat of a large file): long lines that wrap and scroll the screen
+static void gen_scroll(Corpus* c, size_t size) {
+    static const char* levels[] = {"INFO", "DEBUG", "WARN", "ERROR"};
+    unsigned long id = 0;
+    while (c->len < size) {
+        corpus_printf(c, "2026-10-17 %02u:%02u:%02u.%03u %-5s worker[%u]: request id=%lu path=/api/v1/",
+                      rng(24), rng(60), rng(60), rng(1000), levels[rng(4)], rng(64), id++);
+        int words = 2 + (int)rng(30);
+        for (int i = 0; i < words; i++) {
+            put_word(c);
+            corpus_put(c, "/", 1);
+        }
+        corpus_printf(c, " status=%u latency=%ums\r\n", 200 + rng(300), rng(5000));
+    }
+}
+
+// CJK text with emoji, the multi-byte UTF-8 path
+static void gen_unicode(Corpus* c, size_t size) {
+    while (c->len < size) {
+        int chars = 5 + (int)rng(35);
+        for (int i = 0; i < chars; i++) {
+            uint32_t kind = rng(10);
+            if (kind < 6) corpus_utf8(c, 0x4E00 + rng(0x5200));
+            else if (kind < 8) corpus_utf8(c, 0x1F300 + rng(0x350));
+            else if (kind < 9) corpus_utf8(c, 0x3040 + rng(0x60));
+            else corpus_put(c, " ", 1);
+        }
+        corpus_put(c, "\r\n", 2);
+    }
+}
+
+static int load_file(Corpus* c, const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) corpus_put(c, buf, n);
+    fclose(f);
+    return 1;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    double seconds;
+    size_t allocs;
+    size_t alloc_bytes;
+} RunResult;
+
+// Feed the corpus in chunk-sized reads, like the PTY loop does, into a fresh grid
+static RunResult run_once(const Corpus* c, size_t chunk, int cols, int rows) {
+    TerminalGrid grid = createTerminalGrid(cols, rows);
+    ParserState state = {0};
+    RunResult result = {0};
+
+#ifdef MAGTERM_BENCH_COUNT_ALLOCS
+    size_t count_before = atomic_load(&alloc_count);
+    size_t bytes_before = atomic_load(&alloc_bytes);
+#endif
+    double start = now_seconds();
+    for (size_t off = 0; off < c->len; off += chunk) {
+        size_t n = c->len - off < chunk ? c->len - off : chunk;
+        process_output_bytes(&grid, c->data + off, (ssize_t)n, &state);
+    }
+    result.seconds = now_seconds() - start;
+#ifdef MAGTERM_BENCH_COUNT_ALLOCS
+    result.allocs = atomic_load(&alloc_count) - count_before;
+    result.alloc_bytes = atomic_load(&alloc_bytes) - bytes_before;
+#endif
+
+    freeGrid(&grid);
+    return result;
+}
+
+// Replay the output and resize records of a session log on a grid of the recorded size
+static RunResult run_session(const char* path, size_t* bytes) {
+    RunResult result = {0};
+    SessionReplay* replay = session_replay_open(path, 0);
+    if (!replay) return result;
+    int cols, rows;
+    session_replay_size(replay, &cols, &rows);
+    TerminalGrid grid = createTerminalGrid(cols, rows);
+    ParserState state = {0};
+    SessionRecord record;
+    *bytes = 0;
+
+#ifdef MAGTERM_BENCH_COUNT_ALLOCS
+    size_t count_before = atomic_load(&alloc_count);
+    size_t bytes_before = atomic_load(&alloc_bytes);
+#endif
+    double start = now_seconds();
+    while (session_replay_next(replay, 0, &record)) {
+        if (record.kind == SESSION_OUTPUT) {
+            process_output_bytes(&grid, record.data, (ssize_t)record.len, &state);
+            *bytes += record.len;
+        } else if (record.kind == SESSION_RESIZE) {
+            grid_resize(&grid, &state, record.cols, record.rows);
+        }
+    }
+    result.seconds = now_seconds() - start;
+#ifdef MAGTERM_BENCH_COUNT_ALLOCS
+    result.allocs = atomic_load(&alloc_count) - count_before;
+    result.alloc_bytes = atomic_load(&alloc_bytes) - bytes_before;
+#endif
+
+    freeGrid(&grid);
+    session_replay_close(replay);
+    return result;
+}
+
+static void print_result(const char* name, size_t bytes, RunResult best) {
+    double mb = bytes / (1024.0 * 1024.0);
+    if (best.seconds <= 0) best.seconds = 1e-9;
+#ifdef MAGTERM_BENCH_COUNT_ALLOCS
+    printf("%-12s %9.1f %10.1f %9.2f %10zu %10.1f\n", name, mb, mb / best.seconds,
+           best.seconds * 1e9 / (double)bytes, best.allocs, best.alloc_bytes / (1024.0 * 1024.0));
+#else
+    printf("%-12s %9.1f %10.1f %9.2f %10s %10s\n", name, mb, mb / best.seconds,
+           best.seconds * 1e9 / (double)bytes, "n/a", "n/a");
+#endif
+}
+
+static void report(const char* name, const Corpus* c, int iterations, size_t chunk, int cols, int rows) {
+    RunResult best = {0};
+    for (int i = 0; i < iterations; i++) {
+        RunResult r = run_once(c, chunk, cols, rows);
+        if (i == 0 || r.seconds < best.seconds) best = r;
+    }
+    print_result(name, c->len, best);
+}
+
+static void report_session(const char* name, const char* path, int iterations) {
+    RunResult best = {0};
+    size_t bytes = 0;
+    for (int i = 0; i < iterations; i++) {
+        RunResult r = run_session(path, &bytes);
+        if (i == 0 || r.seconds < best.seconds) best = r;
+    }
+    if (bytes > 0) print_result(name, bytes, best);
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "Usage: %s [--size MB] [--iterations N] [--chunk BYTES] [--cols N] [--rows N] [--scrollback-mb N] [FILE...]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    size_t size = 16u << 20;
+    int iterations = 3;
+    size_t chunk = 4096;
+    int cols = 80, rows = 24;
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+        if (strcmp(arg, "--size") == 0 && has_value) size = (size_t)strtoul(argv[++i], NULL, 10) << 20;
+        else if (strcmp(arg, "--iterations") == 0 && has_value) iterations = atoi(argv[++i]);
+        else if (strcmp(arg, "--chunk") == 0 && has_value) chunk = (size_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--cols") == 0 && has_value) cols = atoi(argv[++i]);
+        else if (strcmp(arg, "--rows") == 0 && has_value) rows = atoi(argv[++i]);
+        else if (strcmp(arg, "--scrollback-mb") == 0 && has_value) scrollbackBudgetMB = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (arg[0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+    if (size == 0 || iterations < 1 || chunk == 0 || cols < 10 || rows < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%dx%d grid, %zu byte reads, %u MB scrollback budget, best of %d\n", cols, rows, chunk,
+           scrollbackBudgetMB, iterations);
+    printf("%-12s %9s %10s %9s %10s %10s\n", "corpus", "MB", "MB/s", "ns/byte", "allocs", "alloc MB");
+
+    static const char* names[] = {"ascii", "sgr", "tui", "scroll", "unicode"};
+    for (int k = 0; k < 5; k++) {
+        Corpus c = {0};
+        rng_state = 0x9E3779B97F4A7C15ULL + (uint64_t)k;
+        switch (k) {
+            case 0: gen_ascii(&c, size); break;
+            case 1: gen_sgr(&c, size); break;
+            case 2: gen_tui(&c, size, cols, rows); break;
+            case 3: gen_scroll(&c, size); break;
+            default: gen_unicode(&c, size); break;
+        }
+        report(names[k], &c, iterations, chunk, cols, rows);
+        free(c.data);
+    }
+
+    for (int i = first_file; i < argc; i++) {
+        Corpus c = {0};
+        if (load_file(&c, argv[i]) && c.len > 0) {
+            const char* base = strrchr(argv[i], '/');
+            const char* name = base ? base + 1 : argv[i];
+            if (c.len >= 8 && memcmp(c.data, SESSION_LOG_MAGIC, 8) == 0) report_session(name, argv[i], iterations);
+            else report(name, &c, iterations, chunk, cols, rows);
+        }
+        free(c.data);
+    }
+    return 0;
+}
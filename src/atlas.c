@@ -0,0 +1,242 @@
+#include "atlas.h"
+#include <glad/glad.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Empty texels kept around every glyph so linear filtering never picks up a neighbour
+#define ATLAS_PADDING 1
+
+typedef struct {
+    int y;          // top of the shelf
+    int height;
+    int x;          // first free column
+} Shelf;
+
+typedef struct {
+    GLuint texture;
+    Shelf* shelves;
+    int shelf_count;
+    int shelf_cap;
+    int next_y;     // top of the space not yet cut into shelves
+    int pinned;     // never reset, holds glyphs that are not in the glyph cache
+    unsigned char* staging;  // CPU copy of a page created during a batch, uploaded at its end
+} AtlasPage;
+
+struct GlyphAtlas {
+    int size;
+    int max_pages;
+    int batching;
+    AtlasPage* pages;
+    int page_count;
+    int page_cap;
+};
+
+GlyphAtlas* atlas_create(int page_size, int max_pages) {
+    GlyphAtlas* atlas = calloc(1, sizeof(GlyphAtlas));
+    if (!atlas) {
+        fprintf(stderr, "Glyph atlas could not be allocated");
+        abort();
+    }
+    atlas->size = page_size;
+    atlas->max_pages = max_pages;
+    return atlas;
+}
+
+void atlas_destroy(GlyphAtlas* atlas) {
+    if (!atlas) return;
+    for (int i = 0; i < atlas->page_count; i++) {
+        glDeleteTextures(1, &atlas->pages[i].texture);
+        free(atlas->pages[i].shelves);
+        free(atlas->pages[i].staging);
+    }
+    free(atlas->pages);
+    free(atlas);
+}
+
+int atlas_page_count(const GlyphAtlas* atlas) {
+    return atlas->page_count;
+}
+
+// Uploads leave the renderer's texture binding as they found it
+static GLuint current_binding(void) {
+    GLint bound = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+    return (GLuint)bound;
+}
+
+static unsigned char* zeroed_page(const GlyphAtlas* atlas) {
+    unsigned char* zero = calloc((size_t)atlas->size * (size_t)atlas->size, 1);
+    if (!zero) {
+        fprintf(stderr, "Glyph atlas could not be allocated");
+        abort();
+    }
+    return zero;
+}
+
+static AtlasPage* add_page(GlyphAtlas* atlas) {
+    if (atlas->page_count == atlas->page_cap) {
+        int cap = atlas->page_cap ? atlas->page_cap * 2 : 4;
+        AtlasPage* pages = realloc(atlas->pages, sizeof(AtlasPage) * (size_t)cap);
+        if (!pages) {
+            fprintf(stderr, "Glyph atlas could not be allocated");
+            abort();
+        }
+        atlas->pages = pages;
+        atlas->page_cap = cap;
+    }
+    AtlasPage* page = &atlas->pages[atlas->page_count++];
+    *page = (AtlasPage){0};
+
+    // Start from zeroed texels so the padding around glyphs is transparent. In a batch the
+    // zeroed staging copy is uploaded at the end, with the glyphs already in it.
+    unsigned char* zero = zeroed_page(atlas);
+    GLuint previous = current_binding();
+    glGenTextures(1, &page->texture);
+    glBindTexture(GL_TEXTURE_2D, page->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas->size, atlas->size, 0, GL_RED, GL_UNSIGNED_BYTE, atlas->batching ? NULL : zero);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // Bitmaps are drawn 1:1 at whole pixels, where this samples texel centres exactly;
+    // distance fields are drawn magnified and need the interpolation
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, previous);
+    if (atlas->batching) page->staging = zero;
+    else free(zero);
+    return page;
+}
+
+// Best-fit shelf on a page for a w x h box, opening a new shelf if none fits
+static Shelf* place_on_page(GlyphAtlas* atlas, AtlasPage* page, int w, int h) {
+    Shelf* best = NULL;
+    for (int i = 0; i < page->shelf_count; i++) {
+        Shelf* shelf = &page->shelves[i];
+        if (shelf->height < h || shelf->x + w > atlas->size) continue;
+        if (!best || shelf->height < best->height) best = shelf;
+    }
+    // A shelf much taller than the glyph wastes the difference on every glyph put there
+    if (best && best->height <= h + h / 2 + 2) return best;
+
+    if (page->next_y + h <= atlas->size) {
+        if (page->shelf_count == page->shelf_cap) {
+            int cap = page->shelf_cap ? page->shelf_cap * 2 : 16;
+            Shelf* shelves = realloc(page->shelves, sizeof(Shelf) * (size_t)cap);
+            if (!shelves) {
+                fprintf(stderr, "Glyph atlas could not be allocated");
+                abort();
+            }
+            page->shelves = shelves;
+            page->shelf_cap = cap;
+        }
+        Shelf* shelf = &page->shelves[page->shelf_count++];
+        shelf->y = page->next_y;
+        shelf->height = h;
+        shelf->x = 0;
+        page->next_y += h;
+        return shelf;
+    }
+    return best;
+}
+
+static void upload_glyph(const AtlasPage* page, const unsigned char* pixels, int x, int y, int width, int height, int pitch) {
+    GLuint previous = current_binding();
+    glBindTexture(GL_TEXTURE_2D, page->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RED, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, previous);
+}
+
+int atlas_add(GlyphAtlas* atlas, const unsigned char* pixels, int width, int height, int pitch, Character* ch) {
+    ch->TextureID = 0;
+    ch->u0 = ch->v0 = ch->u1 = ch->v1 = 0.0f;
+    if (width <= 0 || height <= 0) return 1;
+
+    int w = width + ATLAS_PADDING;
+    int h = height + ATLAS_PADDING;
+    if (w > atlas->size || h > atlas->size) return 0;
+
+    AtlasPage* page = NULL;
+    Shelf* shelf = NULL;
+    for (int i = 0; i < atlas->page_count && !shelf; i++) {
+        page = &atlas->pages[i];
+        shelf = place_on_page(atlas, page, w, h);
+    }
+    if (!shelf) {
+        if (atlas->max_pages > 0 && atlas->page_count >= atlas->max_pages) return 0;
+        page = add_page(atlas);
+        shelf = place_on_page(atlas, page, w, h);
+    }
+
+    int x = shelf->x;
+    int y = shelf->y;
+    shelf->x += w;
+
+    if (page->staging) {
+        for (int row = 0; row < height; row++) {
+            memcpy(page->staging + (size_t)(y + row) * (size_t)atlas->size + x, pixels + (ptrdiff_t)row * pitch, (size_t)width);
+        }
+    } else {
+        upload_glyph(page, pixels, x, y, width, height, pitch);
+    }
+
+    float size = (float)atlas->size;
+    ch->TextureID = page->texture;
+    ch->u0 = x / size;
+    ch->v0 = y / size;
+    ch->u1 = (x + width) / size;
+    ch->v1 = (y + height) / size;
+    return 1;
+}
+
+void atlas_pin_pages(GlyphAtlas* atlas) {
+    for (int i = 0; i < atlas->page_count; i++) atlas->pages[i].pinned = 1;
+}
+
+int atlas_reset_page(GlyphAtlas* atlas, unsigned int texture) {
+    AtlasPage* page = NULL;
+    for (int i = 0; i < atlas->page_count && !page; i++) {
+        if (atlas->pages[i].texture == texture) page = &atlas->pages[i];
+    }
+    if (!page || page->pinned) return 0;
+
+    page->shelf_count = 0;
+    page->next_y = 0;
+    if (page->staging) {
+        memset(page->staging, 0, (size_t)atlas->size * (size_t)atlas->size);
+        return 1;
+    }
+
+    // Clear the texels too, stale pixels would show through the padding of new glyphs
+    unsigned char* zero = zeroed_page(atlas);
+    GLuint previous = current_binding();
+    glBindTexture(GL_TEXTURE_2D, page->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, atlas->size, atlas->size, GL_RED, GL_UNSIGNED_BYTE, zero);
+    glBindTexture(GL_TEXTURE_2D, previous);
+    free(zero);
+    return 1;
+}
+
+void atlas_begin_batch(GlyphAtlas* atlas) {
+    atlas->batching = 1;
+}
+
+void atlas_end_batch(GlyphAtlas* atlas) {
+    atlas->batching = 0;
+    GLuint previous = current_binding();
+    for (int i = 0; i < atlas->page_count; i++) {
+        AtlasPage* page = &atlas->pages[i];
+        if (!page->staging) continue;
+        glBindTexture(GL_TEXTURE_2D, page->texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, atlas->size, atlas->size, GL_RED, GL_UNSIGNED_BYTE, page->staging);
+        free(page->staging);
+        page->staging = NULL;
+    }
+    glBindTexture(GL_TEXTURE_2D, previous);
+}
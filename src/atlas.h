@@ -0,0 +1,62 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "types.h"
+
+/**
+ * Glyph atlas
+ * Glyph bitmaps are packed into a few large GL_R8 page textures with a shelf packer: each
+ * page is cut into horizontal shelves, and a glyph goes on the shelf whose height fits it
+ * best. New glyphs are uploaded with a sub-rectangle update, and a page is added when none
+ * has room left. Glyphs never move once placed, so their texture coordinates stay valid
+ * until their page is reset; space is reclaimed a whole page at a time.
+ */
+
+#define ATLAS_PAGE_SIZE 1024
+
+typedef struct GlyphAtlas GlyphAtlas;
+
+/**
+ * Creates an empty atlas; pages are allocated as glyphs arrive (needs a current GL context)
+ * @param max_pages - Most pages to allocate, 0 for no limit
+ */
+GlyphAtlas* atlas_create(int page_size, int max_pages);
+
+/** Deletes every page texture */
+void atlas_destroy(GlyphAtlas* atlas);
+
+/**
+ * Packs and uploads a glyph bitmap, then stores its page and texture coordinates in ch
+ * An empty bitmap (a space) is not stored and gets TextureID 0.
+ * @param pixels - 8-bit coverage rows, top row first
+ * @param width - Bitmap width in pixels
+ * @param height - Bitmap height in pixels
+ * @param pitch - Bytes from one row to the next
+ * @return 1 on success, 0 if the bitmap is larger than a page or every page is full
+ */
+int atlas_add(GlyphAtlas* atlas, const unsigned char* pixels, int width, int height, int pitch, Character* ch);
+
+/** Number of page textures in use */
+int atlas_page_count(const GlyphAtlas* atlas);
+
+/**
+ * Starts a bulk load: pages created from now on are filled in memory and uploaded whole by
+ * atlas_end_batch, one texture upload per page instead of one per glyph. Glyphs added to
+ * pages that already existed are still uploaded right away.
+ */
+void atlas_begin_batch(GlyphAtlas* atlas);
+
+/** Uploads the pages filled since atlas_begin_batch; their glyphs are not visible before */
+void atlas_end_batch(GlyphAtlas* atlas);
+
+/** Marks every current page as permanent, atlas_reset_page will refuse them */
+void atlas_pin_pages(GlyphAtlas* atlas);
+
+/**
+ * Empties a page so its space can be reused; glyphs placed on it become invalid
+ * @param texture - Page texture, as stored in Character.TextureID
+ * @return 1 if the page was reset, 0 if it is pinned or not part of this atlas
+ */
+int atlas_reset_page(GlyphAtlas* atlas, unsigned int texture);
+
+#endif // ATLAS_H
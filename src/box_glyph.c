@@ -0,0 +1,312 @@
+#include "box_glyph.h"
+#include <math.h>
+#include <string.h>
+
+// Weight of a line arm, from the cell centre to one edge
+enum { NONE, LIGHT, HEAVY, DOUBLE };
+
+// Arm weights of a box drawing character, two bits each: up, right, down, left
+#define ARMS(up, right, down, left) (uint8_t)((up) | (right) << 2 | (down) << 4 | (left) << 6)
+#define L LIGHT
+#define H HEAVY
+#define D DOUBLE
+#define N NONE
+
+// U+2500-257F; dashed lines have the arms of the solid line, arcs and diagonals are drawn apart
+static const uint8_t BOX_ARMS[128] = {
+    ARMS(N, L, N, L), ARMS(N, H, N, H), ARMS(L, N, L, N), ARMS(H, N, H, N),   // 2500 ─ ━ │ ┃
+    ARMS(N, L, N, L), ARMS(N, H, N, H), ARMS(L, N, L, N), ARMS(H, N, H, N),   // 2504 ┄ ┅ ┆ ┇
+    ARMS(N, L, N, L), ARMS(N, H, N, H), ARMS(L, N, L, N), ARMS(H, N, H, N),   // 2508 ┈ ┉ ┊ ┋
+    ARMS(N, L, L, N), ARMS(N, H, L, N), ARMS(N, L, H, N), ARMS(N, H, H, N),   // 250C ┌ ┍ ┎ ┏
+    ARMS(N, N, L, L), ARMS(N, N, L, H), ARMS(N, N, H, L), ARMS(N, N, H, H),   // 2510 ┐ ┑ ┒ ┓
+    ARMS(L, L, N, N), ARMS(L, H, N, N), ARMS(H, L, N, N), ARMS(H, H, N, N),   // 2514 └ ┕ ┖ ┗
+    ARMS(L, N, N, L), ARMS(L, N, N, H), ARMS(H, N, N, L), ARMS(H, N, N, H),   // 2518 ┘ ┙ ┚ ┛
+    ARMS(L, L, L, N), ARMS(L, H, L, N), ARMS(H, L, L, N), ARMS(L, L, H, N),   // 251C ├ ┝ ┞ ┟
+    ARMS(H, L, H, N), ARMS(H, H, L, N), ARMS(L, H, H, N), ARMS(H, H, H, N),   // 2520 ┠ ┡ ┢ ┣
+    ARMS(L, N, L, L), ARMS(L, N, L, H), ARMS(H, N, L, L), ARMS(L, N, H, L),   // 2524 ┤ ┥ ┦ ┧
+    ARMS(H, N, H, L), ARMS(H, N, L, H), ARMS(L, N, H, H), ARMS(H, N, H, H),   // 2528 ┨ ┩ ┪ ┫
+    ARMS(N, L, L, L), ARMS(N, L, L, H), ARMS(N, H, L, L), ARMS(N, H, L, H),   // 252C ┬ ┭ ┮ ┯
+    ARMS(N, L, H, L), ARMS(N, L, H, H), ARMS(N, H, H, L), ARMS(N, H, H, H),   // 2530 ┰ ┱ ┲ ┳
+    ARMS(L, L, N, L), ARMS(L, L, N, H), ARMS(L, H, N, L), ARMS(L, H, N, H),   // 2534 ┴ ┵ ┶ ┷
+    ARMS(H, L, N, L), ARMS(H, L, N, H), ARMS(H, H, N, L), ARMS(H, H, N, H),   // 2538 ┸ ┹ ┺ ┻
+    ARMS(L, L, L, L), ARMS(L, L, L, H), ARMS(L, H, L, L), ARMS(L, H, L, H),   // 253C ┼ ┽ ┾ ┿
+    ARMS(H, L, L, L), ARMS(L, L, H, L), ARMS(H, L, H, L), ARMS(H, L, L, H),   // 2540 ╀ ╁ ╂ ╃
+    ARMS(H, H, L, L), ARMS(L, L, H, H), ARMS(L, H, H, L), ARMS(H, H, L, H),   // 2544 ╄ ╅ ╆ ╇
+    ARMS(L, H, H, H), ARMS(H, L, H, H), ARMS(H, H, H, L), ARMS(H, H, H, H),   // 2548 ╈ ╉ ╊ ╋
+    ARMS(N, L, N, L), ARMS(N, H, N, H), ARMS(L, N, L, N), ARMS(H, N, H, N),   // 254C ╌ ╍ ╎ ╏
+    ARMS(N, D, N, D), ARMS(D, N, D, N), ARMS(N, D, L, N), ARMS(N, L, D, N),   // 2550 ═ ║ ╒ ╓
+    ARMS(N, D, D, N), ARMS(N, N, L, D), ARMS(N, N, D, L), ARMS(N, N, D, D),   // 2554 ╔ ╕ ╖ ╗
+    ARMS(L, D, N, N), ARMS(D, L, N, N), ARMS(D, D, N, N), ARMS(L, N, N, D),   // 2558 ╘ ╙ ╚ ╛
+    ARMS(D, N, N, L), ARMS(D, N, N, D), ARMS(L, D, L, N), ARMS(D, L, D, N),   // 255C ╜ ╝ ╞ ╟
+    ARMS(D, D, D, N), ARMS(L, N, L, D), ARMS(D, N, D, L), ARMS(D, N, D, D),   // 2560 ╠ ╡ ╢ ╣
+    ARMS(N, D, L, D), ARMS(N, L, D, L), ARMS(N, D, D, D), ARMS(L, D, N, D),   // 2564 ╤ ╥ ╦ ╧
+    ARMS(D, L, N, L), ARMS(D, D, N, D), ARMS(L, D, L, D), ARMS(D, L, D, L),   // 2568 ╨ ╩ ╪ ╫
+    ARMS(D, D, D, D), 0, 0, 0,                                                // 256C ╬ ╭ ╮ ╯
+    0, 0, 0, 0,                                                               // 2570 ╰ ╱ ╲ ╳
+    ARMS(N, N, N, L), ARMS(L, N, N, N), ARMS(N, L, N, N), ARMS(N, N, L, N),   // 2574 ╴ ╵ ╶ ╷
+    ARMS(N, N, N, H), ARMS(H, N, N, N), ARMS(N, H, N, N), ARMS(N, N, H, N),   // 2578 ╸ ╹ ╺ ╻
+    ARMS(N, H, N, L), ARMS(L, N, H, N), ARMS(N, L, N, H), ARMS(H, N, L, N),   // 257C ╼ ╽ ╾ ╿
+};
+
+#undef L
+#undef H
+#undef D
+#undef N
+
+typedef struct {
+    unsigned char* pixels;
+    int width;
+    int height;
+    int light;    // light line thickness, heavy is twice that, double is two light lines
+} Canvas;
+
+static void fill(Canvas* c, int x0, int y0, int x1, int y1, unsigned char value) {
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > c->width) x1 = c->width;
+    if (y1 > c->height) y1 = c->height;
+    for (int y = y0; y < y1; y++) {
+        if (x1 > x0) memset(c->pixels + (size_t)y * (size_t)c->width + x0, value, (size_t)(x1 - x0));
+    }
+}
+
+// Antialiased pixels never lower what is already there, so strokes can overlap
+static void plot(Canvas* c, int x, int y, float coverage) {
+    if (coverage <= 0.0f) return;
+    if (coverage > 1.0f) coverage = 1.0f;
+    unsigned char value = (unsigned char)(coverage * 255.0f + 0.5f);
+    unsigned char* p = c->pixels + (size_t)y * (size_t)c->width + x;
+    if (value > *p) *p = value;
+}
+
+// Width of the stroke an arm of this weight draws; double covers both lines and the gap
+static int stroke_width(const Canvas* c, int weight) {
+    switch (weight) {
+    case LIGHT: return c->light;
+    case HEAVY: return c->light * 2;
+    case DOUBLE: return c->light * 3;
+    default: return 0;
+    }
+}
+
+static int max_int(int a, int b) {
+    return a > b ? a : b;
+}
+
+static void draw_lines(Canvas* c, uint8_t arms) {
+    int up = arms & 3, right = arms >> 2 & 3, down = arms >> 4 & 3, left = arms >> 6 & 3;
+    int cx = c->width / 2, cy = c->height / 2;
+
+    int wu = stroke_width(c, up), wr = stroke_width(c, right), wd = stroke_width(c, down), wl = stroke_width(c, left);
+
+    // The strokes through the centre, as wide as their widest arm
+    int tv = max_int(wu, wd), th = max_int(wl, wr);
+    int vx0 = cx - tv / 2, vx1 = vx0 + tv;
+    int hy0 = cy - th / 2, hy1 = hy0 + th;
+
+    // Arms run from the edge to the far side of the crossing stroke, which fills the corners
+    if (left) fill(c, 0, cy - wl / 2, tv ? vx1 : cx, cy - wl / 2 + wl, 255);
+    if (right) fill(c, tv ? vx0 : cx, cy - wr / 2, c->width, cy - wr / 2 + wr, 255);
+    if (up) fill(c, cx - wu / 2, 0, cx - wu / 2 + wu, th ? hy1 : cy, 255);
+    if (down) fill(c, cx - wd / 2, th ? hy0 : cy, cx - wd / 2 + wd, c->height, 255);
+
+    // Double arms are solid so far: cut the gap between their two lines. Where two double
+    // strokes meet the gaps open into each other; a single stroke crossing a double one
+    // bridges its gap, unless it only reaches one side of a double stroke that goes through.
+    int gx0 = cx - c->light / 2, gx1 = gx0 + c->light;
+    int gy0 = cy - c->light / 2, gy1 = gy0 + c->light;
+    bool vdouble = up == DOUBLE || down == DOUBLE;
+    bool hdouble = left == DOUBLE || right == DOUBLE;
+    if (left == DOUBLE) fill(c, 0, gy0, vdouble ? gx1 : tv ? vx0 : cx, gy1, 0);
+    if (right == DOUBLE) fill(c, vdouble ? gx0 : tv ? vx1 : cx, gy0, c->width, gy1, 0);
+    if (left == DOUBLE && right == DOUBLE && tv && !vdouble && !(up && down)) fill(c, vx0, gy0, vx1, gy1, 0);
+    if (up == DOUBLE) fill(c, gx0, 0, gx1, hdouble ? gy1 : th ? hy0 : cy, 0);
+    if (down == DOUBLE) fill(c, gx0, hdouble ? gy0 : th ? hy1 : cy, gx1, c->height, 0);
+    if (up == DOUBLE && down == DOUBLE && th && !hdouble && !(left && right)) fill(c, gx0, hy0, gx1, hy1, 0);
+}
+
+// Cut a straight line into dashes, one dash and one gap per segment
+static void cut_dashes(Canvas* c, int segments, bool vertical) {
+    int length = vertical ? c->height : c->width;
+    for (int i = 0; i < segments; i++) {
+        int end = (i + 1) * length / segments;
+        int gap = max_int(1, (end - i * length / segments) / 2);
+        if (vertical) fill(c, 0, end - gap, c->width, end, 0);
+        else fill(c, end - gap, 0, end, c->height, 0);
+    }
+}
+
+static float clamp01(float v) {
+    return v < 0.0f ? 0.0f : v > 1.0f ? 1.0f : v;
+}
+
+static float segment_distance(float px, float py, float ax, float ay, float bx, float by) {
+    float dx = bx - ax, dy = by - ay;
+    float t = clamp01(((px - ax) * dx + (py - ay) * dy) / (dx * dx + dy * dy));
+    return hypotf(px - (ax + t * dx), py - (ay + t * dy));
+}
+
+// Antialiased line of the given width between two points in pixel coordinates
+static void stroke_segment(Canvas* c, float ax, float ay, float bx, float by, float width) {
+    for (int y = 0; y < c->height; y++) {
+        for (int x = 0; x < c->width; x++) {
+            float d = segment_distance(x + 0.5f, y + 0.5f, ax, ay, bx, by);
+            plot(c, x, y, width / 2.0f + 0.5f - d);
+        }
+    }
+}
+
+// Rounded corner: a quarter circle joining the arms towards dx, dy (each +1 or -1)
+static void draw_arc(Canvas* c, int dx, int dy) {
+    int t = c->light;
+    float fx = c->width / 2 - t / 2 + t / 2.0f;    // centre lines of the straight strokes
+    float fy = c->height / 2 - t / 2 + t / 2.0f;
+    float r = fminf(fminf(fx, c->width - fx), fminf(fy, c->height - fy));
+    float ox = fx + dx * r, oy = fy + dy * r;
+
+    for (int y = 0; y < c->height; y++) {
+        for (int x = 0; x < c->width; x++) {
+            float px = x + 0.5f, py = y + 0.5f;
+            if ((px - ox) * dx > 0.0f || (py - oy) * dy > 0.0f) continue;
+            plot(c, x, y, t / 2.0f + 0.5f - fabsf(hypotf(px - ox, py - oy) - r));
+        }
+    }
+    // Straight on from where the arc meets the arm's line to the edge
+    int vx0 = c->width / 2 - t / 2, hy0 = c->height / 2 - t / 2;
+    if (dx > 0) fill(c, (int)ox, hy0, c->width, hy0 + t, 255);
+    else fill(c, 0, hy0, (int)ceilf(ox), hy0 + t, 255);
+    if (dy > 0) fill(c, vx0, (int)oy, vx0 + t, c->height, 255);
+    else fill(c, vx0, 0, vx0 + t, (int)ceilf(oy), 255);
+}
+
+// Rows (from the bottom) or columns (from the left) that n eighths of the cell cover
+static int eighths(int size, int n) {
+    return (size * n + 4) / 8;
+}
+
+static void draw_block(Canvas* c, uint32_t cp) {
+    int w = c->width, h = c->height;
+    // Quadrant and half boundaries, shared so that complementary blocks tile exactly
+    int mx = eighths(w, 4), my = h - eighths(h, 4);
+
+    if (cp >= 0x2581 && cp <= 0x2588) {
+        fill(c, 0, h - eighths(h, (int)(cp - 0x2580)), w, h, 255);   // lower eighths, 2588 full
+        return;
+    }
+    if (cp >= 0x2589 && cp <= 0x258F) {
+        fill(c, 0, 0, eighths(w, (int)(0x2590 - cp)), h, 255);      // left seven eighths to one
+        return;
+    }
+    if (cp >= 0x2591 && cp <= 0x2593) {
+        fill(c, 0, 0, w, h, (unsigned char)(64 * (cp - 0x2590)));    // light, medium, dark shade
+        return;
+    }
+
+    // Quadrants as bits: 1 upper left, 2 upper right, 4 lower left, 8 lower right
+    static const uint8_t QUADRANTS[] = {4, 8, 1, 1 | 4 | 8, 1 | 8, 1 | 2 | 4, 1 | 2 | 8, 2, 2 | 4, 2 | 4 | 8};
+    switch (cp) {
+    case 0x2580: fill(c, 0, 0, w, my, 255); return;                        // upper half
+    case 0x2590: fill(c, mx, 0, w, h, 255); return;                        // right half
+    case 0x2594: fill(c, 0, 0, w, eighths(h, 1), 255); return;             // upper eighth
+    case 0x2595: fill(c, w - eighths(w, 1), 0, w, h, 255); return;         // right eighth
+    default: break;
+    }
+    uint8_t q = QUADRANTS[cp - 0x2596];
+    if (q & 1) fill(c, 0, 0, mx, my, 255);
+    if (q & 2) fill(c, mx, 0, w, my, 255);
+    if (q & 4) fill(c, 0, my, mx, h, 255);
+    if (q & 8) fill(c, mx, my, w, h, 255);
+}
+
+// Inside test of the filled Powerline shapes, in cell units: u right, v down, both 0-1
+static bool powerline_inside(uint32_t cp, float u, float v) {
+    switch (cp) {
+    case 0xE0B0: return u <= 1.0f - fabsf(2.0f * v - 1.0f);                          // right triangle
+    case 0xE0B2: return u >= fabsf(2.0f * v - 1.0f);                                 // left triangle
+    case 0xE0B4: return u * u + (2.0f * v - 1.0f) * (2.0f * v - 1.0f) <= 1.0f;       // right half circle
+    case 0xE0B6: return (1.0f - u) * (1.0f - u) + (2.0f * v - 1.0f) * (2.0f * v - 1.0f) <= 1.0f;
+    case 0xE0B8: return v >= u;                                                      // lower left
+    case 0xE0BA: return v >= 1.0f - u;                                               // lower right
+    case 0xE0BC: return v <= 1.0f - u;                                               // upper left
+    case 0xE0BE: return v <= u;                                                      // upper right
+    default: return false;
+    }
+}
+
+static void draw_powerline(Canvas* c, uint32_t cp) {
+    float w = (float)c->width, h = (float)c->height, t = (float)c->light;
+    switch (cp) {
+    case 0xE0B1:   // right-pointing chevron
+        stroke_segment(c, 0.0f, 0.0f, w, h / 2.0f, t);
+        stroke_segment(c, w, h / 2.0f, 0.0f, h, t);
+        return;
+    case 0xE0B3:   // left-pointing chevron
+        stroke_segment(c, w, 0.0f, 0.0f, h / 2.0f, t);
+        stroke_segment(c, 0.0f, h / 2.0f, w, h, t);
+        return;
+    case 0xE0B9:
+    case 0xE0BF:   // backslash separators
+        stroke_segment(c, 0.0f, 0.0f, w, h, t);
+        return;
+    case 0xE0BB:
+    case 0xE0BD:   // slash separators
+        stroke_segment(c, w, 0.0f, 0.0f, h, t);
+        return;
+    default: break;
+    }
+    // 4x4 samples per pixel keep the slanted and curved edges smooth
+    for (int y = 0; y < c->height; y++) {
+        for (int x = 0; x < c->width; x++) {
+            int hits = 0;
+            for (int sy = 0; sy < 4; sy++) {
+                for (int sx = 0; sx < 4; sx++) {
+                    hits += powerline_inside(cp, (x + (sx + 0.5f) / 4.0f) / w, (y + (sy + 0.5f) / 4.0f) / h);
+                }
+            }
+            c->pixels[(size_t)y * (size_t)c->width + x] = (unsigned char)(hits * 255 / 16);
+        }
+    }
+}
+
+bool box_glyph_supported(uint32_t codepoint) {
+    if (codepoint >= 0x2500 && codepoint <= 0x259F) return true;
+    return codepoint >= 0xE0B0 && codepoint <= 0xE0BF && codepoint != 0xE0B5 && codepoint != 0xE0B7;
+}
+
+bool box_glyph_render(uint32_t codepoint, int width, int height, unsigned char* pixels) {
+    if (!box_glyph_supported(codepoint) || width <= 0 || height <= 0) return false;
+    memset(pixels, 0, (size_t)width * (size_t)height);
+    Canvas c = {pixels, width, height, max_int(1, height / 16)};
+
+    if (codepoint >= 0xE0B0) {
+        draw_powerline(&c, codepoint);
+        return true;
+    }
+    if (codepoint >= 0x2580) {
+        draw_block(&c, codepoint);
+        return true;
+    }
+
+    switch (codepoint) {
+    case 0x256D: draw_arc(&c, 1, 1); return true;     // ╭
+    case 0x256E: draw_arc(&c, -1, 1); return true;    // ╮
+    case 0x256F: draw_arc(&c, -1, -1); return true;   // ╯
+    case 0x2570: draw_arc(&c, 1, -1); return true;    // ╰
+    case 0x2571: stroke_segment(&c, (float)width, 0.0f, 0.0f, (float)height, (float)c.light); return true;
+    case 0x2572: stroke_segment(&c, 0.0f, 0.0f, (float)width, (float)height, (float)c.light); return true;
+    case 0x2573:
+        stroke_segment(&c, (float)width, 0.0f, 0.0f, (float)height, (float)c.light);
+        stroke_segment(&c, 0.0f, 0.0f, (float)width, (float)height, (float)c.light);
+        return true;
+    default: break;
+    }
+
+    draw_lines(&c, BOX_ARMS[codepoint - 0x2500]);
+    if (codepoint >= 0x2504 && codepoint <= 0x250B) {
+        // Triple dashes, then quadruple, each a horizontal light and heavy then vertical pair
+        cut_dashes(&c, codepoint < 0x2508 ? 3 : 4, (codepoint & 2) != 0);
+    } else if (codepoint >= 0x254C && codepoint <= 0x254F) {
+        cut_dashes(&c, 2, codepoint >= 0x254E);
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef BOX_GLYPH_H
+#define BOX_GLYPH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Procedural cell glyphs
+ * Box drawing (U+2500-257F), block elements (U+2580-259F) and the Powerline separators
+ * (U+E0B0-E0BF) are drawn here instead of by FreeType. Each bitmap covers the whole cell,
+ * and lines sit at the same offsets in every glyph, so borders and blocks join without
+ * seams across neighbouring cells. Line glyphs come from a table of arm weights (light,
+ * heavy or double towards each cell edge); the rest are filled rectangles or shapes.
+ */
+
+/** True if box_glyph_render draws the code point */
+bool box_glyph_supported(uint32_t codepoint);
+
+/**
+ * Draws a code point as an 8-bit coverage bitmap of exactly one cell
+ * @param width - Cell width in pixels
+ * @param height - Cell height in pixels
+ * @param pixels - width * height bytes, top row first; overwritten
+ * @return true if the glyph was drawn, false if the code point is not supported
+ */
+bool box_glyph_render(uint32_t codepoint, int width, int height, unsigned char* pixels);
+
+#endif // BOX_GLYPH_H
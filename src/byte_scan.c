@@ -0,0 +1,118 @@
+#include "byte_scan.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+// SWAR test: high bit set in each byte outside 0x20-0x7E. Borrows can flag bytes above a
+// real hit, but the lowest flagged byte is always exact, which is all the scan needs.
+static inline uint64_t non_printable_mask64(uint64_t v) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    uint64_t below_space = (v - ones * 0x20) & ~v;
+    uint64_t del = v ^ (ones * 0x7F);
+    uint64_t is_del = (del - ones) & ~del;
+    return (below_space | is_del | v) & highs;
+}
+
+static size_t scan_printable_scalar(const unsigned char* p, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, p + i, sizeof(v));
+        uint64_t mask = non_printable_mask64(v);
+        if (mask) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return i + (size_t)(__builtin_ctzll(mask) >> 3);
+#else
+            break;
+#endif
+        }
+    }
+    while (i < len && p[i] >= 0x20 && p[i] <= 0x7E) i++;
+    return i;
+}
+
+size_t scan_printable_ascii(const char* buf, size_t len) {
+    const unsigned char* p = (const unsigned char*)buf;
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    // Bytes are compared as signed: high-bit bytes are negative and fail the > 0x1F test
+    const __m256i lo32 = _mm256_set1_epi8(0x1F);
+    const __m256i hi32 = _mm256_set1_epi8(0x7F);
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i ok = _mm256_and_si256(_mm256_cmpgt_epi8(v, lo32), _mm256_cmpgt_epi8(hi32, v));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(ok);
+        if (mask != 0xFFFFFFFFu) return i + (size_t)__builtin_ctz(~mask);
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    const __m128i lo16 = _mm_set1_epi8(0x1F);
+    const __m128i hi16 = _mm_set1_epi8(0x7F);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, lo16), _mm_cmpgt_epi8(hi16, v));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(ok);
+        if (mask != 0xFFFFu) return i + (size_t)__builtin_ctz(~mask & 0xFFFFu);
+    }
+#endif
+
+    return i + scan_printable_scalar(p + i, len - i);
+}
+
+// Candidate positions are found by comparing the needle's first and last byte against
+// 16 / 32 haystack positions at once; only those are verified with memcmp
+size_t scan_find(const char* hay, size_t len, const char* needle, size_t needle_len) {
+    if (needle_len == 0) return 0;
+    if (needle_len > len) return len;
+
+    const unsigned char* p = (const unsigned char*)hay;
+    const size_t last = needle_len - 1;
+    const size_t end = len - last; // candidate starts are [0, end)
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i first32 = _mm256_set1_epi8(needle[0]);
+    const __m256i last32 = _mm256_set1_epi8(needle[last]);
+    for (; i + 32 <= end; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(p + i + last));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first32), _mm256_cmpeq_epi8(b, last32)));
+        while (mask) {
+            size_t at = i + (size_t)__builtin_ctz(mask);
+            if (memcmp(p + at + 1, needle + 1, last) == 0) return at;
+            mask &= mask - 1;
+        }
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    const __m128i first16 = _mm_set1_epi8(needle[0]);
+    const __m128i last16 = _mm_set1_epi8(needle[last]);
+    for (; i + 16 <= end; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(p + i + last));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first16), _mm_cmpeq_epi8(b, last16)));
+        while (mask) {
+            size_t at = i + (size_t)__builtin_ctz(mask);
+            if (memcmp(p + at + 1, needle + 1, last) == 0) return at;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < end; i++) {
+        if (p[i] == (unsigned char)needle[0] && p[i + last] == (unsigned char)needle[last] &&
+            memcmp(p + i + 1, needle + 1, last) == 0) {
+            return i;
+        }
+    }
+    return len;
+}
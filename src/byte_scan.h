@@ -0,0 +1,30 @@
+#ifndef BYTE_SCAN_H
+#define BYTE_SCAN_H
+
+#include <stddef.h>
+
+/**
+ * Vectorized byte classification helpers used by the output parser
+ * Picks AVX2 or SSE2 at compile time and falls back to 8-bytes-at-a-time scalar code
+ */
+
+/**
+ * Length of the run of printable ASCII (0x20-0x7E) at the start of buf
+ * Stops at the first control byte, DEL, ESC or byte with the high bit set
+ * @param buf - Bytes to scan
+ * @param len - Number of bytes available
+ * @return Number of leading printable bytes (0..len)
+ */
+size_t scan_printable_ascii(const char* buf, size_t len);
+
+/**
+ * Offset of the first occurrence of needle in hay
+ * @param hay - Bytes to search
+ * @param len - Number of bytes in hay
+ * @param needle - Bytes to look for
+ * @param needle_len - Length of needle, an empty needle matches at 0
+ * @return Offset of the match, or len if there is none
+ */
+size_t scan_find(const char* hay, size_t len, const char* needle, size_t needle_len);
+
+#endif // BYTE_SCAN_H
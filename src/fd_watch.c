@@ -0,0 +1,95 @@
+#include "fd_watch.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Bytes sent over the control pipe
+#define WATCH_REARM 'r'
+#define WATCH_QUIT 'q'
+
+struct FdWatch {
+    int fd;
+    int control[2];          // main thread -> watcher: rearm and quit requests
+    atomic_int fired;        // set by the watcher, cleared by fd_watch_rearm
+    void (*wake)(void);
+    pthread_t thread;
+};
+
+static void* watch_main(void* arg) {
+    FdWatch* watch = arg;
+    for (;;) {
+        // While fired only the control pipe is watched, the main thread has not read yet
+        int armed = !atomic_load_explicit(&watch->fired, memory_order_acquire);
+        struct pollfd fds[2] = {
+            {.fd = watch->control[0], .events = POLLIN},
+            {.fd = watch->fd, .events = POLLIN},
+        };
+        if (poll(fds, armed ? 2 : 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "fd watcher poll failed: %s\n", strerror(errno));
+            return NULL;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char request;
+            if (read(watch->control[0], &request, 1) == 1 && request == WATCH_QUIT) return NULL;
+            continue;
+        }
+        if (armed && fds[1].revents) {
+            atomic_store_explicit(&watch->fired, 1, memory_order_release);
+            watch->wake();
+        }
+    }
+}
+
+FdWatch* fd_watch_start(int fd, void (*wake)(void)) {
+    FdWatch* watch = calloc(1, sizeof(FdWatch));
+    if (!watch) {
+        fprintf(stderr, "fd watcher could not be allocated");
+        abort();
+    }
+    watch->fd = fd;
+    watch->wake = wake;
+    atomic_init(&watch->fired, 0);
+    if (pipe(watch->control) != 0) {
+        fprintf(stderr, "fd watcher pipe failed: %s\n", strerror(errno));
+        free(watch);
+        return NULL;
+    }
+    fcntl(watch->control[0], F_SETFD, FD_CLOEXEC);
+    fcntl(watch->control[1], F_SETFD, FD_CLOEXEC);
+
+    if (pthread_create(&watch->thread, NULL, watch_main, watch) != 0) {
+        fprintf(stderr, "fd watcher thread could not be started\n");
+        close(watch->control[0]);
+        close(watch->control[1]);
+        free(watch);
+        return NULL;
+    }
+    return watch;
+}
+
+static void send_request(FdWatch* watch, char request) {
+    while (write(watch->control[1], &request, 1) < 0 && errno == EINTR) {}
+}
+
+void fd_watch_rearm(FdWatch* watch) {
+    if (!watch) return;
+    // Only a fired watcher is waiting for a request, so the pipe never fills up
+    if (atomic_exchange_explicit(&watch->fired, 0, memory_order_acq_rel)) send_request(watch, WATCH_REARM);
+}
+
+void fd_watch_stop(FdWatch* watch) {
+    if (!watch) return;
+    send_request(watch, WATCH_QUIT);
+    pthread_join(watch->thread, NULL);
+    close(watch->control[0]);
+    close(watch->control[1]);
+    free(watch);
+}
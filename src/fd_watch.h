@@ -0,0 +1,29 @@
+#ifndef FD_WATCH_H
+#define FD_WATCH_H
+
+/**
+ * File descriptor watcher
+ * A background thread blocks in poll() on one descriptor and calls a wake function when it
+ * becomes readable (or hangs up), so the main thread can sleep in its event queue instead of
+ * polling the descriptor. The watcher fires once and then waits until it is re-armed, which
+ * the main thread does after draining the descriptor; data left unread never makes the
+ * thread spin.
+ */
+
+typedef struct FdWatch FdWatch;
+
+/**
+ * Starts watching fd; the watcher begins armed
+ * @param fd - Descriptor to watch, stays owned by the caller
+ * @param wake - Called from the watcher thread when fd is ready, must be thread-safe
+ * @return New watcher, or NULL if the thread could not be started
+ */
+FdWatch* fd_watch_start(int fd, void (*wake)(void));
+
+/** Lets the watcher fire again; cheap to call when it has not fired */
+void fd_watch_rearm(FdWatch* watch);
+
+/** Stops and joins the watcher thread */
+void fd_watch_stop(FdWatch* watch);
+
+#endif // FD_WATCH_H
@@ -1,33 +1,97 @@
 #include "font.h"
 #include "types.h"
+#include "atlas.h"
+#include "glyph_cache.h"
+#include "font_cache.h"
+#include "raster_pool.h"
+#include "font_coverage.h"
+#include "box_glyph.h"
 #include <glad/glad.h>
+#include <math.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include "globals.h"
 
 /** Global array storing all loaded character glyphs */
 Character Characters[128];
 
-// Keep FreeType library and face alive for dynamic glyph loading
+// Keep FreeType library and faces alive for dynamic glyph loading
 static FT_Library g_ft = NULL;
-static FT_Face g_face = NULL;
+static int g_pixelSize = 0;
 
-// Simple cache for non-ASCII glyphs
+// Fallback chain: the primary font first, then the fonts tried in order for code points it
+// lacks. The primary font is indexed by loadFont; walking the cmaps of the fallbacks (tens of
+// thousands of code points for a CJK font) is left to a background thread, and code points
+// are drawn as placeholders while a fallback that could have them is still being indexed.
+#define FONT_CHAIN_MAX RASTER_MAX_FONTS
+enum { COVERAGE_PENDING = 0, COVERAGE_READY, COVERAGE_FAILED };
 typedef struct {
-    uint32_t codepoint;
-    Character ch;
-} ExtraGlyph;
+    const char* path;
+    FT_Face face;             // render thread face, fallbacks only opened to rasterize without the pool
+    bool opened;              // tried to open face, it may still be NULL
+    FontCoverage* coverage;   // code points the font has a glyph for, from its cmap
+    atomic_int indexed;       // COVERAGE_*, coverage is published with a release store of READY
+} FontSlot;
+static FontSlot g_fonts[FONT_CHAIN_MAX];
+static int g_fontCount = 1;   // slot 0 is the primary font
 
-#define EXTRA_GLYPH_CAP 512
-static ExtraGlyph g_extraGlyphs[EXTRA_GLYPH_CAP];
-static size_t g_extraCount = 0;
+// resolve_font result while the coverage that decides it is not built yet
+#define FONT_PENDING (-2)
 
-short fontSize = 13;
+static pthread_t g_indexer;
+static bool g_indexerRunning = false;
+static atomic_bool g_indexerStop;
+static int g_indexedSeen = 0;   // indexed fonts the render loop has been told about
+
+// Every glyph bitmap lives in the atlas pages, the Character only records where
+static GlyphAtlas* g_atlas = NULL;
+
+// Non-ASCII glyphs, loaded on demand. Past these limits the least recently used glyphs are
+// evicted: entries from the cache, atlas space a page at a time.
+#define GLYPH_CACHE_CAP 8192
+#define GLYPH_ATLAS_PAGES 8
+static GlyphCache* g_glyphCache = NULL;
+
+// Rasterized bitmaps are kept on disk between runs, keyed on (among others) these flags
+#define GLYPH_LOAD_FLAGS (FT_LOAD_RENDER | FT_LOAD_FORCE_AUTOHINT)
+static FontCache* g_fontCache = NULL;
+
+// Signed distance field glyphs are rasterized once at SDF_REFERENCE_SIZE and drawn at any
+// size, so zooming and scale changes need no new glyphs. Hinting is for one size only; below
+// SDF_MIN_PIXEL_SIZE hinted bitmaps look better and are used instead.
+#define SDF_LOAD_FLAGS (FT_LOAD_RENDER | FT_LOAD_NO_HINTING | FT_LOAD_TARGET_(FT_RENDER_MODE_SDF))
+#define SDF_REFERENCE_SIZE 48
+#define SDF_MIN_PIXEL_SIZE 20
+#define SDF_SPREAD 8   // FreeType's default: texels of field around the outline, on every side
+static bool g_sdfEnabled = false;
+static bool g_sdf = false;           // the loaded glyphs are distance fields
+static FT_Int32 g_loadFlags = GLYPH_LOAD_FLAGS;
+
+// Glyphs beyond ASCII are rasterized by worker threads; g_glyphReady wakes the render loop
+static RasterPool* g_rasterPool = NULL;
+static void (*g_glyphReady)(void) = NULL;
+#define RASTER_THREADS_MAX 4
+
+// Drawn for a glyph that is still being rasterized: no pixels, one cell wide
+static Character g_placeholder;
+
+// Box drawing, block and Powerline glyphs are drawn at the cell size without FreeType; in the
+// glyph cache they use a font index past the end of the chain (see box_glyph_key)
+#define BOX_GLYPH_FONT FONT_CHAIN_MAX
+
+short fontSize = FONT_SIZE_DEFAULT;
 /**
- * Loads a TrueType font file and generates OpenGL textures for all ASCII characters (0-127)
- * Creates a glyph texture for each character, sets up texture parameters, and stores metric
- * information (width, height, bearing, advance) in the Characters array.
+ * Loads a TrueType font file and puts all ASCII characters (0-127) into the glyph atlas
+ * Bitmaps come from the on-disk glyph cache when it matches the font, and are rasterized
+ * with FreeType otherwise. Each bitmap is packed into an atlas page, and its atlas rectangle
+ * and metric information (width, height, bearing, advance) are stored in the Characters
+ * array. Glyphs cached by earlier sessions are loaded into the glyph cache in the same pass.
  * Sets font size to 48 pixels.
  * @param fontPath - Path to the .ttf font file to load
  * @return 1 on success, 0 on failure (FreeType initialization error, file not found, etc)
@@ -35,105 +99,356 @@ short fontSize = 13;
 
 int getFontSize(){return fontSize;}
 
+// Height in pixels the font is displayed at
+static int display_pixel_size(void) {
+    return (int)(yScale * fontSize);
+}
+
+// Metrics of the glyph FreeType just loaded into a face, with its bitmap
+static CachedGlyph glyph_from_slot(FT_Face face, uint32_t codepoint, int font) {
+    FT_GlyphSlot slot = face->glyph;
+    CachedGlyph glyph = {codepoint, (uint32_t)font, (int32_t)slot->bitmap.width, (int32_t)slot->bitmap.rows, slot->bitmap_left,
+                         slot->bitmap_top, (uint32_t)slot->advance.x, slot->bitmap.buffer};
+    return glyph;
+}
+
+// Pack a bitmap into the atlas and fill in ch; the metrics are set even if it does not fit
+static int place_glyph(const CachedGlyph* glyph, int pitch, Character* ch) {
+    int placed = atlas_add(g_atlas, glyph->pixels, glyph->width, glyph->height, pitch, ch);
+    ch->Width = glyph->width;
+    ch->Height = glyph->height;
+    ch->BearingX = glyph->bearing_x;
+    ch->BearingY = glyph->bearing_y;
+    ch->Advance = glyph->advance;
+    ch->Sdf = g_sdf;
+    return placed;
+}
+
+static void reset_font_slot(FontSlot* slot, const char* path) {
+    slot->path = path;
+    slot->face = NULL;
+    slot->opened = false;
+    slot->coverage = NULL;
+    atomic_store(&slot->indexed, COVERAGE_PENDING);
+}
+
+// Open a font of the chain with its Unicode charmap at the current pixel size, NULL on failure
+static FT_Face open_face(FT_Library ft, const char* path) {
+    FT_Face face;
+    if (FT_New_Face(ft, path, 0, &face)) {
+        fprintf(stderr,"Failed to load font '%s'\n", path);
+        return NULL;
+    }
+
+    // Select Unicode character map (critical for Nerd Fonts and special characters)
+    if (FT_Select_Charmap(face, FT_ENCODING_UNICODE)) {
+        fprintf(stderr, "Warning: Could not select Unicode charmap in '%s'\n", path);
+    }
+    FT_Set_Pixel_Sizes(face, 0, g_pixelSize);
+    return face;
+}
+
+static FontCoverage* build_coverage(FT_Face face) {
+    FontCoverage* coverage = coverage_create();
+    FT_UInt glyphIndex;
+    FT_ULong codepoint = FT_Get_First_Char(face, &glyphIndex);
+    while (glyphIndex != 0) {
+        coverage_add(coverage, (uint32_t)codepoint);
+        codepoint = FT_Get_Next_Char(face, codepoint, &glyphIndex);
+    }
+    return coverage;
+}
+
+// Render thread face of a font of the chain, opened on first use
+static FT_Face font_face(FontSlot* slot) {
+    if (!slot->opened) {
+        slot->opened = true;
+        slot->face = open_face(g_ft, slot->path);
+    }
+    return slot->face;
+}
+
+// Indexes the fallback fonts in chain order with a FreeType library of its own (faces must
+// not be shared between threads), waking the render loop after each one
+static void* index_fallbacks(void* arg) {
+    (void)arg;
+    FT_Library ft = NULL;
+    if (FT_Init_FreeType(&ft)) ft = NULL;
+    for (int i = 1; i < g_fontCount; i++) {
+        FontSlot* slot = &g_fonts[i];
+        FT_Face face = ft && !atomic_load(&g_indexerStop) ? open_face(ft, slot->path) : NULL;
+        if (face) {
+            slot->coverage = build_coverage(face);
+            FT_Done_Face(face);
+        }
+        atomic_store_explicit(&slot->indexed, face ? COVERAGE_READY : COVERAGE_FAILED, memory_order_release);
+        if (g_glyphReady) g_glyphReady();
+    }
+    if (ft) FT_Done_FreeType(ft);
+    return NULL;
+}
+
+// First font of the chain that has the code point: -1 if none does, FONT_PENDING while a
+// fallback that comes before any font having it is still being indexed
+static int resolve_font(uint32_t codepoint) {
+    for (int i = 0; i < g_fontCount; i++) {
+        FontSlot* slot = &g_fonts[i];
+        int state = atomic_load_explicit(&slot->indexed, memory_order_acquire);
+        if (state == COVERAGE_PENDING) return FONT_PENDING;
+        if (state == COVERAGE_READY && coverage_has(slot->coverage, codepoint)) return i;
+    }
+    return -1;
+}
+
+// Number of fonts of the chain whose indexing has finished, successfully or not
+static int fonts_indexed(void) {
+    int count = 0;
+    for (int i = 0; i < g_fontCount; i++) {
+        if (atomic_load_explicit(&g_fonts[i].indexed, memory_order_acquire) != COVERAGE_PENDING) count++;
+    }
+    return count;
+}
+
+void addFallbackFont(const char* fontPath) {
+    if (access(fontPath, R_OK) != 0) return;  // not installed here
+    if (g_fontCount >= FONT_CHAIN_MAX) {
+        fprintf(stderr, "Too many fallback fonts, '%s' is ignored\n", fontPath);
+        return;
+    }
+    reset_font_slot(&g_fonts[g_fontCount++], fontPath);
+}
+
 int loadFont(const char* fontPath) {
     if (FT_Init_FreeType(&g_ft)) { fprintf(stderr,"Could not init FreeType\n"); return 0; }
-    if (FT_New_Face(g_ft, fontPath, 0, &g_face)) {
-        fprintf(stderr,"Failed to load font '%s'\n", fontPath);
+    g_sdf = g_sdfEnabled && display_pixel_size() >= SDF_MIN_PIXEL_SIZE;
+    g_loadFlags = g_sdf ? SDF_LOAD_FLAGS : GLYPH_LOAD_FLAGS;
+    g_pixelSize = g_sdf ? SDF_REFERENCE_SIZE : display_pixel_size();
+    reset_font_slot(&g_fonts[0], fontPath);
+    FT_Face face = font_face(&g_fonts[0]);
+    if (!face) {
         FT_Done_FreeType(g_ft);
         g_ft = NULL;
         return 0;
     }
+    g_fonts[0].coverage = build_coverage(face);
+    atomic_store(&g_fonts[0].indexed, COVERAGE_READY);
 
-    // Select Unicode character map (critical for Nerd Fonts and special characters)
-    if (FT_Select_Charmap(g_face, FT_ENCODING_UNICODE)) {
-        fprintf(stderr, "Warning: Could not select Unicode charmap\n");
+    atomic_store(&g_indexerStop, false);
+    g_indexedSeen = 1;
+    if (g_fontCount > 1) {
+        g_indexerRunning = pthread_create(&g_indexer, NULL, index_fallbacks, NULL) == 0;
+        if (!g_indexerRunning) index_fallbacks(NULL);
     }
+    int pixelSize = g_pixelSize;
+    const char* fontPaths[FONT_CHAIN_MAX];
+    for (int i = 0; i < g_fontCount; i++) fontPaths[i] = g_fonts[i].path;
+    glEnable(GL_FRAMEBUFFER_SRGB);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    g_atlas = atlas_create(ATLAS_PAGE_SIZE, GLYPH_ATLAS_PAGES);
+    g_glyphCache = glyph_cache_create(GLYPH_CACHE_CAP);
+    // Distance fields do not depend on the content scale, a scale change keeps their cache
+    g_fontCache = font_cache_open(fontPaths, g_fontCount, pixelSize, g_sdf ? 1.0f : yScale, g_loadFlags);
+    size_t cachedCount = g_fontCache ? font_cache_count(g_fontCache) : 0;
 
-    FT_Set_Pixel_Sizes(g_face, 0, yScale * fontSize); 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // Everything below lands on fresh pages, which are filled in memory and uploaded once
+    atlas_begin_batch(g_atlas);
+
+    bool loaded[128] = {false};
+    for (size_t i = 0; i < cachedCount; i++) {
+        const CachedGlyph* glyph = font_cache_glyph(g_fontCache, i);
+        if (glyph->font == 0 && glyph->codepoint < 128 && !loaded[glyph->codepoint]) {
+            loaded[glyph->codepoint] = place_glyph(glyph, glyph->width, &Characters[glyph->codepoint]);
+        }
+    }
 
+    int rasterized = 0;
     for (unsigned char c=0; c<128; c++){
-        if (FT_Load_Char(g_face,c,FT_LOAD_RENDER | FT_LOAD_FORCE_AUTOHINT)) {
+        if (loaded[c]) continue;
+        if (FT_Load_Char(face, c, g_loadFlags)) {
             fprintf(stderr, "Missing glyph for char '%c'\n", c);
             continue;
         }
 
-        GLuint tex;
-        glGenTextures(1, &tex);
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8,
-                     g_face->glyph->bitmap.width,
-                     g_face->glyph->bitmap.rows,
-                     0, GL_RED, GL_UNSIGNED_BYTE,
-                     g_face->glyph->bitmap.buffer);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glEnable(GL_FRAMEBUFFER_SRGB);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        Characters[c].TextureID = tex;
-        Characters[c].Width = g_face->glyph->bitmap.width;
-        Characters[c].Height = g_face->glyph->bitmap.rows;
-        Characters[c].BearingX = g_face->glyph->bitmap_left;
-        Characters[c].BearingY = g_face->glyph->bitmap_top;
-        Characters[c].Advance = g_face->glyph->advance.x;
-
-        printf("[DEBUG] Loaded char '%c' (ASCII %d) size=%dx%d\n",
-               c, c, Characters[c].Width, Characters[c].Height);
+        CachedGlyph glyph = glyph_from_slot(face, c, 0);
+        if (!place_glyph(&glyph, face->glyph->bitmap.pitch, &Characters[c])) {
+            fprintf(stderr, "Glyph for char '%c' does not fit in the atlas\n", c);
+        }
+        if (g_fontCache) font_cache_add(g_fontCache, &glyph, face->glyph->bitmap.pitch);
+        rasterized++;
+    }
+
+    // The ASCII glyphs are not in the glyph cache, so their pages must never be reset
+    atlas_pin_pages(g_atlas);
+
+    // Glyphs earlier sessions needed go straight into the glyph cache, while there is room
+    for (size_t i = 0; i < cachedCount; i++) {
+        const CachedGlyph* glyph = font_cache_glyph(g_fontCache, i);
+        if ((glyph->font == 0 && glyph->codepoint < 128) || glyph->font >= (uint32_t)g_fontCount) continue;
+        Character ch = {0};
+        if (!place_glyph(glyph, glyph->width, &ch)) break;
+        *glyph_cache_insert(g_glyphCache, GLYPH_KEY(glyph->codepoint, glyph->font), GLYPH_READY) = ch;
     }
+    atlas_end_batch(g_atlas);
+
+    g_placeholder.Advance = Characters[' '].Advance;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cores > 1 ? (int)(cores - 1) : 1;
+    if (threads > RASTER_THREADS_MAX) threads = RASTER_THREADS_MAX;
+    g_rasterPool = raster_pool_create(fontPaths, g_fontCount, pixelSize, g_loadFlags, threads, g_glyphReady);
+
+    // Store a fresh cache right away, short-lived windows may never reach unloadFont
+    if (rasterized > 0 && g_fontCache) font_cache_save(g_fontCache);
 
     // Keep face and library for dynamic glyph loading
     return 1;
 }
 
+void unloadFont(void) {
+    if (g_indexerRunning) {
+        atomic_store(&g_indexerStop, true);
+        pthread_join(g_indexer, NULL);
+        g_indexerRunning = false;
+    }
+    raster_pool_destroy(g_rasterPool);
+    g_rasterPool = NULL;
+    glyph_cache_destroy(g_glyphCache);
+    g_glyphCache = NULL;
+    if (g_fontCache) font_cache_save(g_fontCache);
+    font_cache_close(g_fontCache);
+    g_fontCache = NULL;
+    atlas_destroy(g_atlas);
+    g_atlas = NULL;
+    for (int i = 0; i < g_fontCount; i++) {
+        if (g_fonts[i].face) FT_Done_Face(g_fonts[i].face);
+        coverage_destroy(g_fonts[i].coverage);
+        reset_font_slot(&g_fonts[i], g_fonts[i].path);
+    }
+    if (g_ft) FT_Done_FreeType(g_ft);
+    g_ft = NULL;
+}
+
+// Rows sit this far apart, fractional at fractional content scales
+float getLineSpacing() {
+    return (fontSize + 3) * yScale;
+}
+
+float getGlyphScale() {
+    return g_sdf ? (float)display_pixel_size() / SDF_REFERENCE_SIZE : 1.0f;
+}
+
 // Use the space character width as the fixed cell advance (in pixels)
 int getCellAdvance() {
+    if (g_sdf) return (int)lroundf(Characters[' '].Advance / 64.0f * getGlyphScale());
     return (Characters[' '].Advance >> 6);
 }
 
-// Load a glyph for a Unicode codepoint > 127 and cache it; return pointer or NULL on failure
-static const Character* load_extra_glyph(uint32_t codepoint) {
-    if (!g_face) return NULL;
-    if (g_extraCount >= EXTRA_GLYPH_CAP) return NULL;
+// Deepest descender among the ASCII glyphs: how far below the baseline a cell extends
+int getCellDescent() {
+    int descent = 0;
+    for (int i = 0; i < 128; i++) {
+        if (Characters[i].Height == 0) continue;
+        // A distance field reaches SDF_SPREAD texels past the outline
+        int below = Characters[i].Height - Characters[i].BearingY - (Characters[i].Sdf ? SDF_SPREAD : 0);
+        if (below > descent) descent = below;
+    }
+    return g_sdf ? (int)ceilf(descent * getGlyphScale()) : descent;
+}
+
+void grid_size_for_pixels(int width_px, int height_px, int* cols, int* rows) {
+    int largestWidth = 1;
+    int largestHeight = 1;
+    int padding = g_sdf ? 2 * SDF_SPREAD : 0;
 
-    // Get the glyph index for this Unicode codepoint
-    FT_UInt glyph_index = FT_Get_Char_Index(g_face, codepoint);
-    if (glyph_index == 0) {
-        return NULL;  // Glyph not in font, will fallback to replacement char
+    for (int i = 0; i < 128; i++) {
+        if (Characters[i].Width - padding > largestWidth) {largestWidth = Characters[i].Width - padding;}
+        if (Characters[i].Height - padding > largestHeight) {largestHeight = Characters[i].Height - padding;}
+    } // If array size for characters changes this needs to change too
+    if (g_sdf) {
+        largestWidth = (int)ceilf(largestWidth * getGlyphScale());
+        largestHeight = (int)ceilf(largestHeight * getGlyphScale());
+        if (largestWidth < 1) largestWidth = 1;
+        if (largestHeight < 1) largestHeight = 1;
     }
 
-    // Load the glyph using the glyph index
-    if (FT_Load_Glyph(g_face, glyph_index, FT_LOAD_RENDER | FT_LOAD_FORCE_AUTOHINT)) {
-        return NULL;  // Failed to load, will fallback to replacement char
+    *cols = width_px / largestWidth;
+    *rows = height_px / largestHeight;
+}
+
+static int reset_atlas_page(unsigned int texture, void* ctx) {
+    (void)ctx;
+    return atlas_reset_page(g_atlas, texture);
+}
+
+// Pack a bitmap into the atlas, evicting the least recently used atlas page while it is full
+static int add_to_atlas(const CachedGlyph* glyph, int pitch, Character* ch) {
+    for (;;) {
+        if (atlas_add(g_atlas, glyph->pixels, glyph->width, glyph->height, pitch, ch)) return 1;
+        if (glyph_cache_evict_oldest_page(g_glyphCache, reset_atlas_page, NULL) == 0) return 0;
     }
+}
 
-    GLuint tex;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8,
-                 g_face->glyph->bitmap.width,
-                 g_face->glyph->bitmap.rows,
-                 0, GL_RED, GL_UNSIGNED_BYTE,
-                 g_face->glyph->bitmap.buffer);
+// Put a glyph bitmap in the atlas and the glyph cache under key
+static const Character* cache_glyph(const CachedGlyph* glyph, int pitch, GlyphKey key, bool sdf) {
+    // Into the atlas first: making room may evict entries, never the new one
+    Character loaded = {0};
+    if (!add_to_atlas(glyph, pitch, &loaded)) return NULL;
+    loaded.Width = glyph->width;
+    loaded.Height = glyph->height;
+    loaded.BearingX = glyph->bearing_x;
+    loaded.BearingY = glyph->bearing_y;
+    loaded.Advance = glyph->advance;
+    loaded.Sdf = sdf;
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    Character* ch = glyph_cache_insert(g_glyphCache, key, GLYPH_READY);
+    *ch = loaded;
+    return ch;
+}
 
-    ExtraGlyph* eg = &g_extraGlyphs[g_extraCount++];
-    eg->codepoint = codepoint;
-    eg->ch.TextureID = tex;
-    eg->ch.Width = g_face->glyph->bitmap.width;
-    eg->ch.Height = g_face->glyph->bitmap.rows;
-    eg->ch.BearingX = g_face->glyph->bitmap_left;
-    eg->ch.BearingY = g_face->glyph->bitmap_top;
-    eg->ch.Advance = g_face->glyph->advance.x;
+// Put a rasterized glyph in the atlas, the glyph cache and the on-disk cache
+static const Character* store_extra_glyph(const CachedGlyph* glyph, int pitch) {
+    const Character* ch = cache_glyph(glyph, pitch, GLYPH_KEY(glyph->codepoint, glyph->font), g_sdf);
+    if (ch && g_fontCache) font_cache_add(g_fontCache, glyph, pitch);
+    return ch;
+}
+
+// Box glyphs depend on the cell size rather than a font: the key carries the size in place of
+// the font index, so the glyphs of an earlier zoom level age out of the cache
+static GlyphKey box_glyph_key(uint32_t codepoint, int width, int height) {
+    return GLYPH_KEY(codepoint, (uint32_t)BOX_GLYPH_FONT | (uint32_t)width << 8 | (uint32_t)height << 20);
+}
 
-    return &eg->ch;
+// Draw a box drawing, block or Powerline glyph covering exactly one cell. Drawing takes
+// less than reading it back would, so it stays out of the on-disk cache.
+static const Character* load_box_glyph(uint32_t codepoint, int width, int height) {
+    unsigned char* pixels = malloc((size_t)width * (size_t)height);
+    if (!pixels) {
+        fprintf(stderr, "Box glyph could not be allocated");
+        abort();
+    }
+    box_glyph_render(codepoint, width, height, pixels);
+
+    // Bottom edge on the bottom of the cell, as deep below the baseline as the descenders
+    CachedGlyph glyph = {codepoint, BOX_GLYPH_FONT, width, height, 0, height - getCellDescent(),
+                         (uint32_t)width << 6, pixels};
+    const Character* ch = cache_glyph(&glyph, width, box_glyph_key(codepoint, width, height), false);
+    free(pixels);
+    return ch;
+}
+
+// Load a glyph for a Unicode codepoint > 127 from a font of the chain into the cache; return
+// pointer or NULL on failure
+static const Character* load_extra_glyph(uint32_t codepoint, int font) {
+    FT_Face face = font_face(&g_fonts[font]);
+
+    // A glyph that fails to load is cached as missing so it is not tried again every frame
+    FT_UInt glyph_index = face ? FT_Get_Char_Index(face, codepoint) : 0;
+    if (glyph_index == 0 || FT_Load_Glyph(face, glyph_index, g_loadFlags)) {
+        glyph_cache_insert(g_glyphCache, GLYPH_KEY(codepoint, font), GLYPH_MISSING);
+        return NULL;  // will fallback to replacement char
+    }
+    CachedGlyph glyph = glyph_from_slot(face, codepoint, font);
+    return store_extra_glyph(&glyph, face->glyph->bitmap.pitch);
 }
 
 // Public: get glyph for codepoint (ASCII uses Characters[], others loaded on demand)
@@ -141,14 +456,122 @@ const Character* getGlyph(uint32_t codepoint) {
     if (codepoint < 128) {
         return &Characters[codepoint];
     }
-    // Look in cache
-    for (size_t i = 0; i < g_extraCount; i++) {
-        if (g_extraGlyphs[i].codepoint == codepoint) return &g_extraGlyphs[i].ch;
+    if (!g_glyphCache) return &Characters['?'];
+
+    if (box_glyph_supported(codepoint)) {
+        int width = getCellAdvance();
+        int height = (int)ceilf(getLineSpacing());
+        const Character* box = glyph_cache_lookup(g_glyphCache, box_glyph_key(codepoint, width, height), NULL);
+        if (!box) box = load_box_glyph(codepoint, width, height);
+        return box ? box : &Characters['?'];
+    }
+
+    // The coverage index picks the font without asking FreeType; no font has it: '?'
+    int font = resolve_font(codepoint);
+    if (font == FONT_PENDING) return &g_placeholder;
+    if (font < 0) return &Characters['?'];
+
+    GlyphState state = GLYPH_READY;
+    const Character* cached = glyph_cache_lookup(g_glyphCache, GLYPH_KEY(codepoint, font), &state);
+    if (cached) {
+        if (state == GLYPH_PENDING) return &g_placeholder;
+        return state == GLYPH_MISSING ? &Characters['?'] : cached;
     }
+
+    // Rasterize off-thread and draw a blank cell until it is uploaded
+    if (g_rasterPool) {
+        glyph_cache_insert(g_glyphCache, GLYPH_KEY(codepoint, font), GLYPH_PENDING);
+        raster_pool_request(g_rasterPool, codepoint, font, false);
+        return &g_placeholder;
+    }
+
     // Load on demand
-    const Character* result = load_extra_glyph(codepoint);
+    const Character* result = load_extra_glyph(codepoint, font);
     if (result) return result;
     
     // Fallback to '?' if glyph not found
     return &Characters['?'];
 }
+
+int uploadReadyGlyphs(void) {
+    // Code points drawn as placeholders while their fallback was being indexed resolve now
+    int ready = 0;
+    int indexed = fonts_indexed();
+    if (indexed > g_indexedSeen) {
+        ready += indexed - g_indexedSeen;
+        g_indexedSeen = indexed;
+    }
+    if (!g_rasterPool) return ready;
+    RasterResult results[64];
+    size_t count;
+    while ((count = raster_pool_take(g_rasterPool, results, 64)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            RasterResult* r = &results[i];
+            if (r->missing) {
+                glyph_cache_insert(g_glyphCache, GLYPH_KEY(r->codepoint, r->font), GLYPH_MISSING);
+            } else {
+                CachedGlyph glyph = {r->codepoint, (uint32_t)r->font, r->width, r->height, r->bearing_x,
+                                     r->bearing_y, r->advance, r->pixels};
+                if (!store_extra_glyph(&glyph, r->width)) {
+                    glyph_cache_insert(g_glyphCache, GLYPH_KEY(r->codepoint, r->font), GLYPH_MISSING);
+                }
+            }
+            free(r->pixels);
+            ready++;
+        }
+    }
+    return ready;
+}
+
+bool prewarmGlyphs(void) {
+    if (!g_rasterPool) return true;
+    if (fonts_indexed() < g_fontCount) return false;
+    // Powerline symbols and the Nerd Font dev/file-type icons; box drawing and blocks are not
+    // rasterized at all
+    static const uint32_t ranges[][2] = {
+        {0xE0A0, 0xE0D7},
+        {0xE5FA, 0xE7C5},
+    };
+    for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+        for (uint32_t cp = ranges[r][0]; cp <= ranges[r][1]; cp++) {
+            if (box_glyph_supported(cp)) continue;
+            int font = resolve_font(cp);
+            if (font < 0) continue;
+            GlyphKey key = GLYPH_KEY(cp, font);
+            if (glyph_cache_peek(g_glyphCache, key, NULL)) continue;
+            glyph_cache_insert(g_glyphCache, key, GLYPH_PENDING);
+            raster_pool_request(g_rasterPool, cp, font, true);
+        }
+    }
+    return true;
+}
+
+void setSdfGlyphs(bool enabled) {
+    g_sdfEnabled = enabled;
+}
+
+int setFontSize(int size) {
+    if (size < FONT_SIZE_MIN) size = FONT_SIZE_MIN;
+    if (size > FONT_SIZE_MAX) size = FONT_SIZE_MAX;
+    fontSize = (short)size;
+    if (!g_ft) return 1;  // loadFont picks it up
+
+    // Distance fields only change the scale they are drawn at. Bitmaps are rasterized for
+    // one size, and crossing SDF_MIN_PIXEL_SIZE switches between the two: load everything
+    // again, sizes seen before come back from the on-disk cache.
+    bool sdf = g_sdfEnabled && display_pixel_size() >= SDF_MIN_PIXEL_SIZE;
+    if (sdf && g_sdf) return 1;
+    if (!sdf && !g_sdf && display_pixel_size() == g_pixelSize) return 1;
+    const char* path = g_fonts[0].path;
+    unloadFont();
+    return loadFont(path);
+}
+
+void setGlyphReadyCallback(void (*callback)(void)) {
+    g_glyphReady = callback;
+}
+
+GlyphCacheStats getGlyphCacheStats(void) {
+    GlyphCacheStats none = {0};
+    return g_glyphCache ? glyph_cache_stats(g_glyphCache) : none;
+}
@@ -2,6 +2,8 @@
 #define FONT_H
 
 #include "types.h"
+#include "glyph_cache.h"
+#include <stdbool.h>
 
 /**
  * Font loading and glyph management module
@@ -11,19 +13,81 @@
 /** Global array of loaded character glyphs (supports 128 ASCII characters) */
 extern Character Characters[128];
 
+/** Font sizes (fontSize, before the content scale) reachable by zooming */
+#define FONT_SIZE_DEFAULT 13
+#define FONT_SIZE_MIN 6
+#define FONT_SIZE_MAX 72
+
 /**
- * Loads a TrueType font file and generates OpenGL textures for all ASCII characters
+ * Loads a TrueType font file, packs all ASCII characters into the glyph atlas
  * and stores glyph metrics in the Characters array
  * @param fontPath - Path to the .ttf font file
  * @return 1 on success, 0 on failure
  */
 int loadFont(const char* fontPath);
+
+/**
+ * Appends a font to the fallback chain, tried in order for code points the primary font
+ * lacks; call before loadFont. A file that does not exist is skipped; the others are only
+ * opened once one of their glyphs is needed.
+ * @param fontPath - Path to the font file, must stay valid while fonts are loaded
+ */
+void addFallbackFont(const char* fontPath);
 int getFontSize();
 
+/**
+ * Call before loadFont to use signed distance field glyphs at display sizes of 20 pixels
+ * and up: they are rasterized once and scaled, so setFontSize and content scale changes
+ * take effect at once. Smaller sizes keep hinted bitmaps.
+ */
+void setSdfGlyphs(bool enabled);
+
+/**
+ * Changes fontSize, clamped to FONT_SIZE_MIN..FONT_SIZE_MAX, also to apply a new content
+ * scale (yScale). Distance field glyphs are only drawn at the new scale; bitmap glyphs are
+ * loaded again, like loadFont does. The cell size changes either way.
+ * @return 1 on success, 0 if the font could not be loaded again
+ */
+int setFontSize(int size);
+
+// Display pixels per glyph bitmap texel: 1 for bitmaps, the zoom for distance fields
+float getGlyphScale();
+
+// Frees the glyph atlas and the FreeType face (needs the GL context that loaded the font)
+void unloadFont(void);
+
+// Distance between grid rows in pixels
+float getLineSpacing();
+
 // Returns the fixed cell advance in pixels used for monospaced layout
 int getCellAdvance();
 
-// Retrieve a glyph for a Unicode codepoint. For ASCII, returns Characters[cp].
-// For non-ASCII, loads and caches the glyph on demand (requires loaded font face).
+// Pixels a cell extends below the text baseline (the deepest ASCII descender)
+int getCellDescent();
+
+// Columns and rows that fit in a framebuffer of the given size with the loaded font
+void grid_size_for_pixels(int width_px, int height_px, int* cols, int* rows);
+
+// Retrieve a glyph for a Unicode codepoint. For ASCII, returns Characters[cp]. Box drawing,
+// block elements and Powerline separators are drawn to fill the cell (box_glyph.h).
+// For other non-ASCII, loads and caches the glyph on demand (requires loaded font face): a glyph
+// not cached yet is queued for background rasterization and a blank placeholder is
+// returned until uploadReadyGlyphs stores it, or while the fallback fonts that decide which
+// font draws it are still being indexed. The returned pointer is valid until the next
+// getGlyph call may evict it.
 const Character* getGlyph(uint32_t codepoint);
+
+// Hit, miss and eviction counters of the non-ASCII glyph cache
+GlyphCacheStats getGlyphCacheStats(void);
+
+// Set before loadFont: called from a rasterizer thread when glyphs are ready for upload
+void setGlyphReadyCallback(void (*callback)(void));
+
+// Uploads glyphs the rasterizer threads finished (render thread only); returns how many
+// changed state, in which case cells drawn with placeholders need redrawing
+int uploadReadyGlyphs(void);
+
+// Queues Powerline and common Nerd Font icons for background rasterization. Returns false,
+// having queued nothing, while fallback fonts are still being indexed; call it again later.
+bool prewarmGlyphs(void);
 #endif // FONT_H
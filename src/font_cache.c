@@ -0,0 +1,275 @@
+#include "font_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FONT_CACHE_MAGIC "MAGTGLY1"
+#define FONT_CACHE_VERSION 2
+// Past this many glyphs new ones are no longer recorded, so the file stays small
+#define FONT_CACHE_MAX_GLYPHS 8192
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t key;
+} FontCacheHeader;
+
+typedef struct {
+    uint32_t codepoint;
+    uint32_t font;
+    int32_t width;
+    int32_t height;
+    int32_t bearing_x;
+    int32_t bearing_y;
+    uint32_t advance;
+} GlyphRecord;
+
+struct FontCache {
+    char path[600];
+    uint64_t key;
+    const uint8_t* map;       // mapped cache file, NULL if there was none
+    size_t map_size;
+    CachedGlyph* glyphs;
+    size_t count;
+    size_t cap;
+    size_t loaded;            // glyphs[0, loaded) point into the mapping, the rest are owned
+    size_t saved;             // glyphs already in the file on disk
+};
+
+// FNV-1a, folded over the font bytes and then the other key fields
+static uint64_t fnv1a(uint64_t h, const void* data, size_t len) {
+    const uint8_t* p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+static int hash_font_file(const char* font_path, uint64_t* hash) {
+    int fd = open(font_path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 0;
+    *hash = fnv1a(0xCBF29CE484222325ull, data, (size_t)st.st_size);
+    munmap(data, (size_t)st.st_size);
+    return 1;
+}
+
+// $XDG_CACHE_HOME/mag-terminal, falling back to ~/.cache; 0 if neither can be created
+static int cache_dir(char* dir, size_t size) {
+    const char* base = getenv("XDG_CACHE_HOME");
+    char home_cache[512];
+    if (!base || !*base) {
+        const char* home = getenv("HOME");
+        if (!home || !*home) return 0;
+        snprintf(home_cache, sizeof(home_cache), "%s/.cache", home);
+        if (mkdir(home_cache, 0700) != 0 && errno != EEXIST) return 0;
+        base = home_cache;
+    }
+    snprintf(dir, size, "%s/mag-terminal", base);
+    return mkdir(dir, 0700) == 0 || errno == EEXIST;
+}
+
+static void push_glyph(FontCache* cache, const CachedGlyph* glyph) {
+    if (cache->count == cache->cap) {
+        size_t cap = cache->cap ? cache->cap * 2 : 256;
+        CachedGlyph* glyphs = realloc(cache->glyphs, cap * sizeof(CachedGlyph));
+        if (!glyphs) {
+            fprintf(stderr, "Glyph cache could not be allocated");
+            abort();
+        }
+        cache->glyphs = glyphs;
+        cache->cap = cap;
+    }
+    cache->glyphs[cache->count++] = *glyph;
+}
+
+// Index the records of a mapped file; a file that does not parse is ignored entirely
+static int index_file(FontCache* cache) {
+    if (cache->map_size < sizeof(FontCacheHeader)) return 0;
+    FontCacheHeader header;
+    memcpy(&header, cache->map, sizeof(header));
+    if (memcmp(header.magic, FONT_CACHE_MAGIC, 8) != 0 || header.version != FONT_CACHE_VERSION ||
+        header.key != cache->key || header.count > FONT_CACHE_MAX_GLYPHS) {
+        return 0;
+    }
+
+    size_t pos = sizeof(FontCacheHeader);
+    for (uint32_t i = 0; i < header.count; i++) {
+        GlyphRecord record;
+        if (cache->map_size - pos < sizeof(record)) return 0;
+        memcpy(&record, cache->map + pos, sizeof(record));
+        pos += sizeof(record);
+        if (record.width < 0 || record.height < 0 || record.width > 4096 || record.height > 4096) return 0;
+        size_t pixels = (size_t)record.width * (size_t)record.height;
+        if (cache->map_size - pos < pixels) return 0;
+
+        CachedGlyph glyph = {record.codepoint, record.font, record.width, record.height, record.bearing_x,
+                             record.bearing_y, record.advance, cache->map + pos};
+        push_glyph(cache, &glyph);
+        pos += pixels;
+    }
+    return 1;
+}
+
+FontCache* font_cache_open(const char* const* font_paths, int font_count, int pixel_size, float scale, int32_t load_flags) {
+    uint64_t key;
+    if (font_count < 1 || !hash_font_file(font_paths[0], &key)) return NULL;
+
+    // Fallback fonts can be large (CJK) and are rarely replaced, so only their identity is
+    // hashed; a missing one hashes as such and matches until it appears
+    for (int i = 1; i < font_count; i++) {
+        struct stat st;
+        uint64_t identity[2] = {0, 0};
+        if (stat(font_paths[i], &st) == 0) {
+            identity[0] = (uint64_t)st.st_size;
+            identity[1] = (uint64_t)st.st_mtime;
+        }
+        key = fnv1a(key, font_paths[i], strlen(font_paths[i]) + 1);
+        key = fnv1a(key, identity, sizeof(identity));
+    }
+    uint32_t version = FONT_CACHE_VERSION;
+    key = fnv1a(key, &pixel_size, sizeof(pixel_size));
+    key = fnv1a(key, &scale, sizeof(scale));
+    key = fnv1a(key, &load_flags, sizeof(load_flags));
+    key = fnv1a(key, &version, sizeof(version));
+
+    FontCache* cache = calloc(1, sizeof(FontCache));
+    if (!cache) {
+        fprintf(stderr, "Glyph cache could not be allocated");
+        abort();
+    }
+    cache->key = key;
+
+    char dir[520];
+    if (!cache_dir(dir, sizeof(dir))) return cache;  // works, just never persists
+    snprintf(cache->path, sizeof(cache->path), "%s/glyphs-%016llx.bin", dir, (unsigned long long)key);
+
+    int fd = open(cache->path, O_RDONLY);
+    if (fd < 0) return cache;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;   // the whole file is read right away
+#endif
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, flags, fd, 0);
+        if (map != MAP_FAILED) {
+            cache->map = map;
+            cache->map_size = (size_t)st.st_size;
+            if (!index_file(cache)) cache->count = 0;
+            cache->loaded = cache->saved = cache->count;
+        }
+    }
+    close(fd);
+    return cache;
+}
+
+size_t font_cache_count(const FontCache* cache) {
+    return cache->count;
+}
+
+const CachedGlyph* font_cache_glyph(const FontCache* cache, size_t index) {
+    return index < cache->count ? &cache->glyphs[index] : NULL;
+}
+
+void font_cache_add(FontCache* cache, const CachedGlyph* glyph, int pitch) {
+    if (cache->count >= FONT_CACHE_MAX_GLYPHS) return;
+    size_t size = (size_t)glyph->width * (size_t)glyph->height;
+    unsigned char* pixels = malloc(size ? size : 1);
+    if (!pixels) {
+        fprintf(stderr, "Glyph cache could not be allocated");
+        abort();
+    }
+    for (int32_t row = 0; row < glyph->height; row++) {
+        memcpy(pixels + (size_t)row * (size_t)glyph->width, glyph->pixels + (ptrdiff_t)row * pitch, (size_t)glyph->width);
+    }
+    CachedGlyph copy = *glyph;
+    copy.pixels = pixels;
+    push_glyph(cache, &copy);
+}
+
+static const CachedGlyph* sort_glyphs;
+
+// By font and code point, then by position so the first copy of a duplicate sorts first
+static int compare_glyphs(const void* a, const void* b) {
+    size_t ia = *(const size_t*)a, ib = *(const size_t*)b;
+    uint64_t ca = (uint64_t)sort_glyphs[ia].font << 32 | sort_glyphs[ia].codepoint;
+    uint64_t cb = (uint64_t)sort_glyphs[ib].font << 32 | sort_glyphs[ib].codepoint;
+    if (ca != cb) return ca < cb ? -1 : 1;
+    return ia < ib ? -1 : ia > ib;
+}
+
+static int write_all(FILE* file, const void* data, size_t len) {
+    return len == 0 || fwrite(data, 1, len, file) == len;
+}
+
+int font_cache_save(FontCache* cache) {
+    if (cache->count == cache->saved || cache->path[0] == '\0') return 1;
+
+    // A glyph evicted and rasterized again is recorded twice, the first copy is kept
+    size_t* order = malloc(cache->count * sizeof(size_t));
+    if (!order) {
+        fprintf(stderr, "Glyph cache could not be allocated");
+        abort();
+    }
+    for (size_t i = 0; i < cache->count; i++) order[i] = i;
+    sort_glyphs = cache->glyphs;
+    qsort(order, cache->count, sizeof(size_t), compare_glyphs);
+
+    FontCacheHeader header = {FONT_CACHE_MAGIC, FONT_CACHE_VERSION, 0, cache->key};
+    char tmp[620];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", cache->path, (int)getpid());
+    FILE* file = fopen(tmp, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not write glyph cache '%s': %s\n", tmp, strerror(errno));
+        free(order);
+        return 0;
+    }
+
+    int ok = write_all(file, &header, sizeof(header));
+    for (size_t i = 0; i < cache->count && ok; i++) {
+        const CachedGlyph* glyph = &cache->glyphs[order[i]];
+        const CachedGlyph* previous = i > 0 ? &cache->glyphs[order[i - 1]] : NULL;
+        if (previous && previous->codepoint == glyph->codepoint && previous->font == glyph->font) continue;
+
+        GlyphRecord record = {glyph->codepoint, glyph->font, glyph->width, glyph->height, glyph->bearing_x,
+                              glyph->bearing_y, glyph->advance};
+        ok = write_all(file, &record, sizeof(record)) &&
+             write_all(file, glyph->pixels, (size_t)glyph->width * (size_t)glyph->height);
+        header.count++;
+    }
+    free(order);
+
+    // The count is only known now
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && write_all(file, &header, sizeof(header));
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp, cache->path) != 0) {
+        fprintf(stderr, "Could not write glyph cache '%s': %s\n", cache->path, strerror(errno));
+        unlink(tmp);
+        return 0;
+    }
+    cache->saved = cache->count;
+    return 1;
+}
+
+void font_cache_close(FontCache* cache) {
+    if (!cache) return;
+    for (size_t i = cache->loaded; i < cache->count; i++) free((void*)cache->glyphs[i].pixels);
+    free(cache->glyphs);
+    if (cache->map) munmap((void*)cache->map, cache->map_size);
+    free(cache);
+}
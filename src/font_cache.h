@@ -0,0 +1,69 @@
+#ifndef FONT_CACHE_H
+#define FONT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * On-disk glyph cache
+ * Rasterized glyph bitmaps and metrics are kept in
+ * $XDG_CACHE_HOME/mag-terminal/glyphs-<key>.bin, where the key hashes the primary font
+ * file's contents, the fallback fonts' paths, sizes and modification times, the pixel size,
+ * the content scale and the FreeType load flags, so any change to those simply misses.
+ * A file is:
+ *   magic "MAGTGLY1" | version (u32) | glyph count (u32) | key (u64)
+ * followed by one record per glyph:
+ *   code point (u32) | font (u32) | width, height, bearing x, bearing y (i32) | advance (u32) | pixels
+ * with width * height bytes of 8-bit coverage, top row first, in native byte order.
+ *
+ * The file is mapped at startup and its glyphs point straight into the mapping. Glyphs
+ * rasterized during the session are added and the file is rewritten (through a temporary
+ * file and rename) when the cache is saved.
+ */
+
+typedef struct {
+    uint32_t codepoint;
+    uint32_t font;                 // position in the fallback chain, 0 for the primary font
+    int32_t width;
+    int32_t height;
+    int32_t bearing_x;
+    int32_t bearing_y;
+    uint32_t advance;              // 26.6 fixed point, as FreeType reports it
+    const unsigned char* pixels;   // width * height bytes, rows packed without padding
+} CachedGlyph;
+
+typedef struct FontCache FontCache;
+
+/**
+ * Opens the cache for a font configuration, mapping an existing cache file if one matches
+ * @param font_paths - Font files of the fallback chain, primary first, hashed into the key
+ * @param font_count - Number of font files
+ * @param pixel_size - Pixel height the glyphs are rendered at
+ * @param scale - Content scale the pixel size was derived from
+ * @param load_flags - FreeType load flags used to rasterize
+ * @return New cache (possibly empty), or NULL if the primary font file cannot be read
+ */
+FontCache* font_cache_open(const char* const* font_paths, int font_count, int pixel_size, float scale, int32_t load_flags);
+
+/** Number of glyphs available, loaded and added */
+size_t font_cache_count(const FontCache* cache);
+
+/** Glyph by index, in file order followed by the added glyphs */
+const CachedGlyph* font_cache_glyph(const FontCache* cache, size_t index);
+
+/**
+ * Records a freshly rasterized glyph; the pixels are copied
+ * @param pitch - Bytes from one source row to the next
+ */
+void font_cache_add(FontCache* cache, const CachedGlyph* glyph, int pitch);
+
+/**
+ * Rewrites the cache file if glyphs were added since it was opened or last saved
+ * @return 1 on success or when nothing changed, 0 if the file could not be written
+ */
+int font_cache_save(FontCache* cache);
+
+/** Unmaps the file and frees added glyphs; pointers into the cache become invalid */
+void font_cache_close(FontCache* cache);
+
+#endif // FONT_CACHE_H
@@ -0,0 +1,34 @@
+#include "font_coverage.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define COVERAGE_BLOCK_WORDS ((1u << COVERAGE_BLOCK_BITS) / 64)
+
+FontCoverage* coverage_create(void) {
+    FontCoverage* coverage = calloc(1, sizeof(FontCoverage));
+    if (!coverage) {
+        fprintf(stderr, "Font coverage could not be allocated");
+        abort();
+    }
+    return coverage;
+}
+
+void coverage_destroy(FontCoverage* coverage) {
+    if (!coverage) return;
+    for (uint32_t i = 0; i < COVERAGE_BLOCKS; i++) free(coverage->blocks[i]);
+    free(coverage);
+}
+
+void coverage_add(FontCoverage* coverage, uint32_t codepoint) {
+    if (codepoint >= COVERAGE_LIMIT) return;
+    uint64_t** block = &coverage->blocks[codepoint >> COVERAGE_BLOCK_BITS];
+    if (!*block) {
+        *block = calloc(COVERAGE_BLOCK_WORDS, sizeof(uint64_t));
+        if (!*block) {
+            fprintf(stderr, "Font coverage could not be allocated");
+            abort();
+        }
+    }
+    uint32_t bit = codepoint & ((1u << COVERAGE_BLOCK_BITS) - 1);
+    (*block)[bit >> 6] |= (uint64_t)1 << (bit & 63);
+}
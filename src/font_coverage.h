@@ -0,0 +1,39 @@
+#ifndef FONT_COVERAGE_H
+#define FONT_COVERAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Code point coverage of a font
+ * A two-level bitmap over the Unicode range: the top level has one entry per block of
+ * 4096 code points, pointing at a 512-byte bitmap or NULL when the font has nothing in
+ * that block. A Latin font costs a handful of blocks, a CJK font a few dozen, and a query
+ * is two memory loads.
+ */
+
+#define COVERAGE_BLOCK_BITS 12
+#define COVERAGE_LIMIT 0x110000u
+#define COVERAGE_BLOCKS (COVERAGE_LIMIT >> COVERAGE_BLOCK_BITS)
+
+typedef struct {
+    uint64_t* blocks[COVERAGE_BLOCKS];
+} FontCoverage;
+
+/** Empty coverage, aborts if it could not be allocated */
+FontCoverage* coverage_create(void);
+
+void coverage_destroy(FontCoverage* coverage);
+
+/** Marks a code point as covered; code points past U+10FFFF are ignored */
+void coverage_add(FontCoverage* coverage, uint32_t codepoint);
+
+/** Whether the font has a glyph for the code point */
+static inline bool coverage_has(const FontCoverage* coverage, uint32_t codepoint) {
+    if (codepoint >= COVERAGE_LIMIT) return false;
+    const uint64_t* block = coverage->blocks[codepoint >> COVERAGE_BLOCK_BITS];
+    uint32_t bit = codepoint & ((1u << COVERAGE_BLOCK_BITS) - 1);
+    return block && (block[bit >> 6] >> (bit & 63)) & 1;
+}
+
+#endif // FONT_COVERAGE_H
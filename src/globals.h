@@ -1,20 +1,24 @@
 #ifndef GLOBALS_H
 #define GLOBALS_H
 
+#include <stdbool.h>
+
 // @param screenWidth - Width Of The Screen | ushort
 // @param screenHeight - Height Of The Screen | ushort
 // @param fontSize - Size of text on screen | short 
-// @param maxLines - Maximum amount of lines held in the buffer | uint 
-// @param maxLineLength - The maximum amount of characters held in a single line | uint 
 // @param linePadding - The amount of pixels between lines of text | ushort 
+// @param scrollbackLines - Lines of uncompressed history kept above the screen | uint 
+// @param scrollbackBudgetMB - Memory allowed for compressed history, 0 disables it | uint 
+// @param scrollbackSpill - Spill history over the budget to disk instead of dropping it | bool 
 extern short fontSize;
 extern int bufferScreenWidth;
 extern int bufferScreenHeight;
 extern float xScale;
 extern float yScale;
 
-extern unsigned int maxLines;
-extern unsigned int maxLineLength;
 extern unsigned short linePadding;
+extern unsigned int scrollbackLines;
+extern unsigned int scrollbackBudgetMB;
+extern bool scrollbackSpill;
 
 #endif
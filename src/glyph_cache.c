@@ -0,0 +1,204 @@
+#include "glyph_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_ENTRY UINT32_MAX
+
+typedef struct {
+    GlyphKey key;
+    Character ch;
+    GlyphState state;
+    bool used;
+    uint32_t prev;          // towards the most recently used end
+    uint32_t next;          // towards the least recently used end
+} GlyphEntry;
+
+// Hash slots hold entry index + 1 so that 0 marks an empty slot
+struct GlyphCache {
+    GlyphEntry* entries;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t* slots;
+    uint32_t slot_mask;     // slots are twice the entries, so the hash is at most half full
+    uint32_t newest;
+    uint32_t oldest;
+    uint32_t free_list;     // evicted entries, linked through next
+    GlyphCacheStats stats;
+};
+
+static uint32_t key_hash(GlyphKey key) {
+    uint64_t h = key * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    return (uint32_t)h;
+}
+
+static void* cache_calloc(size_t count, size_t size) {
+    void* p = calloc(count, size);
+    if (!p) {
+        fprintf(stderr, "Glyph cache could not be allocated");
+        abort();
+    }
+    return p;
+}
+
+GlyphCache* glyph_cache_create(uint32_t capacity) {
+    uint32_t size = 16;
+    while (size < capacity) size *= 2;
+    GlyphCache* cache = cache_calloc(1, sizeof(GlyphCache));
+    cache->entries = cache_calloc(size, sizeof(GlyphEntry));
+    cache->slots = cache_calloc((size_t)size * 2, sizeof(uint32_t));
+    cache->capacity = size;
+    cache->slot_mask = size * 2 - 1;
+    cache->newest = cache->oldest = cache->free_list = NO_ENTRY;
+    return cache;
+}
+
+void glyph_cache_destroy(GlyphCache* cache) {
+    if (!cache) return;
+    free(cache->entries);
+    free(cache->slots);
+    free(cache);
+}
+
+static void list_unlink(GlyphCache* cache, uint32_t index) {
+    GlyphEntry* e = &cache->entries[index];
+    if (e->prev != NO_ENTRY) cache->entries[e->prev].next = e->next;
+    else cache->newest = e->next;
+    if (e->next != NO_ENTRY) cache->entries[e->next].prev = e->prev;
+    else cache->oldest = e->prev;
+}
+
+static void list_push_newest(GlyphCache* cache, uint32_t index) {
+    GlyphEntry* e = &cache->entries[index];
+    e->prev = NO_ENTRY;
+    e->next = cache->newest;
+    if (cache->newest != NO_ENTRY) cache->entries[cache->newest].prev = index;
+    cache->newest = index;
+    if (cache->oldest == NO_ENTRY) cache->oldest = index;
+}
+
+static uint32_t find_slot(const GlyphCache* cache, GlyphKey key) {
+    uint32_t i = key_hash(key) & cache->slot_mask;
+    while (cache->slots[i]) {
+        if (cache->entries[cache->slots[i] - 1].key == key) return i;
+        i = (i + 1) & cache->slot_mask;
+    }
+    return NO_ENTRY;
+}
+
+// Empties a slot and shifts later members of its probe run back, so no tombstones are needed
+static void remove_slot(GlyphCache* cache, uint32_t hole) {
+    uint32_t i = hole;
+    for (;;) {
+        i = (i + 1) & cache->slot_mask;
+        if (!cache->slots[i]) break;
+        uint32_t home = key_hash(cache->entries[cache->slots[i] - 1].key) & cache->slot_mask;
+        // Move the entry into the hole unless its home lies cyclically in (hole, i]
+        bool stays = hole <= i ? (home > hole && home <= i) : (home > hole || home <= i);
+        if (!stays) {
+            cache->slots[hole] = cache->slots[i];
+            hole = i;
+        }
+    }
+    cache->slots[hole] = 0;
+}
+
+static void evict(GlyphCache* cache, uint32_t index) {
+    GlyphEntry* e = &cache->entries[index];
+    uint32_t slot = find_slot(cache, e->key);
+    if (slot != NO_ENTRY) remove_slot(cache, slot);
+    list_unlink(cache, index);
+    e->used = false;
+    e->next = cache->free_list;
+    cache->free_list = index;
+    cache->stats.evictions++;
+    cache->stats.entries--;
+}
+
+Character* glyph_cache_lookup(GlyphCache* cache, GlyphKey key, GlyphState* state) {
+    uint32_t slot = find_slot(cache, key);
+    if (slot == NO_ENTRY) {
+        cache->stats.misses++;
+        return NULL;
+    }
+    uint32_t index = cache->slots[slot] - 1;
+    if (cache->newest != index) {
+        list_unlink(cache, index);
+        list_push_newest(cache, index);
+    }
+    cache->stats.hits++;
+    if (state) *state = cache->entries[index].state;
+    return &cache->entries[index].ch;
+}
+
+Character* glyph_cache_peek(const GlyphCache* cache, GlyphKey key, GlyphState* state) {
+    uint32_t slot = find_slot(cache, key);
+    if (slot == NO_ENTRY) return NULL;
+    GlyphEntry* e = &cache->entries[cache->slots[slot] - 1];
+    if (state) *state = e->state;
+    return &e->ch;
+}
+
+Character* glyph_cache_insert(GlyphCache* cache, GlyphKey key, GlyphState state) {
+    uint32_t slot = find_slot(cache, key);
+    if (slot != NO_ENTRY) {
+        evict(cache, cache->slots[slot] - 1);
+        cache->stats.evictions--;    // replaced, not evicted
+    }
+
+    // Reuse an evicted entry, then untouched ones, and only then recycle the oldest
+    uint32_t index;
+    if (cache->free_list != NO_ENTRY) {
+        index = cache->free_list;
+        cache->free_list = cache->entries[index].next;
+    } else if (cache->count < cache->capacity) {
+        index = cache->count++;
+    } else {
+        evict(cache, cache->oldest);
+        index = cache->free_list;
+        cache->free_list = cache->entries[index].next;
+    }
+
+    GlyphEntry* e = &cache->entries[index];
+    memset(e, 0, sizeof(*e));
+    e->key = key;
+    e->state = state;
+    e->used = true;
+    list_push_newest(cache, index);
+
+    uint32_t i = key_hash(key) & cache->slot_mask;
+    while (cache->slots[i]) i = (i + 1) & cache->slot_mask;
+    cache->slots[i] = index + 1;
+    cache->stats.entries++;
+    return &e->ch;
+}
+
+size_t glyph_cache_evict_oldest_page(GlyphCache* cache, int (*reset_page)(unsigned int texture, void* ctx), void* ctx) {
+    for (uint32_t index = cache->oldest; index != NO_ENTRY; index = cache->entries[index].prev) {
+        unsigned int texture = cache->entries[index].ch.TextureID;
+        if (texture == 0 || !reset_page(texture, ctx)) continue;
+
+        size_t evicted = 0;
+        for (uint32_t i = 0; i < cache->count; i++) {
+            GlyphEntry* e = &cache->entries[i];
+            if (e->used && e->ch.TextureID == texture) {
+                evict(cache, i);
+                evicted++;
+            }
+        }
+        return evicted;
+    }
+    return 0;
+}
+
+void glyph_cache_clear(GlyphCache* cache) {
+    memset(cache->slots, 0, sizeof(uint32_t) * ((size_t)cache->slot_mask + 1));
+    cache->count = 0;
+    cache->newest = cache->oldest = cache->free_list = NO_ENTRY;
+    cache->stats.entries = 0;
+}
+
+GlyphCacheStats glyph_cache_stats(const GlyphCache* cache) {
+    return cache->stats;
+}
@@ -0,0 +1,78 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include "types.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Glyph cache
+ * Rasterized glyphs keyed on code point and font, in a fixed pool of entries indexed by an
+ * open-addressing hash (linear probing, backward-shift deletion) and ordered by last use.
+ * Lookups are O(1) however many glyphs are cached. When the pool is full the least recently
+ * used entry is recycled; when the atlas is full the owner frees the page holding the least
+ * recently used glyph with glyph_cache_evict_oldest_page. Entry pointers stay valid until
+ * that entry is evicted.
+ */
+
+/** Cache key: code point in the low 32 bits, font slot above */
+typedef uint64_t GlyphKey;
+#define GLYPH_KEY(codepoint, font) (((uint64_t)(font) << 32) | (uint32_t)(codepoint))
+
+/** What an entry knows about its glyph */
+typedef enum {
+    GLYPH_READY = 0,     // rasterized, the Character is filled in
+    GLYPH_MISSING,       // the font has no glyph for the code point
+    GLYPH_PENDING,       // queued for rasterization, not available yet
+} GlyphState;
+
+typedef struct {
+    size_t hits;
+    size_t misses;
+    size_t evictions;   // entries dropped to make room, in the pool or the atlas
+    size_t entries;     // entries currently cached
+} GlyphCacheStats;
+
+typedef struct GlyphCache GlyphCache;
+
+/**
+ * Creates an empty cache
+ * @param capacity - Number of glyph entries, rounded up to a power of two
+ * @return New cache, aborts if it could not be allocated
+ */
+GlyphCache* glyph_cache_create(uint32_t capacity);
+
+void glyph_cache_destroy(GlyphCache* cache);
+
+/**
+ * Cached glyph for a key, marking it most recently used
+ * @param state - Receives the entry's state
+ * @return The entry's glyph, or NULL on a miss
+ */
+Character* glyph_cache_lookup(GlyphCache* cache, GlyphKey key, GlyphState* state);
+
+/** Like glyph_cache_lookup, but leaves the LRU order and the counters alone */
+Character* glyph_cache_peek(const GlyphCache* cache, GlyphKey key, GlyphState* state);
+
+/**
+ * Adds a key, or replaces its entry, recycling the least recently used entry if the pool
+ * is full. Missing and pending entries stop the key from being loaded again.
+ * @return Zeroed glyph for the caller to fill in
+ */
+Character* glyph_cache_insert(GlyphCache* cache, GlyphKey key, GlyphState state);
+
+/**
+ * Frees atlas space: walks entries from least recently used, asks reset_page to clear the
+ * page of each glyph in turn, and evicts every entry on the first page it agreed to clear
+ * @param reset_page - Clears the page texture, returns 0 if that page must be kept
+ * @return Number of entries evicted, 0 if no page could be cleared
+ */
+size_t glyph_cache_evict_oldest_page(GlyphCache* cache, int (*reset_page)(unsigned int texture, void* ctx), void* ctx);
+
+/** Drops every entry, the counters are kept */
+void glyph_cache_clear(GlyphCache* cache);
+
+GlyphCacheStats glyph_cache_stats(const GlyphCache* cache);
+
+#endif // GLYPH_CACHE_H
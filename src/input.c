@@ -1,45 +1,120 @@
 #include "input.h"
+#include "terminal_logic.h"
+#include "font.h"
 #include <stdio.h>
 #include <string.h>
 
 static ShellPTY* s_shell = NULL;
+static TerminalGrid* s_grid = NULL;
+static SearchState* s_search = NULL;
 static char input_buffer[256] = {0};
 static size_t input_pos = 0;
 
+// Typing always brings the view back to the live screen
+static void snap_to_bottom(void) {
+    if (s_grid) grid_scroll_view(s_grid, -s_grid->view_offset);
+}
+
+// The typed text is drawn over the cursor row, so editing it damages that row
+static void damage_input_row(void) {
+    if (s_grid) grid_damage_rows(s_grid, s_grid->cursor.row, s_grid->cursor.row);
+}
+
 static void char_callback(GLFWwindow* window, unsigned int codepoint) {
     if (!s_shell) return;
+    if (s_search && search_is_active(s_search)) {
+        search_append(s_search, s_grid, codepoint);
+        return;
+    }
+    snap_to_bottom();
     if (input_pos < sizeof(input_buffer) - 1) {
         input_buffer[input_pos++] = (char)codepoint;
         input_buffer[input_pos] = '\0';
     }
+    damage_input_row();
 }
 
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (action != GLFW_PRESS && action != GLFW_REPEAT) return;
     if (!s_shell) return;
 
+    // Shift+PageUp / Shift+PageDown page through the scrollback
+    if ((mods & GLFW_MOD_SHIFT) && s_grid && (key == GLFW_KEY_PAGE_UP || key == GLFW_KEY_PAGE_DOWN)) {
+        int page = s_grid->height > 1 ? s_grid->height - 1 : 1;
+        grid_scroll_view(s_grid, key == GLFW_KEY_PAGE_UP ? page : -page);
+        return;
+    }
+
+    // Ctrl+= / Ctrl+- zoom, Ctrl+0 goes back to the default size. The main loop sees the
+    // new cell size and lays the grid out again.
+    if ((mods & GLFW_MOD_CONTROL) && !(mods & GLFW_MOD_SHIFT)) {
+        int size = getFontSize();
+        if (key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD) size++;
+        else if (key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT) size--;
+        else if (key == GLFW_KEY_0 || key == GLFW_KEY_KP_0) size = FONT_SIZE_DEFAULT;
+        if (size != getFontSize()) {
+            if (!setFontSize(size)) fprintf(stderr, "Font could not be loaded at size %d\n", size);
+            return;
+        }
+    }
+
+    // Ctrl+Shift+F opens the search bar. While it is open Enter / Shift+Enter step to the
+    // previous / next match, Ctrl+R toggles regex mode and Escape closes it.
+    if (s_search && s_grid) {
+        if (key == GLFW_KEY_F && (mods & GLFW_MOD_CONTROL) && (mods & GLFW_MOD_SHIFT)) {
+            search_open(s_search, s_grid);
+            grid_damage_all(s_grid);
+            return;
+        }
+        if (search_is_active(s_search)) {
+            if (key == GLFW_KEY_ESCAPE) {
+                search_close(s_search);
+                grid_damage_all(s_grid);
+            } else if (key == GLFW_KEY_ENTER || key == GLFW_KEY_KP_ENTER) {
+                search_step(s_search, s_grid, (mods & GLFW_MOD_SHIFT) ? 1 : -1);
+            } else if (key == GLFW_KEY_BACKSPACE) {
+                search_backspace(s_search, s_grid);
+            } else if (key == GLFW_KEY_R && (mods & GLFW_MOD_CONTROL)) {
+                search_toggle_regex(s_search, s_grid);
+            }
+            return;
+        }
+    }
+
     if (key == GLFW_KEY_ENTER) {
+        snap_to_bottom();
         input_buffer[input_pos] = '\0';
         shell_send(s_shell, input_buffer);
         input_pos = 0;
         memset(input_buffer, 0, sizeof(input_buffer));
+        damage_input_row();
     } else if (key == GLFW_KEY_BACKSPACE) {
         if (input_pos > 0) {
             input_pos--;
             input_buffer[input_pos] = '\0';
+            damage_input_row();
         }
     } else if (key == GLFW_KEY_TAB) {
         if (input_pos < sizeof(input_buffer) - 1) {
             input_buffer[input_pos++] = '\t';
             input_buffer[input_pos] = '\0';
+            damage_input_row();
         }
     }
 }
 
-void setup_input_callbacks(GLFWwindow* window, ShellPTY* shell) {
+static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+    if (!s_grid) return;
+    grid_scroll_view(s_grid, (int)(yoffset * 3));
+}
+
+void setup_input_callbacks(GLFWwindow* window, ShellPTY* shell, TerminalGrid* grid, SearchState* search) {
     s_shell = shell;
+    s_grid = grid;
+    s_search = search;
     glfwSetCharCallback(window, char_callback);
     glfwSetKeyCallback(window, key_callback);
+    glfwSetScrollCallback(window, scroll_callback);
 }
 
 const char* input_get_buffer() {
@@ -1,8 +1,11 @@
 #pragma once
 #include <GLFW/glfw3.h>
 #include "shell.h"
+#include "types.h"
+#include "search.h"
 
-void setup_input_callbacks(GLFWwindow* window, ShellPTY* shell);
+// While search is active, typing edits the query instead of going to the shell
+void setup_input_callbacks(GLFWwindow* window, ShellPTY* shell, TerminalGrid* grid, SearchState* search);
 
 // Accessors for current input buffer so renderer can overlay typed text
 const char* input_get_buffer();
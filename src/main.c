@@ -1,176 +1,359 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-#include <stdbool.h>
-
-
-#include "types.h"
-#include "shaders.h"
-#include "font.h"
-#include "renderer.h"
-#include "textHandler.h"
-#include "globals.h"
-#include "shell.h"
-#include "terminal_logic.h"
-#include "input.h"
-
-
-extern Character Characters[128];
-extern GLuint VAO, VBO;
-
-unsigned short screenWidth = 800;
-unsigned short screenHeight = 600;
-
-int bufferScreenHeight, bufferScreenWidth;
-float xScale, yScale;
-
-// Cursor blinking
-static double blink_timer = 0.0;
-static double last_time = 0.0;
-static int cursor_visible = 1;
-#define BLINK_INTERVAL 0.5  // 500ms blink interval
-
-// Configuration: whether to render non-ASCII Nerd Font glyphs
-// When false, we will skip drawing them but still advance cursor width.
-// Later, when multi-font support is added, set this true to attempt rendering.
-static bool nerd_font_enabled = true;
-
-
-
-int main() {
-    if (!glfwInit()) return -1;
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-    
-
-    GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "Mag Terminal", NULL, NULL);
-    if (!window) { glfwTerminate(); return -1; }
-    glfwMakeContextCurrent(window);
-
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        fprintf(stderr,"GLAD init failed\n"); return -1;
-    }
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    glfwGetFramebufferSize(window, &bufferScreenWidth, &bufferScreenHeight);
-    glfwGetWindowContentScale(window, &xScale, &yScale);
-    last_time = glfwGetTime();
-    
-    // Set up input callbacks
-    // Shell is created below; callbacks will be finalized after shell launch
-
-    GLuint shader = createShaderProgram(vertexShaderSrc, fragmentShaderSrc);
-
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*6*4, NULL, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4*sizeof(float), 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    int loadedFont;
-
-    #if defined(_WIN32)
-    // Windows (both 32 and 64 bit)
-        loadedFont = loadFont("C:/Windows/Fonts/consola.ttf");
-    #elif defined(__APPLE__) && defined(__MACH__)
-	loadedFont = loadFont("/System/Library/Fonts/Menlo.ttc");
-    #elif defined(__linux__) || defined(__unix__) || defined(__posix__)
-        loadedFont = loadFont("/home/keagan/.local/share/fonts/SpaceMonoNerdFontMono-Regular.ttf");
-        //loadedFont = loadFont("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf");
-    #else
-        // Unknown OS
-        fptrintf(stderr,"Text is not setup for this OS yet\n");
-    #endif
-
-    if (!loadedFont) {
-        fprintf(stderr,"Font load failed\n"); return -1;
-    }
-
-    float projection[16] = {0};
-    projection[0] = 2.0f / bufferScreenWidth;
-    projection[5] = 2.0f / bufferScreenHeight;
-    projection[10] = -1.0f;
-    projection[12] = -1.0f;
-    projection[13] = -1.0f;
-    projection[15] = 1.0f;
-
-    glUseProgram(shader);
-    glUniformMatrix4fv(glGetUniformLocation(shader,"projection"), 1, GL_FALSE, projection);
-
-    
-    initTextHandler(); 
-    TextBuffer* textBuffer = createTextBuffer();
-    if(!textBuffer) {fprintf(stderr, "Text buffer not alocated"); exit(1);}
-    fprintf(stderr, "Text Handler Created\n");
-    
-    TerminalGrid termGrid = createTerminalGrid();
-   
-
-    char shellPath[] = "/bin/bash";
-    ShellPTY shell = launch_shell(shellPath);
-    
-    // Finalize input callbacks now that shell is available
-    setup_input_callbacks(window, &shell);
-
-    char temp[1024];
-    ParserState parser_state = {0};  // Initialize parser state
-    parser_state.fg_color = -1;
-    parser_state.bg_color = -1;
-
-    // Main loop
-    while (!glfwWindowShouldClose(window)) {
-        // Update cursor blink using frame delta time
-        double now = glfwGetTime();
-        double dt = now - last_time;
-        last_time = now;
-        blink_timer += dt;
-        if (blink_timer >= BLINK_INTERVAL) {
-            blink_timer -= BLINK_INTERVAL;
-            cursor_visible = !cursor_visible;
-        }
-        
-        glClearColor(COLOR4_BLACK.r, COLOR4_BLACK.g, COLOR4_BLACK.b, COLOR4_BLACK.a);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ssize_t n = shell_receive(&shell, temp, sizeof(temp)-1);
-
-        if (n > 0) {
-            temp[n] = '\0';
-            // Parse raw bytes in real-time into grid
-            process_output_bytes(&termGrid, temp, n, &parser_state);
-        }
-
-        // Render the grid every frame so cursor blinks regardless of shell output
-        renderGrid(shader, &termGrid, nerd_font_enabled, cursor_visible);
-        printBuffer(textBuffer, shader);
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
-
-    freeTextBuffer(textBuffer);
-    freeGrid(&termGrid);
-
-
-    for (int i=0; i<128; i++) glDeleteTextures(1, &Characters[i].TextureID);
-    glDeleteProgram(shader);
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-
-    glfwDestroyWindow(window);
-    glfwTerminate();
-
-
-    return 0;
-}
-
+#include <stdio.h>
+#include <stdlib.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <stdbool.h>
+
+
+#include "types.h"
+#include "shaders.h"
+#include "font.h"
+#include "renderer.h"
+#include "globals.h"
+#include "shell.h"
+#include "terminal_logic.h"
+#include "input.h"
+#include "scrollback.h"
+#include "search.h"
+#include "session_log.h"
+#include "fd_watch.h"
+#include <errno.h>
+#include <string.h>
+
+
+extern Character Characters[128];
+
+unsigned short screenWidth = 800;
+unsigned short screenHeight = 600;
+
+int bufferScreenHeight, bufferScreenWidth;
+float xScale, yScale;
+
+// Cursor blinking
+static double next_blink = 0.0;
+static int cursor_visible = 1;
+#define BLINK_INTERVAL 0.5  // 500ms blink interval
+
+// Time spent draining shell output before a frame is drawn anyway
+#define FRAME_BUDGET (1.0 / 120.0)
+
+// Longest a synchronized update (CSI ?2026h) may hold presentation without its end marker
+#define SYNC_UPDATE_TIMEOUT 0.15
+
+// Set when the window system lost our contents (expose, restore) and a full redraw is needed
+static bool window_needs_redraw = true;
+
+static void window_refresh_callback(GLFWwindow* window) {
+    (void)window;
+    window_needs_redraw = true;
+}
+
+// Resizing is applied once the framebuffer size has been stable for RESIZE_DEBOUNCE, so
+// dragging a window edge reflows the grid and signals the shell once instead of per pixel
+#define RESIZE_DEBOUNCE 0.05
+static bool resize_pending = false;
+static double resize_requested_at = 0.0;
+
+static void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    (void)window;
+    if (width <= 0 || height <= 0) return; // minimized
+    bufferScreenWidth = width;
+    bufferScreenHeight = height;
+    resize_pending = true;
+    resize_requested_at = glfwGetTime();
+    window_needs_redraw = true;
+}
+
+// Moving to a monitor with another scale resizes the glyphs like a zoom does
+static void content_scale_callback(GLFWwindow* window, float xscale, float yscale) {
+    (void)window;
+    xScale = xscale;
+    yScale = yscale;
+    if (!setFontSize(getFontSize())) fprintf(stderr, "Font could not be loaded at the new scale\n");
+}
+
+static void update_viewport(void) {
+    glViewport(0, 0, bufferScreenWidth, bufferScreenHeight);
+}
+
+// Configuration: whether to render non-ASCII Nerd Font glyphs
+// When false, we will skip drawing them but still advance cursor width.
+// Later, when multi-font support is added, set this true to attempt rendering.
+static bool nerd_font_enabled = true;
+
+// Rasterize Powerline and common icon glyphs in the background once idle
+static bool prewarm_glyphs = true;
+
+
+
+int main(int argc, char** argv) {
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    bool replayFast = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--spill-scrollback") == 0) {
+            scrollbackSpill = true;
+        } else if (strcmp(argv[i], "--sdf-glyphs") == 0) {
+            setSdfGlyphs(true);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay-fast") == 0) {
+            replayFast = true;
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            fprintf(stderr, "Usage: %s [--spill-scrollback] [--sdf-glyphs] [--record FILE | --replay FILE [--replay-fast]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (recordPath && replayPath) {
+        fprintf(stderr, "--record and --replay cannot be combined\n");
+        return 1;
+    }
+
+    // Replay feeds a recorded session through the parser and renderer instead of a shell
+    SessionReplay* replay = NULL;
+    if (replayPath) {
+        replay = session_replay_open(replayPath, !replayFast);
+        if (!replay) return 1;
+    }
+
+    if (!glfwInit()) return -1;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    
+
+    GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "Mag Terminal", NULL, NULL);
+    if (!window) { glfwTerminate(); return -1; }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        fprintf(stderr,"GLAD init failed\n"); return -1;
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glfwGetFramebufferSize(window, &bufferScreenWidth, &bufferScreenHeight);
+    glfwGetWindowContentScale(window, &xScale, &yScale);
+    next_blink = glfwGetTime() + BLINK_INTERVAL;
+    
+    // Set up input callbacks
+    // Shell is created below; callbacks will be finalized after shell launch
+
+    int loadedFont;
+    setGlyphReadyCallback(glfwPostEmptyEvent);
+
+    // Fallbacks for what the primary font lacks: symbols and icons, then CJK. Files that
+    // are not installed are skipped.
+    #if defined(_WIN32)
+    // Windows (both 32 and 64 bit)
+        addFallbackFont("C:/Windows/Fonts/seguisym.ttf");
+        addFallbackFont("C:/Windows/Fonts/msgothic.ttc");
+        loadedFont = loadFont("C:/Windows/Fonts/consola.ttf");
+    #elif defined(__APPLE__) && defined(__MACH__)
+	addFallbackFont("/System/Library/Fonts/Apple Symbols.ttf");
+	addFallbackFont("/System/Library/Fonts/Hiragino Sans GB.ttc");
+	loadedFont = loadFont("/System/Library/Fonts/Menlo.ttc");
+    #elif defined(__linux__) || defined(__unix__) || defined(__posix__)
+        addFallbackFont("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf");
+        addFallbackFont("/usr/share/fonts/truetype/noto/NotoSansSymbols2-Regular.ttf");
+        addFallbackFont("/usr/share/fonts/opentype/noto/NotoSansCJK-Regular.ttc");
+        loadedFont = loadFont("/home/keagan/.local/share/fonts/SpaceMonoNerdFontMono-Regular.ttf");
+        //loadedFont = loadFont("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf");
+    #else
+        // Unknown OS
+        fptrintf(stderr,"Text is not setup for this OS yet\n");
+    #endif
+
+    if (!loadedFont) {
+        fprintf(stderr,"Font load failed\n"); return -1;
+    }
+
+    update_viewport();
+    renderer_init();
+
+    
+    int gridCols, gridRows;
+    if (replay) session_replay_size(replay, &gridCols, &gridRows);
+    else grid_size_for_pixels(bufferScreenWidth, bufferScreenHeight, &gridCols, &gridRows);
+    TerminalGrid termGrid = createTerminalGrid(gridCols, gridRows);
+    if (scrollbackSpill && !scrollback_enable_spill(termGrid.cold)) {
+        fprintf(stderr, "Scrollback spill unavailable, old history will be dropped\n");
+    }
+   
+
+    char shellPath[] = "/bin/bash";
+    ShellPTY shell = {.master_fd = -1};
+    if (!replay) shell = launch_shell(shellPath, termGrid.width, termGrid.height);
+    if (recordPath) {
+        shell.recorder = session_recorder_open(recordPath, termGrid.width, termGrid.height);
+        if (!shell.recorder) return 1;
+    }
+    
+    SearchState* search = search_create();
+
+    // Finalize input callbacks now that shell is available
+    setup_input_callbacks(window, &shell, &termGrid, search);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowContentScaleCallback(window, content_scale_callback);
+
+    static char temp[1 << 16];
+    ParserState parser_state = {0};  // Initialize parser state
+    double sync_started = -1.0;
+    size_t replay_bytes = 0;
+    double replay_started = -1.0;
+    int cell_advance = getCellAdvance();
+    float line_spacing = getLineSpacing();
+
+    // The loop sleeps in the GLFW event queue; shell output wakes it through this watcher
+    FdWatch* shell_watch = replay ? NULL : fd_watch_start(shell.master_fd, glfwPostEmptyEvent);
+
+    // Main loop
+    while (!glfwWindowShouldClose(window)) {
+        double now = glfwGetTime();
+        if (now >= next_blink) {
+            cursor_visible = !cursor_visible;
+            grid_damage_rows(&termGrid, termGrid.cursor.row, termGrid.cursor.row);
+            next_blink += BLINK_INTERVAL;
+            if (next_blink <= now) next_blink = now + BLINK_INTERVAL; // after a long stall
+        }
+
+        // Drain the shell until it is empty or the frame budget is spent, so a burst of
+        // output turns into one frame instead of one per read
+        ssize_t n;
+        bool received = false;
+        bool more_output = false;   // the budget ran out before the source was empty
+        if (replay) {
+            // Recorded reads are handed over straight from the mapped log, with their
+            // original boundaries, either when they are due or as fast as frames allow
+            SessionRecord record;
+            if (replay_started < 0) replay_started = now;
+            while (session_replay_next(replay, now, &record)) {
+                if (record.kind == SESSION_OUTPUT) {
+                    process_output_bytes(&termGrid, record.data, (ssize_t)record.len, &parser_state);
+                    replay_bytes += record.len;
+                    received = true;
+                } else if (record.kind == SESSION_RESIZE) {
+                    grid_resize(&termGrid, &parser_state, record.cols, record.rows);
+                }
+                if (glfwGetTime() - now >= FRAME_BUDGET) {
+                    more_output = true;
+                    break;
+                }
+            }
+            if (replay_bytes > 0 && session_replay_finished(replay)) {
+                fprintf(stderr, "Replayed %zu bytes in %.3f s\n", replay_bytes, glfwGetTime() - replay_started);
+                replay_bytes = 0;
+            }
+        } else {
+            while ((n = shell_receive(&shell, temp, sizeof(temp))) > 0) {
+                process_output_bytes(&termGrid, temp, n, &parser_state);
+                received = true;
+                if (glfwGetTime() - now >= FRAME_BUDGET) {
+                    more_output = true;
+                    break;
+                }
+            }
+            // Only an empty PTY re-arms the watcher: once the shell has exited the read
+            // fails with EIO, and the watcher stays quiet instead of waking us forever
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) fd_watch_rearm(shell_watch);
+        }
+        // An open search follows new output: only the new lines and the screen are scanned
+        if (received) search_refresh(search, &termGrid);
+        if (parser_state.title_changed) {
+            glfwSetWindowTitle(window, parser_state.title);
+            parser_state.title_changed = 0;
+        }
+
+        // Hold presentation while the application is inside a synchronized update. A missing
+        // end marker only freezes the screen for SYNC_UPDATE_TIMEOUT.
+        bool hold_frame = false;
+        if (parser_state.sync_update) {
+            if (sync_started < 0) sync_started = now;
+            if (now - sync_started < SYNC_UPDATE_TIMEOUT) hold_frame = true;
+            else parser_state.sync_update = 0;
+        }
+        if (!parser_state.sync_update) sync_started = -1.0;
+
+        // A zoom or a new content scale changes the cell size, the grid follows right away
+        bool cells_changed = getCellAdvance() != cell_advance || getLineSpacing() != line_spacing;
+        if (cells_changed) {
+            cell_advance = getCellAdvance();
+            line_spacing = getLineSpacing();
+            window_needs_redraw = true;
+        }
+
+        // A replay keeps the recorded grid size, the window only changes the projection
+        if (replay) resize_pending = false;
+        if ((resize_pending && now - resize_requested_at >= RESIZE_DEBOUNCE) || (cells_changed && !replay)) {
+            resize_pending = false;
+            int cols, rows;
+            grid_size_for_pixels(bufferScreenWidth, bufferScreenHeight, &cols, &rows);
+            if (cols != termGrid.width || rows != termGrid.height) {
+                grid_resize(&termGrid, &parser_state, cols, rows);
+                shell_resize(&shell, termGrid.width, termGrid.height, bufferScreenWidth, bufferScreenHeight);
+            }
+        }
+
+        // Glyphs finished by the rasterizer threads replace the placeholders drawn so far
+        if (uploadReadyGlyphs() > 0) grid_damage_all(&termGrid);
+
+        if (window_needs_redraw) {
+            update_viewport();
+            grid_damage_all(&termGrid);
+            window_needs_redraw = false;
+        }
+
+        // Only draw a frame when something changed; otherwise the last frame stays up
+        if (!hold_frame && grid_take_damage(&termGrid, NULL) > 0) {
+            glClearColor(COLOR4_BLACK.r, COLOR4_BLACK.g, COLOR4_BLACK.b, COLOR4_BLACK.a);
+            glClear(GL_COLOR_BUFFER_BIT);
+            renderGrid(&termGrid, search, nerd_font_enabled, cursor_visible);
+            glfwSwapBuffers(window);
+        }
+
+        // Sleep until input, shell output (posted by the watcher) or the earliest timer:
+        // the blink, a pending resize, a held synchronized update or the next replay record
+        double deadline = next_blink;
+        if (resize_pending && resize_requested_at + RESIZE_DEBOUNCE < deadline) deadline = resize_requested_at + RESIZE_DEBOUNCE;
+        if (sync_started >= 0 && sync_started + SYNC_UPDATE_TIMEOUT < deadline) deadline = sync_started + SYNC_UPDATE_TIMEOUT;
+        double after_frame = glfwGetTime();
+        if (replay) {
+            double wait = session_replay_wait(replay, after_frame);
+            if (wait >= 0 && after_frame + wait < deadline) deadline = after_frame + wait;
+        } else if (!shell_watch && after_frame + FRAME_BUDGET < deadline) {
+            deadline = after_frame + FRAME_BUDGET; // no watcher thread, fall back to polling
+        }
+        double timeout = deadline - after_frame;
+        if (more_output || timeout <= 0) {
+            glfwPollEvents();
+        } else {
+            if (prewarm_glyphs && prewarmGlyphs()) prewarm_glyphs = false;
+            glfwWaitEventsTimeout(timeout);
+        }
+    }
+
+    fd_watch_stop(shell_watch);
+    search_destroy(search);
+    freeGrid(&termGrid);
+    session_recorder_close(shell.recorder);
+    session_replay_close(replay);
+
+
+    renderer_shutdown();
+    unloadFont();
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+
+    return 0;
+}
+
@@ -0,0 +1,218 @@
+#include "raster_pool.h"
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Queued requests are code point | font << 32
+typedef struct {
+    uint64_t* items;
+    size_t head;
+    size_t count;
+    size_t cap;
+} RequestQueue;
+
+typedef struct {
+    RasterPool* pool;
+    FT_Library library;
+    FT_Face faces[RASTER_MAX_FONTS];
+    bool opened[RASTER_MAX_FONTS];   // tried to open, faces[i] may still be NULL
+    pthread_t thread;
+} RasterWorker;
+
+struct RasterPool {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    RequestQueue urgent;
+    RequestQueue background;
+    RasterResult* done;
+    size_t done_count;
+    size_t done_cap;
+    int stop;
+    int32_t load_flags;
+    int pixel_size;
+    char* font_paths[RASTER_MAX_FONTS];
+    int font_count;
+    void (*wake)(void);
+    RasterWorker* workers;
+    int worker_count;
+};
+
+static void* raster_alloc(void* ptr, size_t size) {
+    void* p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "Glyph rasterizer could not be allocated");
+        abort();
+    }
+    return p;
+}
+
+static void queue_push(RequestQueue* queue, uint64_t request) {
+    if (queue->count == queue->cap) {
+        // Unroll the ring into the bigger buffer
+        size_t cap = queue->cap ? queue->cap * 2 : 256;
+        uint64_t* items = raster_alloc(NULL, cap * sizeof(uint64_t));
+        for (size_t i = 0; i < queue->count; i++) items[i] = queue->items[(queue->head + i) % queue->cap];
+        free(queue->items);
+        queue->items = items;
+        queue->head = 0;
+        queue->cap = cap;
+    }
+    queue->items[(queue->head + queue->count) % queue->cap] = request;
+    queue->count++;
+}
+
+static uint64_t queue_pop(RequestQueue* queue) {
+    uint64_t request = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->cap;
+    queue->count--;
+    return request;
+}
+
+static FT_Face open_face(RasterWorker* worker, int font) {
+    RasterPool* pool = worker->pool;
+    if (worker->opened[font]) return worker->faces[font];
+    worker->opened[font] = true;
+    if (FT_New_Face(worker->library, pool->font_paths[font], 0, &worker->faces[font])) {
+        worker->faces[font] = NULL;
+        return NULL;
+    }
+    FT_Select_Charmap(worker->faces[font], FT_ENCODING_UNICODE);
+    FT_Set_Pixel_Sizes(worker->faces[font], 0, (FT_UInt)pool->pixel_size);
+    return worker->faces[font];
+}
+
+static RasterResult rasterize(RasterWorker* worker, uint32_t codepoint, int font) {
+    RasterResult result = {.codepoint = codepoint, .font = font};
+    FT_Face face = font < worker->pool->font_count ? open_face(worker, font) : NULL;
+    FT_UInt index = face ? FT_Get_Char_Index(face, codepoint) : 0;
+    if (index == 0 || FT_Load_Glyph(face, index, worker->pool->load_flags)) {
+        result.missing = true;
+        return result;
+    }
+
+    FT_GlyphSlot slot = face->glyph;
+    result.width = (int)slot->bitmap.width;
+    result.height = (int)slot->bitmap.rows;
+    result.bearing_x = slot->bitmap_left;
+    result.bearing_y = slot->bitmap_top;
+    result.advance = (unsigned int)slot->advance.x;
+    size_t size = (size_t)result.width * (size_t)result.height;
+    result.pixels = raster_alloc(NULL, size ? size : 1);
+    for (int row = 0; row < result.height; row++) {
+        memcpy(result.pixels + (size_t)row * (size_t)result.width,
+               slot->bitmap.buffer + (ptrdiff_t)row * slot->bitmap.pitch, (size_t)result.width);
+    }
+    return result;
+}
+
+static void* worker_main(void* arg) {
+    RasterWorker* worker = arg;
+    RasterPool* pool = worker->pool;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->urgent.count == 0 && pool->background.count == 0) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->stop) break;
+        uint64_t request = pool->urgent.count ? queue_pop(&pool->urgent) : queue_pop(&pool->background);
+        pthread_mutex_unlock(&pool->lock);
+
+        RasterResult result = rasterize(worker, (uint32_t)request, (int)(request >> 32));
+
+        pthread_mutex_lock(&pool->lock);
+        if (pool->done_count == pool->done_cap) {
+            pool->done_cap = pool->done_cap ? pool->done_cap * 2 : 64;
+            pool->done = raster_alloc(pool->done, pool->done_cap * sizeof(RasterResult));
+        }
+        pool->done[pool->done_count++] = result;
+        // One wake-up per batch: the render thread takes everything that piled up meanwhile
+        if (pool->done_count == 1 && pool->wake) pool->wake();
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+RasterPool* raster_pool_create(const char* const* font_paths, int font_count, int pixel_size,
+                               int32_t load_flags, int threads, void (*wake)(void)) {
+    if (threads < 1) threads = 1;
+    if (font_count > RASTER_MAX_FONTS) font_count = RASTER_MAX_FONTS;
+    RasterPool* pool = raster_alloc(NULL, sizeof(RasterPool));
+    memset(pool, 0, sizeof(*pool));
+    pool->load_flags = load_flags;
+    pool->pixel_size = pixel_size;
+    for (int i = 0; i < font_count; i++) {
+        size_t len = strlen(font_paths[i]) + 1;
+        pool->font_paths[i] = memcpy(raster_alloc(NULL, len), font_paths[i], len);
+    }
+    pool->font_count = font_count;
+    pool->wake = wake;
+    pool->workers = raster_alloc(NULL, sizeof(RasterWorker) * (size_t)threads);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+
+    // Primary faces are opened here, so a font that cannot be loaded fails the whole pool up
+    // front; fallbacks are opened by each worker when first needed
+    for (int i = 0; i < threads && font_count > 0; i++) {
+        RasterWorker* worker = &pool->workers[pool->worker_count];
+        memset(worker, 0, sizeof(*worker));
+        worker->pool = pool;
+        if (FT_Init_FreeType(&worker->library)) break;
+        if (!open_face(worker, 0) || pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            if (worker->faces[0]) FT_Done_Face(worker->faces[0]);
+            FT_Done_FreeType(worker->library);
+            break;
+        }
+        pool->worker_count++;
+    }
+
+    if (pool->worker_count == 0) {
+        fprintf(stderr, "Glyph rasterizer threads could not be started, rasterizing on the render thread\n");
+        raster_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void raster_pool_destroy(RasterPool* pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        for (int font = 0; font < pool->font_count; font++) {
+            if (pool->workers[i].faces[font]) FT_Done_Face(pool->workers[i].faces[font]);
+        }
+        FT_Done_FreeType(pool->workers[i].library);
+    }
+    for (int font = 0; font < pool->font_count; font++) free(pool->font_paths[font]);
+    for (size_t i = 0; i < pool->done_count; i++) free(pool->done[i].pixels);
+    free(pool->done);
+    free(pool->urgent.items);
+    free(pool->background.items);
+    free(pool->workers);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    free(pool);
+}
+
+void raster_pool_request(RasterPool* pool, uint32_t codepoint, int font, bool background) {
+    pthread_mutex_lock(&pool->lock);
+    queue_push(background ? &pool->background : &pool->urgent, (uint64_t)font << 32 | codepoint);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+size_t raster_pool_take(RasterPool* pool, RasterResult* out, size_t max) {
+    pthread_mutex_lock(&pool->lock);
+    size_t n = pool->done_count < max ? pool->done_count : max;
+    memcpy(out, pool->done, n * sizeof(RasterResult));
+    memmove(pool->done, pool->done + n, (pool->done_count - n) * sizeof(RasterResult));
+    pool->done_count -= n;
+    pthread_mutex_unlock(&pool->lock);
+    return n;
+}
@@ -0,0 +1,64 @@
+#ifndef RASTER_POOL_H
+#define RASTER_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Background glyph rasterization
+ * A few worker threads, each with its own FreeType library and face (FreeType objects must
+ * not be shared between threads), turn queued code points into 8-bit coverage bitmaps. The
+ * render thread queues whatever it is missing, keeps drawing, and collects finished
+ * bitmaps later to upload them itself, since only it may touch GL.
+ *
+ * Each request names a font of the fallback chain the pool was created with; a worker opens
+ * its copy of a fallback face the first time it is asked for a glyph from it.
+ *
+ * Requests come in two priorities: glyphs on screen are served first, pre-warming requests
+ * only when nothing else is waiting.
+ */
+
+#define RASTER_MAX_FONTS 8
+
+typedef struct {
+    uint32_t codepoint;
+    int font;                  // index into the pool's font list
+    bool missing;              // the font has no glyph for it (or it failed to load)
+    int width;
+    int height;
+    int bearing_x;
+    int bearing_y;
+    unsigned int advance;      // 26.6 fixed point
+    unsigned char* pixels;     // width * height bytes, rows packed; owned by the receiver
+} RasterResult;
+
+typedef struct RasterPool RasterPool;
+
+/**
+ * Opens the primary font once per worker and starts the workers
+ * @param font_paths - Font files, primary first; at most RASTER_MAX_FONTS are used
+ * @param threads - Worker count, at least 1
+ * @param wake - Called from a worker when results become available after the last
+ *               raster_pool_take emptied them, must be thread-safe; may be NULL
+ * @return New pool, or NULL if the font could not be opened or no thread could start
+ */
+RasterPool* raster_pool_create(const char* const* font_paths, int font_count, int pixel_size, int32_t load_flags, int threads, void (*wake)(void));
+
+/** Stops the workers, dropping queued requests and unclaimed results */
+void raster_pool_destroy(RasterPool* pool);
+
+/**
+ * Queues a code point; the caller makes sure each one is requested only once
+ * @param font - Font to rasterize it with, an index into the list given at creation
+ * @param background - true for pre-warming, served only when no other request waits
+ */
+void raster_pool_request(RasterPool* pool, uint32_t codepoint, int font, bool background);
+
+/**
+ * Moves up to max finished glyphs into out; each result's pixels must be freed
+ * @return Number of results written
+ */
+size_t raster_pool_take(RasterPool* pool, RasterResult* out, size_t max);
+
+#endif // RASTER_POOL_H
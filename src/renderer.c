@@ -3,174 +3,435 @@
 #include "types.h"
 #include "font.h"
 #include "input.h"
+#include "terminal_logic.h"
+#include "style.h"
+#include "utf8.h"
+#include "shaders.h"
+#include "box_glyph.h"
 #include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-/** Vertex Array Object - stores vertex buffer configuration for text quads */
-GLuint VAO;
-/** Vertex Buffer Object - stores quad vertex data for rendering characters */
-GLuint VBO;
+// Search highlight colours: every match, the current match, and the query bar background
+static const color3 SEARCH_MATCH_COLOR = {0.55f, 0.45f, 0.1f};
+static const color3 SEARCH_CURRENT_COLOR = {1.0f, 0.6f, 0.0f};
+static const color3 SEARCH_BAR_COLOR = {0.2f, 0.2f, 0.2f};
+
+// Glyphs share a few atlas pages, so consecutive glyphs almost always need the texture that
+// is already bound. The atlas restores the binding after uploads, which keeps this in sync.
+static GLuint bound_texture = 0;
+
+static void bind_glyph_texture(GLuint texture) {
+    if (texture == bound_texture) return;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    bound_texture = texture;
+}
 
 /** Reference to the global character array loaded by the font module */
 extern Character Characters[128];
 extern float xScale, yScale;
 
-/**
- * Renders a text string to the screen at the specified position and color
- * For each character: calculates position and size based on glyph metrics and scale,
- * creates quad vertices, uploads them to GPU, binds the glyph texture, and draws the quad.
- * Cursor position is advanced for each character based on the advance metric.
- * @param shader - Compiled shader program to use for rendering
- * @param text - Null-terminated string to render
- * @param x - X position in screen coordinates
- * @param y - Y position in screen coordinates
- * @param scale - Scale factor for rendering (1.0 = normal size)
+/*
+ * Instanced grid renderer
+ *
+ * A frame is a list of quad instances: solid fills (cell backgrounds, highlights, underlines,
+ * the cursor) followed by glyphs grouped by atlas page. The list is streamed into an orphaned
+ * instance buffer and drawn with one glDrawArraysInstanced per atlas page in use, solids
+ * riding along with the first page. Solids are emitted first, so glyphs always land on top.
  */
 
+// How the fragment shader colours a quad
+enum { QUAD_SOLID = 0, QUAD_BITMAP = 1, QUAD_SDF = 2 };
 
-void renderText(GLuint shader, const char* text, float x, float y, float scale, color3 color) {
-    glUseProgram(shader);
-    glUniform3f(glGetUniformLocation(shader,"textColor"), color.r, color.g, color.b);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(VAO);
-    
-
-    for (const char* c=text; *c; c++) {
-        Character ch = Characters[(unsigned char)(*c)];
-        if(ch.TextureID == 0) continue;
-
-        float xpos = floorf(x + ch.BearingX * scale);
-        float ypos = floorf(y - (ch.Height - ch.BearingY) * scale);
-        float w = floorf(ch.Width * scale);
-        float h = floorf(ch.Height * scale);
-
-        float vertices[6][4] = {  
-    {xpos,     ypos,     0.0f, 0.0f},
-    {xpos,     ypos + h, 0.0f, 1.0f},
-    {xpos + w, ypos + h, 1.0f, 1.0f},
-
-    {xpos,     ypos,     0.0f, 0.0f},
-    {xpos + w, ypos + h, 1.0f, 1.0f},
-    {xpos + w, ypos,     1.0f, 0.0f}
-        };
-
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        x += (ch.Advance >> 6) * scale;
+typedef struct {
+    float rect[4];       // x, y, width, height in pixels, y up
+    float uv[4];         // u0, v0, u1, v1 atlas rectangle, unused for a solid fill
+    uint8_t color[4];    // RGBA
+    uint32_t kind;       // QUAD_*
+} QuadInstance;
+
+typedef struct {
+    GLuint texture;      // atlas page
+    QuadInstance* quads;
+    size_t count;
+    size_t cap;
+} QuadBatch;
+
+static GLuint grid_program = 0;
+static GLint grid_screen_location = -1;
+static GLuint grid_vao = 0;
+static GLuint grid_corner_vbo = 0;
+static GLuint grid_instance_vbo = 0;
+static size_t grid_instance_capacity = 0;   // instances the GPU buffer can hold
+
+static float glyph_scale = 1.0f;             // getGlyphScale() for this frame
+static QuadBatch solid_batch;
+static QuadBatch* glyph_batches = NULL;     // one per atlas page used this frame
+static size_t glyph_batch_count = 0;
+static size_t glyph_batch_cap = 0;
+static QuadInstance* upload = NULL;
+static size_t upload_cap = 0;
+
+static void batch_push(QuadBatch* batch, QuadInstance quad) {
+    if (batch->count == batch->cap) {
+        size_t cap = batch->cap ? batch->cap * 2 : 1024;
+        QuadInstance* quads = realloc(batch->quads, cap * sizeof(QuadInstance));
+        if (!quads) {
+            fprintf(stderr, "Render instances could not be allocated");
+            abort();
+        }
+        batch->quads = quads;
+        batch->cap = cap;
     }
+    batch->quads[batch->count++] = quad;
+}
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+static void set_color(QuadInstance* quad, color3 color) {
+    quad->color[0] = (uint8_t)(color.r * 255.0f + 0.5f);
+    quad->color[1] = (uint8_t)(color.g * 255.0f + 0.5f);
+    quad->color[2] = (uint8_t)(color.b * 255.0f + 0.5f);
+    quad->color[3] = 255;
 }
 
-void renderGlyph(GLuint shader, const Character* chPtr, float x, float y, float scale, color3 color) {
-    if (!chPtr || chPtr->TextureID == 0) return;
-    Character ch = *chPtr;
-    glUseProgram(shader);
-    glUniform3f(glGetUniformLocation(shader,"textColor"), color.r, color.g, color.b);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(VAO);
+static void push_solid(float x, float y, float w, float h, color3 color) {
+    QuadInstance quad = {{x, y, w, h}, {0.0f, 0.0f, 0.0f, 0.0f}, {0}, QUAD_SOLID};
+    set_color(&quad, color);
+    batch_push(&solid_batch, quad);
+}
 
-    float xpos = floorf(x + ch.BearingX * scale);
-    float ypos = floorf(y - (ch.Height - ch.BearingY) * scale);
-    float w = floorf(ch.Width * scale);
-    float h = floorf(ch.Height * scale);
+// Queue a glyph whose pen position (baseline, left edge of the cell) is x, baseline
+static void push_glyph(const Character* ch, float x, float baseline, color3 color) {
+    if (!ch || ch->TextureID == 0) return;
 
-    float vertices[6][4] = {
-        {xpos,     ypos,     0.0f, 0.0f},
-        {xpos,     ypos + h, 0.0f, 1.0f},
-        {xpos + w, ypos + h, 1.0f, 1.0f},
+    QuadBatch* batch = NULL;
+    for (size_t i = 0; i < glyph_batch_count; i++) {
+        if (glyph_batches[i].texture == ch->TextureID) {
+            batch = &glyph_batches[i];
+            break;
+        }
+    }
+    if (!batch) {
+        if (glyph_batch_count == glyph_batch_cap) {
+            size_t cap = glyph_batch_cap ? glyph_batch_cap * 2 : 4;
+            QuadBatch* batches = realloc(glyph_batches, cap * sizeof(QuadBatch));
+            if (!batches) {
+                fprintf(stderr, "Render instances could not be allocated");
+                abort();
+            }
+            memset(batches + glyph_batch_cap, 0, (cap - glyph_batch_cap) * sizeof(QuadBatch));
+            glyph_batches = batches;
+            glyph_batch_cap = cap;
+        }
+        batch = &glyph_batches[glyph_batch_count++];
+        batch->texture = ch->TextureID;
+        batch->count = 0;
+    }
 
-        {xpos,     ypos,     0.0f, 0.0f},
-        {xpos + w, ypos + h, 1.0f, 1.0f},
-        {xpos + w, ypos,     1.0f, 0.0f}
+    QuadInstance quad = {
+        {floorf(x + ch->BearingX), floorf(baseline - (ch->Height - ch->BearingY)), (float)ch->Width, (float)ch->Height},
+        {ch->u0, ch->v0, ch->u1, ch->v1},
+        {0},
+        QUAD_BITMAP
     };
+    if (ch->Sdf) {
+        // Distance fields are scaled from their reference size, no need to snap to pixels
+        float s = glyph_scale;
+        quad.rect[0] = x + ch->BearingX * s;
+        quad.rect[1] = baseline - (ch->Height - ch->BearingY) * s;
+        quad.rect[2] = ch->Width * s;
+        quad.rect[3] = ch->Height * s;
+        quad.kind = QUAD_SDF;
+    }
+    set_color(&quad, color);
+    batch_push(batch, quad);
+}
 
-    glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+static const Character* glyph_for(uint32_t rune, bool nerd_font_enabled) {
+    if (rune < 128) return &Characters[rune];
+    // Drawn glyphs need nothing from the font
+    return nerd_font_enabled || box_glyph_supported(rune) ? getGlyph(rune) : NULL;
+}
+
+// Queue UTF-8 text one cell per code point, returns the x after the last cell
+static float push_utf8(const char* text, float x, float baseline, int cell_advance, bool nerd_font_enabled, color3 color) {
+    uint32_t state = UTF8_ACCEPT, codepoint = 0;
+    for (const char* p = text; *p; p++) {
+        uint32_t result = utf8_decode_step(&state, &codepoint, (uint8_t)*p);
+        if (result == UTF8_REJECT) {
+            state = UTF8_ACCEPT;
+            codepoint = UTF8_REPLACEMENT;
+        } else if (result != UTF8_ACCEPT) {
+            continue;
+        }
+        push_glyph(glyph_for(codepoint, nerd_font_enabled), x, baseline, color);
+        x += cell_advance;
+    }
+    return x;
+}
+
+void renderer_init(void) {
+    grid_program = createShaderProgram(gridVertexShaderSrc, gridFragmentShaderSrc);
+    glUseProgram(grid_program);
+    glUniform1i(glGetUniformLocation(grid_program, "atlas"), 0);
+    grid_screen_location = glGetUniformLocation(grid_program, "screen");
+
+    // Unit quad as a triangle strip, scaled to each instance's rectangle by the vertex shader
+    static const float corners[8] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+    glGenVertexArrays(1, &grid_vao);
+    glBindVertexArray(grid_vao);
+    glGenBuffers(1, &grid_corner_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, grid_corner_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
+
+    glGenBuffers(1, &grid_instance_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, grid_instance_vbo);
+    for (GLuint attrib = 1; attrib <= 4; attrib++) {
+        glEnableVertexAttribArray(attrib);
+        glVertexAttribDivisor(attrib, 1);
+    }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindVertexArray(0);
+}
+
+void renderer_shutdown(void) {
+    glDeleteProgram(grid_program);
+    glDeleteBuffers(1, &grid_instance_vbo);
+    glDeleteBuffers(1, &grid_corner_vbo);
+    glDeleteVertexArrays(1, &grid_vao);
+    free(solid_batch.quads);
+    for (size_t i = 0; i < glyph_batch_cap; i++) free(glyph_batches[i].quads);
+    free(glyph_batches);
+    free(upload);
+    solid_batch = (QuadBatch){0};
+    glyph_batches = NULL;
+    glyph_batch_count = glyph_batch_cap = 0;
+    upload = NULL;
+    upload_cap = 0;
+}
+
+// Point the instance attributes at the instance `first` of the bound instance buffer
+static void bind_instances_from(size_t first) {
+    size_t base = first * sizeof(QuadInstance);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (void*)(base + offsetof(QuadInstance, rect)));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (void*)(base + offsetof(QuadInstance, uv)));
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(QuadInstance), (void*)(base + offsetof(QuadInstance, color)));
+    glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(QuadInstance), (void*)(base + offsetof(QuadInstance, kind)));
+}
+
+// Upload the queued quads and draw them: solids and the first page in one call, then one per page
+static void flush_quads(void) {
+    size_t total = solid_batch.count;
+    for (size_t i = 0; i < glyph_batch_count; i++) total += glyph_batches[i].count;
+    if (total == 0) return;
+
+    if (total > upload_cap) {
+        size_t cap = upload_cap ? upload_cap : 4096;
+        while (cap < total) cap *= 2;
+        QuadInstance* data = realloc(upload, cap * sizeof(QuadInstance));
+        if (!data) {
+            fprintf(stderr, "Render instances could not be allocated");
+            abort();
+        }
+        upload = data;
+        upload_cap = cap;
+    }
+    size_t used = 0;
+    memcpy(upload, solid_batch.quads, solid_batch.count * sizeof(QuadInstance));
+    used += solid_batch.count;
+    for (size_t i = 0; i < glyph_batch_count; i++) {
+        memcpy(upload + used, glyph_batches[i].quads, glyph_batches[i].count * sizeof(QuadInstance));
+        used += glyph_batches[i].count;
+    }
+
+    glUseProgram(grid_program);
+    glUniform2f(grid_screen_location, (float)bufferScreenWidth, (float)bufferScreenHeight);
+    glActiveTexture(GL_TEXTURE0);
+    // Loading the font again (setFontSize) deletes the atlas pages, and a new page may get a
+    // deleted page's name back: start every frame without assuming a binding
+    bound_texture = 0;
+    glBindVertexArray(grid_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, grid_instance_vbo);
+
+    // Orphan the previous frame's storage so the upload never waits for the GPU to finish with it
+    if (total > grid_instance_capacity) grid_instance_capacity = upload_cap;
+    glBufferData(GL_ARRAY_BUFFER, grid_instance_capacity * sizeof(QuadInstance), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, total * sizeof(QuadInstance), upload);
+
+    size_t first = 0;
+    size_t count = solid_batch.count + (glyph_batch_count > 0 ? glyph_batches[0].count : 0);
+    bind_instances_from(0);
+    if (glyph_batch_count > 0) bind_glyph_texture(glyph_batches[0].texture);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)count);
+    first += count;
+    for (size_t i = 1; i < glyph_batch_count; i++) {
+        bind_instances_from(first);
+        bind_glyph_texture(glyph_batches[i].texture);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)glyph_batches[i].count);
+        first += glyph_batches[i].count;
+    }
 
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void renderGrid(GLuint shader, TerminalGrid* grid, bool nerd_font_enabled, bool cursor_visible) {
-    extern short fontSize;
-    float line_spacing = (fontSize + 3) * yScale;
+// Query bar over the bottom row: mode, query, and which match is selected
+static void push_search_bar(const TerminalGrid* grid, const SearchState* search, float line_spacing, int cell_advance,
+                            int descent, bool nerd_font_enabled, bool cursor_visible) {
+    float baseline = floorf(bufferScreenHeight - grid->height * line_spacing);
+    push_solid(0, baseline - descent, (float)(grid->width * cell_advance), line_spacing, SEARCH_BAR_COLOR);
+
+    float x = push_utf8(search_is_regex(search) ? "Regex: " : "Find: ", 0, baseline, cell_advance, nerd_font_enabled, COLOR_WHITE);
+    x = push_utf8(search_query(search), x, baseline, cell_advance, nerd_font_enabled, COLOR_WHITE);
+    if (cursor_visible) push_solid(x, baseline - descent, (float)cell_advance, line_spacing, COLOR_WHITE);
+
+    char status[64];
+    size_t count = search_match_count(search);
+    if (search_has_error(search)) snprintf(status, sizeof(status), "  [invalid]");
+    else if (search_query(search)[0] == '\0') status[0] = '\0';
+    else if (count == 0) snprintf(status, sizeof(status), "  [no matches]");
+    else snprintf(status, sizeof(status), "  [%zu/%zu]", search_current_index(search) + 1, count);
+    push_utf8(status, x + cell_advance, baseline, cell_advance, nerd_font_enabled, COLOR_WHITE);
+}
+
+static color3 scale_color(color3 c, float k) {
+    color3 out = {c.r * k, c.g * k, c.b * k};
+    return out;
+}
+
+void renderGrid(TerminalGrid* grid, const SearchState* search, bool nerd_font_enabled, bool cursor_visible) {
+    float line_spacing = getLineSpacing();
     int cell_advance = getCellAdvance();
+    int descent = getCellDescent();
+    bool searching = search && search_is_active(search);
+
+    solid_batch.count = 0;
+    glyph_batch_count = 0;
+    glyph_scale = getGlyphScale();
+
+    // The typed (not yet sent) input is drawn after the cursor cell's text, and the cursor after it
+    const char* inbuf = input_get_buffer();
+    size_t inlen = input_get_length();
+    int cursor_row = grid->cursor.row + grid->view_offset;
+    int cursor_col = grid->cursor.col + (int)inlen;
+    bool draw_cursor = cursor_visible && !searching;
 
-    for (int row = 0; row < grid->height; row++) {
-        float y = bufferScreenHeight - (row + 1) * line_spacing;
-        float x = 0;
+    // Decorations sit just below the baseline (underline) and through the middle of x-height (strike)
+    float underline_y = descent > 1 ? -2.0f : -1.0f;
+    float strike_y = floorf(line_spacing * 0.3f);
+    float thickness = yScale > 1.5f ? 2.0f : 1.0f;
 
-        for (int col = 0; col < grid->width; col++) {
-            int idx = row * grid->width + col;
-            Cell* cell = &grid->grid[idx];
+    // Neighbouring cells mostly share a style, so only resolve colours when the style ID changes
+    StyleId last_style = STYLE_DEFAULT;
+    const Style* style = style_get(grid->styles, STYLE_DEFAULT);
+    color3 fg = COLOR_WHITE, bg = COLOR_BLACK;
+    bool has_bg = false;
 
-            // cursor drawn after full pass
+    // With the query bar open the bottom row belongs to the bar
+    int rows = searching ? grid->height - 1 : grid->height;
+    for (int row = 0; row < rows; row++) {
+        float baseline = floorf(bufferScreenHeight - (row + 1) * line_spacing);
+        float cell_bottom = baseline - descent;
+        Cell* line = grid_view_row(grid, row);
+        if (!line) continue;
 
-            if (cell->rune == 0) {
-                x += cell_advance;
-                continue;
-            }
+        const SearchMatch* hits = NULL;
+        int current_hit = -1;
+        size_t hit_count = 0;
+        if (searching) {
+            hit_count = search_line_matches(search, grid_line_id(grid, row - grid->view_offset), &hits, &current_hit);
+        }
+        size_t hit = 0;
+
+        // Runs of cells with the same background become one quad
+        int run_start = -1;
+        color3 run_color = COLOR_BLACK;
 
-            if (cell->rune < 128) {
-                char char_str[2] = {(char)cell->rune, '\0'};
-                renderText(shader, char_str, x, y, 1.0f, cell->fg);
-            } else if (nerd_font_enabled) {
-                const Character* g = getGlyph(cell->rune);
-                if (g) {
-                    renderGlyph(shader, g, x, y, 1.0f, cell->fg);
+        for (int col = 0; col <= grid->width; col++) {
+            bool cell_has_bg = false;
+            color3 cell_bg = COLOR_BLACK;
+            color3 cell_fg = COLOR_WHITE;
+            Cell* cell = col < grid->width ? &line[col] : NULL;
+
+            if (cell) {
+                if (cell->style != last_style) {
+                    last_style = cell->style;
+                    style = style_get(grid->styles, last_style);
+                    color3 style_fg = resolve_cell_color(style->fg, COLOR_WHITE);
+                    has_bg = style->bg != CELL_COLOR_DEFAULT;
+                    bg = resolve_cell_color(style->bg, COLOR_BLACK);
+                    fg = style_fg;
+                    if (style->attrs & STYLE_INVERSE) {
+                        fg = bg;
+                        bg = style_fg;
+                        has_bg = true;
+                    }
+                    if (style->attrs & STYLE_DIM) fg = scale_color(fg, 0.6f);
+                }
+                cell_fg = fg;
+                cell_bg = bg;
+                cell_has_bg = has_bg;
+
+                // Search hits and the cursor override the cell colours
+                while (hit < hit_count && hits[hit].col + hits[hit].len <= col) hit++;
+                if (hit < hit_count && hits[hit].col <= col) {
+                    cell_bg = (int)hit == current_hit ? SEARCH_CURRENT_COLOR : SEARCH_MATCH_COLOR;
+                    cell_fg = COLOR_BLACK;
+                    cell_has_bg = true;
+                }
+                if (draw_cursor && row == cursor_row && col == cursor_col) {
+                    cell_bg = COLOR_WHITE;
+                    cell_fg = COLOR_BLACK;
+                    cell_has_bg = true;
                 }
             }
 
-            x += cell_advance;
+            bool same_run = run_start >= 0 && cell_has_bg && cell_bg.r == run_color.r &&
+                            cell_bg.g == run_color.g && cell_bg.b == run_color.b;
+            if (run_start >= 0 && !same_run) {
+                push_solid((float)(run_start * cell_advance), cell_bottom, (float)((col - run_start) * cell_advance), line_spacing, run_color);
+                run_start = -1;
+            }
+            if (!cell) break;
+            if (cell_has_bg && run_start < 0) {
+                run_start = col;
+                run_color = cell_bg;
+            }
+
+            float x = (float)(col * cell_advance);
+            if (style->attrs & STYLE_UNDERLINE) {
+                color3 color = resolve_cell_color(style->underline_color, cell_fg);
+                push_solid(x, baseline + underline_y, (float)cell_advance, thickness, color);
+            }
+            if (style->attrs & STYLE_STRIKE) push_solid(x, baseline + strike_y, (float)cell_advance, thickness, cell_fg);
+
+            if (cell->rune != 0 && !(style->attrs & STYLE_HIDDEN)) {
+                push_glyph(glyph_for(cell->rune, nerd_font_enabled), x, baseline, cell_fg);
+            }
         }
     }
 
-    // Overlay user input buffer next to the last prompt
-    const char* inbuf = input_get_buffer();
-    size_t inlen = input_get_length();
-    if (inbuf && inlen > 0) {
-        int row = grid->cursor.row;
+    if (searching) {
+        push_search_bar(grid, search, line_spacing, cell_advance, descent, nerd_font_enabled, cursor_visible);
+    } else if (inbuf && inlen > 0) {
+        // Overlay user input buffer next to the last prompt
+        int row = grid->cursor.row + grid->view_offset;
         int col = grid->cursor.col;
-        if (row < 0) row = 0; if (row >= grid->height) row = grid->height - 1;
-        if (col < 0) col = 0; if (col > grid->width) col = grid->width;
-        float y = bufferScreenHeight - (row + 1) * line_spacing;
+        if (row < 0) row = 0;
+        if (row >= grid->height) row = grid->height - 1;
+        if (col < 0) col = 0;
+        if (col > grid->width) col = grid->width;
+        float baseline = floorf(bufferScreenHeight - (row + 1) * line_spacing);
         float x = (float)(col * cell_advance);
 
         for (size_t i = 0; i < inlen; i++) {
-            unsigned char ch = (unsigned char)inbuf[i];
-            if (ch < 128) {
-                char s[2] = {(char)ch, '\0'};
-                renderText(shader, s, x, y, 1.0f, COLOR_WHITE);
-            } else if (nerd_font_enabled) {
-                const Character* g = getGlyph((uint32_t)ch);
-                if (g) renderGlyph(shader, g, x, y, 1.0f, COLOR_WHITE);
-            }
+            push_glyph(glyph_for((unsigned char)inbuf[i], nerd_font_enabled), x, baseline, COLOR_WHITE);
             x += cell_advance;
         }
     }
 
-    // Draw blinking cursor at insertion position
-    if (cursor_visible) {
-        int row = grid->cursor.row;
-        int col = grid->cursor.col + (int)inlen; // insertion point after typed text
-        
-        if (row >= 0 && row < grid->height && col >= 0 && col < grid->width) {
-            float y = bufferScreenHeight - (row + 1) * line_spacing;
-            float x = (float)(col * cell_advance);
-            
-            // Draw a solid block cursor using the full block character
-            const Character* block = getGlyph(0x2588); // U+2588 FULL BLOCK
-            if (block) {
-                renderGlyph(shader, block, x, y, 1.0f, COLOR_WHITE);
-            }
-        }
-    }
+    flush_quads();
 }
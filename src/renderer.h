@@ -3,31 +3,12 @@
 
 #include <glad/glad.h>
 #include "types.h"
+#include "search.h"
 #include <stdbool.h>
 
 /**
  * Text rendering module
- * Handles rendering of text strings using pre-loaded font glyphs and OpenGL
- */
-
-/** Vertex Array Object - stores vertex buffer configuration for text quads */
-extern GLuint VAO;
-/** Vertex Buffer Object - stores quad vertex data for rendering characters */
-extern GLuint VBO;
-
-/**
- * Renders a text string to the screen at the specified position and color
- * Iterates through each character in the string, calculates quad positions based on glyph
- * metrics, uploads vertex data to GPU, and draws textured quads
- * @param shader - Compiled shader program to use for rendering
- * @param text - Null-terminated string to render
- * @param x - X position in screen coordinates
- * @param y - Y position in screen coordinates
- * @param scale - Scale factor for rendering (1.0 = normal size)
- * @param r - Red color component (0.0 to 1.0)
- * @param g - Green color component (0.0 to 1.0)
- * @param b - Blue color component (0.0 to 1.0)
- * @param a - Alphas Channel (0.0 to 1.0)
+ * Draws the terminal grid with pre-loaded font glyphs and OpenGL
  */
 
 // Breaks down the color values for passing into gl functions
@@ -43,12 +24,18 @@ static color3 COLOR_BLACK = {0.0f, 0.0f, 0.0f};
 
 static const color4 COLOR4_BLACK = {0.0f, 0.0f, 0.0f, 1.0f};
 
-void renderText(GLuint shader, const char* text, float x, float y, float scale, color3 color);
+/** Creates the grid shader program and instance buffers (needs a current GL context) */
+void renderer_init(void);
 
-// Render a single glyph provided as Character metrics/texture
-void renderGlyph(GLuint shader, const Character* ch, float x, float y, float scale, color3 color);
+/** Releases everything renderer_init created */
+void renderer_shutdown(void);
 
-// Render the entire terminal grid with fixed cell spacing
-void renderGrid(GLuint shader, TerminalGrid* grid, bool nerd_font_enabled, bool cursor_visible);
+/**
+ * Render the entire terminal grid with fixed cell spacing, plus search highlights and the
+ * query bar while search is active (search may be NULL)
+ * Backgrounds, decorations and glyphs are batched into quad instances and drawn with one
+ * instanced draw call per glyph atlas page in use.
+ */
+void renderGrid(TerminalGrid* grid, const SearchState* search, bool nerd_font_enabled, bool cursor_visible);
 
 #endif // RENDERER_H
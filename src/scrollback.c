@@ -0,0 +1,901 @@
+#include "scrollback.h"
+#include "spill.h"
+#include "style.h"
+#include "utf8.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SB_DECODE_CACHE 8
+// Full blocks allowed to wait for the packing thread; past that the pushing thread packs the
+// oldest one itself, so a flood is slowed down to packing speed instead of outrunning it
+#define SB_RAW_BLOCKS_MAX 16
+
+typedef enum {
+    BLOCK_OPEN = 0,   // still receiving lines (main thread only)
+    BLOCK_QUEUED,     // full, waiting for the packing thread
+    BLOCK_PACKING,    // being compressed
+    BLOCK_PACKED,     // compressed; raw lines are freed once the main thread reaps it
+} BlockState;
+
+// Uncompressed lines of a block, dropped once the packed form is ready. The lines are copied
+// back to back into one arena, which only grows while the block is open.
+typedef struct {
+    Cell* arena;
+    size_t arena_used;        // cells
+    size_t arena_cap;
+    size_t offsets[SCROLLBACK_BLOCK_LINES];
+    int widths[SCROLLBACK_BLOCK_LINES];
+    uint8_t flags[SCROLLBACK_BLOCK_LINES];
+} RawLines;
+
+static const Cell* raw_line(const RawLines* raw, int l) {
+    return raw->arena + raw->offsets[l];
+}
+
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+} ByteBuf;
+
+// Scratch space for pack_block, kept by each thread that packs so every block reuses it
+typedef struct {
+    ByteBuf raw;
+    ByteBuf text;
+    ByteBuf packed;
+} PackBuffers;
+
+typedef struct ScrollbackBlock {
+    int line_count;
+    int max_width;
+    RawLines* raw;            // main thread; the packer only reads it
+    size_t charged;           // bytes counted against the budget (main thread)
+
+    uint8_t* packed;          // written by the packer, read after reaping
+    size_t packed_size;
+
+    BlockState state;         // guarded by lock
+    int evicted;              // guarded by lock: whoever holds the block last frees it
+    int in_done;              // guarded by lock: waiting in the done list to be reaped
+    struct ScrollbackBlock* next;
+} ScrollbackBlock;
+
+typedef struct {
+    const void* key;          // the in-memory block, or its bytes in the spill mapping
+    Cell* cells;
+    int stride;
+    uint8_t flags[SCROLLBACK_BLOCK_LINES];
+    unsigned last_use;
+} DecodedBlock;
+
+struct ScrollbackStore {
+    // Blocks oldest first, as a growable ring (main thread)
+    ScrollbackBlock** blocks;
+    size_t first;
+    size_t count;
+    size_t cap;
+    ScrollbackBlock* open;
+
+    SpillFile* spill;         // evicted blocks go here instead of being dropped, may be NULL
+    size_t spilled_lines;
+
+    size_t lines;             // lines held in memory
+    size_t bytes;
+    size_t raw_bytes;         // part of bytes charged for blocks not packed yet, never evicted
+    int raw_blocks;           // full blocks not packed yet (queued, packing or not reaped)
+    size_t budget;
+
+    DecodedBlock cache[SB_DECODE_CACHE];
+    unsigned clock;
+    Cell* scratch;
+    int scratch_width;
+    PackBuffers pack_buffers; // for blocks packed on the main thread
+
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t packed;
+    ScrollbackBlock* queue_head;
+    ScrollbackBlock* queue_tail;
+    ScrollbackBlock* done;
+    int stop;
+};
+
+static const Cell SB_BLANK = {.rune = 0, .flags = 0, .style = 0};
+
+/*
+ * Byte buffers and varints
+ */
+
+static void buf_reserve(ByteBuf* b, size_t extra) {
+    if (b->len + extra <= b->cap) return;
+    size_t cap = b->cap ? b->cap * 2 : 4096;
+    while (cap < b->len + extra) cap *= 2;
+    uint8_t* data = realloc(b->data, cap);
+    if (!data) {
+        fprintf(stderr, "Scrollback buffer could not be allocated");
+        abort();
+    }
+    b->data = data;
+    b->cap = cap;
+}
+
+// Writes v at p, which must have room for 5 bytes, and returns the end
+static uint8_t* put_varint(uint8_t* p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static uint32_t read_varint(const uint8_t** p, const uint8_t* end) {
+    uint32_t v = 0;
+    int shift = 0;
+    while (*p < end && shift < 32) {
+        uint8_t byte = *(*p)++;
+        v |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+        shift += 7;
+    }
+    return v;
+}
+
+/*
+ * LZ77 in the spirit of LZ4: [varint literal count][literals][varint match length][u16 offset]
+ * A match length of zero ends the stream. Fast enough to keep up with output, and the
+ * attribute/text streams are repetitive enough that it usually wins 5-10x.
+ */
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+// After 1 << LZ_SKIP_TRIGGER positions without a match the search steps two bytes, then three...
+#define LZ_SKIP_TRIGGER 6
+
+static uint32_t lz_read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Length of the common prefix of a and b, at most limit bytes
+static size_t lz_match_length(const uint8_t* a, const uint8_t* b, size_t limit) {
+    size_t len = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; len + 8 <= limit; len += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + len, sizeof(x));
+        memcpy(&y, b + len, sizeof(y));
+        if (x != y) return len + (size_t)(__builtin_ctzll(x ^ y) >> 3);
+    }
+#endif
+    while (len < limit && a[len] == b[len]) len++;
+    return len;
+}
+
+// Appends a literal run and, unless len is 0, the match that follows it
+static uint8_t* lz_put_sequence(ByteBuf* out, uint8_t* o, const uint8_t* lit, size_t lit_len,
+                                size_t len, size_t offset) {
+    out->len = (size_t)(o - out->data);
+    buf_reserve(out, lit_len + 12);
+    o = out->data + out->len;
+    o = put_varint(o, (uint32_t)lit_len);
+    memcpy(o, lit, lit_len);
+    o = put_varint(o + lit_len, (uint32_t)len);
+    if (len > 0) {
+        uint16_t offset16 = (uint16_t)offset;
+        memcpy(o, &offset16, sizeof(offset16));
+        o += sizeof(offset16);
+    }
+    return o;
+}
+
+static void lz_compress(const uint8_t* src, size_t n, ByteBuf* out) {
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+
+    buf_reserve(out, n + 16);
+    uint8_t* o = out->data + out->len;
+    size_t anchor = 0;
+    size_t i = 0;
+    size_t misses = 0;
+    while (i + LZ_MIN_MATCH <= n) {
+        uint32_t seq = lz_read32(src + i);
+        uint32_t h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        uint32_t ref = table[h];
+        table[h] = (uint32_t)i;
+
+        if (ref != 0xFFFFFFFFu && i - ref <= 0xFFFF && lz_read32(src + ref) == seq) {
+            size_t len = LZ_MIN_MATCH + lz_match_length(src + ref + LZ_MIN_MATCH, src + i + LZ_MIN_MATCH,
+                                                        n - i - LZ_MIN_MATCH);
+            o = lz_put_sequence(out, o, src + anchor, i - anchor, len, i - ref);
+            i += len;
+            anchor = i;
+            misses = 0;
+        } else {
+            // Output that does not compress, such as random text, is skipped over quickly
+            i += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+        }
+    }
+
+    o = lz_put_sequence(out, o, src + anchor, n - anchor, 0, 0);
+    out->len = (size_t)(o - out->data);
+}
+
+// Returns the number of bytes written to dst, which must hold dst_cap bytes
+static size_t lz_decompress(const uint8_t* src, size_t n, uint8_t* dst, size_t dst_cap) {
+    const uint8_t* p = src;
+    const uint8_t* end = src + n;
+    size_t o = 0;
+
+    while (p < end) {
+        size_t lit = read_varint(&p, end);
+        if (lit > (size_t)(end - p) || lit > dst_cap - o) break;
+        memcpy(dst + o, p, lit);
+        p += lit;
+        o += lit;
+
+        size_t len = read_varint(&p, end);
+        if (len == 0 || end - p < 2) break;
+        uint16_t offset;
+        memcpy(&offset, p, sizeof(offset));
+        p += 2;
+        if (offset == 0 || offset > o || len > dst_cap - o) break;
+        // Byte copy on purpose: matches may overlap their own output
+        for (size_t k = 0; k < len; k++, o++) dst[o] = dst[o - offset];
+    }
+    return o;
+}
+
+/*
+ * Block packing
+ *
+ * Unpacked layout: varint line_count, varint attr_size, attribute section, text section.
+ * Attribute section: per line width, flags and runs of cells sharing a style ID and cell flags.
+ * Text section: per line the UTF-8 runes up to the last non-empty cell, then '\n'.
+ */
+
+static int cell_same_attrs(const Cell* a, const Cell* b) {
+    return a->style == b->style && a->flags == b->flags;
+}
+
+static uint8_t* put_attrs(uint8_t* p, const Cell* c) {
+    p[0] = (uint8_t)(c->style & 0xFF);
+    p[1] = (uint8_t)(c->style >> 8);
+    p[2] = (uint8_t)(c->flags & 0xFF);
+    p[3] = (uint8_t)(c->flags >> 8);
+    return p + 4;
+}
+
+static const uint8_t* get_attrs(const uint8_t* p, const uint8_t* end, Cell* c) {
+    if (end - p < 4) return end;
+    c->style = (uint16_t)(p[0] | (p[1] << 8));
+    c->flags = (uint32_t)p[2] | ((uint32_t)p[3] << 8);
+    p += 4;
+    return p;
+}
+
+// The two header varints are written just before the attribute section once its size is known
+#define PACK_HEADER_MAX 10
+
+static void pack_block(ScrollbackBlock* block, PackBuffers* buffers) {
+    ByteBuf* raw = &buffers->raw;
+    ByteBuf* text = &buffers->text;
+    ByteBuf* packed = &buffers->packed;
+    raw->len = text->len = packed->len = 0;
+    const RawLines* lines = block->raw;
+
+    // Sized for the worst case up front: a run per cell and four UTF-8 bytes per rune
+    size_t cell_count = lines->arena_used;
+    size_t text_max = cell_count * 4 + (size_t)block->line_count;
+    buf_reserve(raw, PACK_HEADER_MAX + (size_t)block->line_count * 11 + cell_count * 9 + text_max);
+    buf_reserve(text, text_max);
+    uint8_t* p = raw->data + PACK_HEADER_MAX;
+    uint8_t* t = text->data;
+
+    for (int l = 0; l < block->line_count; l++) {
+        const Cell* cells = raw_line(lines, l);
+        int width = lines->widths[l];
+
+        p = put_varint(p, (uint32_t)width);
+        *p++ = lines->flags[l];
+
+        // One byte is kept for the run count; the runs move up in the rare case it needs more
+        uint8_t* count_at = p++;
+        uint32_t runs = 0;
+        for (int i = 0; i < width; ) {
+            int j = i + 1;
+            while (j < width && cell_same_attrs(&cells[i], &cells[j])) j++;
+            p = put_varint(p, (uint32_t)(j - i));
+            p = put_attrs(p, &cells[i]);
+            runs++;
+            i = j;
+        }
+        if (runs < 0x80) {
+            *count_at = (uint8_t)runs;
+        } else {
+            uint8_t count[5];
+            size_t count_len = (size_t)(put_varint(count, runs) - count);
+            memmove(count_at + count_len, count_at + 1, (size_t)(p - count_at - 1));
+            memcpy(count_at, count, count_len);
+            p += count_len - 1;
+        }
+
+        int last = width;
+        while (last > 0 && cells[last - 1].rune == 0) last--;
+        for (int i = 0; i < last; i++) {
+            uint32_t rune = cells[i].rune;
+            if (rune < 0x80) *t++ = (uint8_t)rune;
+            else t += utf8_encode(rune, (char*)t);
+        }
+        *t++ = '\n';
+    }
+
+    uint8_t header[PACK_HEADER_MAX];
+    size_t attr_len = (size_t)(p - raw->data) - PACK_HEADER_MAX;
+    uint8_t* header_end = put_varint(header, (uint32_t)block->line_count);
+    header_end = put_varint(header_end, (uint32_t)attr_len);
+    size_t header_len = (size_t)(header_end - header);
+    size_t start = PACK_HEADER_MAX - header_len;
+    memcpy(raw->data + start, header, header_len);
+    memcpy(p, text->data, (size_t)(t - text->data));
+    raw->len = (size_t)(p - raw->data) + (size_t)(t - text->data);
+
+    buf_reserve(packed, 5);
+    packed->len = (size_t)(put_varint(packed->data, (uint32_t)(raw->len - start)) - packed->data);
+    lz_compress(raw->data + start, raw->len - start, packed);
+
+    block->packed = malloc(packed->len);
+    if (!block->packed) {
+        fprintf(stderr, "Scrollback block could not be allocated");
+        abort();
+    }
+    memcpy(block->packed, packed->data, packed->len);
+    block->packed_size = packed->len;
+}
+
+static void free_pack_buffers(PackBuffers* buffers) {
+    free(buffers->raw.data);
+    free(buffers->text.data);
+    free(buffers->packed.data);
+}
+
+// Decodes a packed block into line_count rows of `stride` cells plus their row flags
+static int unpack_block(const uint8_t* packed, size_t packed_size, int line_count_max,
+                        Cell* out, int stride, uint8_t* flags) {
+    const uint8_t* p = packed;
+    const uint8_t* end = p + packed_size;
+    size_t raw_len = read_varint(&p, end);
+
+    uint8_t* raw = malloc(raw_len ? raw_len : 1);
+    if (!raw) return 0;
+    if (lz_decompress(p, (size_t)(end - p), raw, raw_len) != raw_len) {
+        free(raw);
+        return 0;
+    }
+
+    const uint8_t* a = raw;
+    const uint8_t* raw_end = raw + raw_len;
+    int line_count = (int)read_varint(&a, raw_end);
+    size_t attr_len = read_varint(&a, raw_end);
+    const uint8_t* attr_end = a + attr_len <= raw_end ? a + attr_len : raw_end;
+    const uint8_t* t = attr_end;
+
+    for (int l = 0; l < line_count && l < line_count_max; l++) {
+        Cell* row = out + (size_t)l * (size_t)stride;
+        for (int i = 0; i < stride; i++) row[i] = SB_BLANK;
+
+        int width = (int)read_varint(&a, attr_end);
+        flags[l] = a < attr_end ? *a++ : 0;
+        int runs = (int)read_varint(&a, attr_end);
+        int col = 0;
+        for (int r = 0; r < runs; r++) {
+            int len = (int)read_varint(&a, attr_end);
+            Cell attrs = SB_BLANK;
+            a = get_attrs(a, attr_end, &attrs);
+            for (int k = 0; k < len && col < width; k++, col++) {
+                if (col < stride) row[col] = attrs;
+            }
+        }
+
+        uint32_t state = UTF8_ACCEPT, cp = 0;
+        col = 0;
+        while (t < raw_end && *t != '\n') {
+            if (utf8_decode_step(&state, &cp, *t++) == UTF8_ACCEPT) {
+                if (col < stride) row[col].rune = cp;
+                col++;
+            }
+        }
+        if (t < raw_end) t++;
+    }
+
+    free(raw);
+    return 1;
+}
+
+// Marks the style ID of every attribute run, without decoding the text section
+static void mark_packed_styles(const uint8_t* packed, size_t packed_size, struct StyleTable* table) {
+    const uint8_t* p = packed;
+    const uint8_t* end = p + packed_size;
+    size_t raw_len = read_varint(&p, end);
+
+    uint8_t* raw = malloc(raw_len ? raw_len : 1);
+    if (!raw) return;
+    if (lz_decompress(p, (size_t)(end - p), raw, raw_len) != raw_len) {
+        free(raw);
+        return;
+    }
+
+    const uint8_t* a = raw;
+    const uint8_t* raw_end = raw + raw_len;
+    int line_count = (int)read_varint(&a, raw_end);
+    size_t attr_len = read_varint(&a, raw_end);
+    const uint8_t* attr_end = a + attr_len <= raw_end ? a + attr_len : raw_end;
+
+    for (int l = 0; l < line_count && a < attr_end; l++) {
+        read_varint(&a, attr_end);
+        if (a < attr_end) a++;
+        int runs = (int)read_varint(&a, attr_end);
+        for (int r = 0; r < runs; r++) {
+            read_varint(&a, attr_end);
+            Cell attrs = SB_BLANK;
+            a = get_attrs(a, attr_end, &attrs);
+            style_gc_mark(table, attrs.style);
+        }
+    }
+
+    free(raw);
+}
+
+/*
+ * Packing thread
+ */
+
+static void free_block(ScrollbackBlock* block) {
+    if (block->raw) {
+        free(block->raw->arena);
+        free(block->raw);
+    }
+    free(block->packed);
+    free(block);
+}
+
+static void* pack_worker(void* arg) {
+    ScrollbackStore* sb = arg;
+    PackBuffers buffers = {0};
+
+    pthread_mutex_lock(&sb->lock);
+    for (;;) {
+        while (!sb->stop && !sb->queue_head) pthread_cond_wait(&sb->wake, &sb->lock);
+        if (sb->stop) break;
+
+        ScrollbackBlock* block = sb->queue_head;
+        sb->queue_head = block->next;
+        if (!sb->queue_head) sb->queue_tail = NULL;
+        block->next = NULL;
+
+        if (block->evicted) {
+            pthread_mutex_unlock(&sb->lock);
+            free_block(block);
+            pthread_mutex_lock(&sb->lock);
+            continue;
+        }
+
+        block->state = BLOCK_PACKING;
+        pthread_mutex_unlock(&sb->lock);
+        pack_block(block, &buffers);
+        pthread_mutex_lock(&sb->lock);
+
+        block->state = BLOCK_PACKED;
+        pthread_cond_broadcast(&sb->packed);
+        if (block->evicted) {
+            pthread_mutex_unlock(&sb->lock);
+            free_block(block);
+            pthread_mutex_lock(&sb->lock);
+            continue;
+        }
+        block->in_done = 1;
+        block->next = sb->done;
+        sb->done = block;
+    }
+    pthread_mutex_unlock(&sb->lock);
+    free_pack_buffers(&buffers);
+    return NULL;
+}
+
+static void queue_block(ScrollbackStore* sb, ScrollbackBlock* block) {
+    pthread_mutex_lock(&sb->lock);
+    block->state = BLOCK_QUEUED;
+    block->next = NULL;
+    if (sb->queue_tail) sb->queue_tail->next = block;
+    else sb->queue_head = block;
+    sb->queue_tail = block;
+    pthread_cond_signal(&sb->wake);
+    pthread_mutex_unlock(&sb->lock);
+}
+
+static void invalidate_cache(ScrollbackStore* sb, const void* key) {
+    for (int i = 0; i < SB_DECODE_CACHE; i++) {
+        if (sb->cache[i].key == key) {
+            free(sb->cache[i].cells);
+            sb->cache[i] = (DecodedBlock){0};
+        }
+    }
+}
+
+// Swap the raw lines of a packed block for its packed form
+static void settle_block(ScrollbackStore* sb, ScrollbackBlock* block) {
+    free(block->raw->arena);
+    free(block->raw);
+    block->raw = NULL;
+
+    sb->bytes -= block->charged;
+    sb->raw_bytes -= block->charged;
+    sb->raw_blocks--;
+    block->charged = sizeof(*block) + block->packed_size;
+    sb->bytes += block->charged;
+}
+
+// Swap raw lines for the packed form of every block the packer finished
+static void reap_packed(ScrollbackStore* sb) {
+    pthread_mutex_lock(&sb->lock);
+    ScrollbackBlock* list = sb->done;
+    sb->done = NULL;
+    for (ScrollbackBlock* b = list; b; b = b->next) b->in_done = 0;
+    pthread_mutex_unlock(&sb->lock);
+
+    while (list) {
+        ScrollbackBlock* block = list;
+        list = block->next;
+        block->next = NULL;
+
+        if (block->evicted) {
+            free_block(block);
+            continue;
+        }
+        settle_block(sb, block);
+    }
+}
+
+// Makes sure block->packed is valid, packing on this thread if the worker has not started
+// on it yet. Only called on full blocks.
+static void ensure_packed(ScrollbackStore* sb, ScrollbackBlock* block) {
+    pthread_mutex_lock(&sb->lock);
+    if (block->state == BLOCK_QUEUED) {
+        ScrollbackBlock** link = &sb->queue_head;
+        ScrollbackBlock* prev = NULL;
+        while (*link && *link != block) {
+            prev = *link;
+            link = &(*link)->next;
+        }
+        if (*link) {
+            *link = block->next;
+            if (sb->queue_tail == block) sb->queue_tail = prev;
+        }
+        block->next = NULL;
+        block->state = BLOCK_PACKING;
+        pthread_mutex_unlock(&sb->lock);
+        pack_block(block, &sb->pack_buffers);
+        pthread_mutex_lock(&sb->lock);
+        block->state = BLOCK_PACKED;
+    }
+    while (block->state == BLOCK_PACKING) pthread_cond_wait(&sb->packed, &sb->lock);
+    pthread_mutex_unlock(&sb->lock);
+}
+
+static void evict_oldest(ScrollbackStore* sb) {
+    ScrollbackBlock* block = sb->blocks[sb->first];
+    sb->first = (sb->first + 1) % sb->cap;
+    sb->count--;
+    sb->lines -= (size_t)block->line_count;
+    sb->bytes -= block->charged;
+    if (block->raw) {
+        sb->raw_bytes -= block->charged;
+        if (block != sb->open) sb->raw_blocks--;
+    }
+    invalidate_cache(sb, block);
+
+    if (sb->spill && block->line_count == SCROLLBACK_BLOCK_LINES && block != sb->open) {
+        ensure_packed(sb, block);
+        if (spill_append(sb->spill, block->packed, block->packed_size, block->line_count)) {
+            sb->spilled_lines += (size_t)block->line_count;
+        }
+    }
+
+    pthread_mutex_lock(&sb->lock);
+    int owned_elsewhere = block->state == BLOCK_QUEUED || block->state == BLOCK_PACKING || block->in_done;
+    block->evicted = 1;
+    pthread_mutex_unlock(&sb->lock);
+
+    if (!owned_elsewhere) free_block(block);
+}
+
+// Packs the oldest full block still waiting for the packer on this thread. Blocks are packed
+// in order, so the unpacked ones sit together at the newest end.
+static void pack_oldest_raw(ScrollbackStore* sb) {
+    ScrollbackBlock* oldest = NULL;
+    for (size_t i = sb->count; i-- > 0; ) {
+        ScrollbackBlock* block = sb->blocks[(sb->first + i) % sb->cap];
+        if (!block->raw) break;
+        if (block != sb->open) oldest = block;
+    }
+    if (!oldest) return;
+    ensure_packed(sb, oldest);
+    reap_packed(sb);
+    if (oldest->raw) settle_block(sb, oldest);
+}
+
+// Only packed blocks count against the budget and are evicted: a raw block costs 8 bytes a
+// cell, and charging that would drop history a flood pushes faster than it can be packed.
+// Raw blocks are bounded by SB_RAW_BLOCKS_MAX instead.
+static void enforce_budget(ScrollbackStore* sb) {
+    reap_packed(sb);
+    while (sb->raw_blocks > SB_RAW_BLOCKS_MAX) pack_oldest_raw(sb);
+
+    // The open block is always kept so pushing never fails
+    while (sb->bytes - sb->raw_bytes > sb->budget && sb->count > 1 && !sb->blocks[sb->first]->raw) {
+        evict_oldest(sb);
+    }
+}
+
+/*
+ * Public API
+ */
+
+ScrollbackStore* scrollback_create(size_t budget_bytes) {
+    ScrollbackStore* sb = calloc(1, sizeof(ScrollbackStore));
+    if (!sb) return NULL;
+
+    sb->budget = budget_bytes;
+    pthread_mutex_init(&sb->lock, NULL);
+    pthread_cond_init(&sb->wake, NULL);
+    pthread_cond_init(&sb->packed, NULL);
+    if (pthread_create(&sb->worker, NULL, pack_worker, sb) != 0) {
+        pthread_mutex_destroy(&sb->lock);
+        pthread_cond_destroy(&sb->wake);
+        pthread_cond_destroy(&sb->packed);
+        free(sb);
+        return NULL;
+    }
+    return sb;
+}
+
+static void free_list(ScrollbackBlock* list) {
+    while (list) {
+        ScrollbackBlock* next = list->next;
+        // Non-evicted blocks are still in the ring and freed from there
+        if (list->evicted) free_block(list);
+        list = next;
+    }
+}
+
+void scrollback_destroy(ScrollbackStore* sb) {
+    if (!sb) return;
+
+    pthread_mutex_lock(&sb->lock);
+    sb->stop = 1;
+    pthread_cond_signal(&sb->wake);
+    pthread_mutex_unlock(&sb->lock);
+    pthread_join(sb->worker, NULL);
+
+    free_list(sb->queue_head);
+    free_list(sb->done);
+    for (size_t i = 0; i < sb->count; i++) free_block(sb->blocks[(sb->first + i) % sb->cap]);
+    for (int i = 0; i < SB_DECODE_CACHE; i++) free(sb->cache[i].cells);
+
+    free(sb->blocks);
+    free(sb->scratch);
+    free_pack_buffers(&sb->pack_buffers);
+    spill_close(sb->spill);
+    pthread_mutex_destroy(&sb->lock);
+    pthread_cond_destroy(&sb->wake);
+    pthread_cond_destroy(&sb->packed);
+    free(sb);
+}
+
+int scrollback_enable_spill(ScrollbackStore* sb) {
+    if (!sb) return 0;
+    if (!sb->spill) sb->spill = spill_open();
+    return sb->spill != NULL;
+}
+
+static void append_block(ScrollbackStore* sb, ScrollbackBlock* block) {
+    if (sb->count == sb->cap) {
+        size_t cap = sb->cap ? sb->cap * 2 : 64;
+        ScrollbackBlock** blocks = malloc(sizeof(ScrollbackBlock*) * cap);
+        if (!blocks) {
+            fprintf(stderr, "Scrollback index could not be allocated");
+            abort();
+        }
+        for (size_t i = 0; i < sb->count; i++) blocks[i] = sb->blocks[(sb->first + i) % sb->cap];
+        free(sb->blocks);
+        sb->blocks = blocks;
+        sb->first = 0;
+        sb->cap = cap;
+    }
+    sb->blocks[(sb->first + sb->count) % sb->cap] = block;
+    sb->count++;
+}
+
+void scrollback_push(ScrollbackStore* sb, const Cell* cells, int width, uint8_t flags) {
+    reap_packed(sb);
+
+    if (!sb->open) {
+        ScrollbackBlock* block = calloc(1, sizeof(ScrollbackBlock));
+        RawLines* raw = calloc(1, sizeof(RawLines));
+        if (!block || !raw) {
+            fprintf(stderr, "Scrollback block could not be allocated");
+            abort();
+        }
+        block->raw = raw;
+        block->charged = sizeof(*block) + sizeof(*raw);
+        sb->bytes += block->charged;
+        sb->raw_bytes += block->charged;
+        append_block(sb, block);
+        sb->open = block;
+    }
+
+    ScrollbackBlock* block = sb->open;
+    RawLines* raw = block->raw;
+    if (raw->arena_used + (size_t)width > raw->arena_cap) {
+        // Sized for a full block of lines this wide, so a block usually allocates once
+        size_t cap = raw->arena_cap ? raw->arena_cap * 2 : (size_t)width * SCROLLBACK_BLOCK_LINES;
+        if (cap < raw->arena_used + (size_t)width) cap = raw->arena_used + (size_t)width;
+        Cell* arena = realloc(raw->arena, sizeof(Cell) * cap);
+        if (!arena) {
+            fprintf(stderr, "Scrollback block could not be allocated");
+            abort();
+        }
+        raw->arena = arena;
+        raw->arena_cap = cap;
+    }
+    int l = block->line_count++;
+    raw->offsets[l] = raw->arena_used;
+    memcpy(raw->arena + raw->arena_used, cells, sizeof(Cell) * (size_t)width);
+    raw->arena_used += (size_t)width;
+    raw->widths[l] = width;
+    raw->flags[l] = flags;
+    if (width > block->max_width) block->max_width = width;
+
+    size_t line_bytes = sizeof(Cell) * (size_t)width;
+    block->charged += line_bytes;
+    sb->bytes += line_bytes;
+    sb->raw_bytes += line_bytes;
+    sb->lines++;
+
+    if (block->line_count == SCROLLBACK_BLOCK_LINES) {
+        sb->open = NULL;
+        sb->raw_blocks++;
+        queue_block(sb, block);
+    }
+
+    enforce_budget(sb);
+}
+
+size_t scrollback_line_count(const ScrollbackStore* sb) {
+    return sb ? sb->spilled_lines + sb->lines : 0;
+}
+
+size_t scrollback_memory_usage(const ScrollbackStore* sb) {
+    return sb ? sb->bytes : 0;
+}
+
+static const Cell* padded_raw_line(ScrollbackStore* sb, const RawLines* raw, int l, int min_width) {
+    if (raw->widths[l] >= min_width) return raw_line(raw, l);
+
+    if (sb->scratch_width < min_width) {
+        Cell* scratch = realloc(sb->scratch, sizeof(Cell) * (size_t)min_width);
+        if (!scratch) return NULL;
+        sb->scratch = scratch;
+        sb->scratch_width = min_width;
+    }
+    memcpy(sb->scratch, raw_line(raw, l), sizeof(Cell) * (size_t)raw->widths[l]);
+    for (int i = raw->widths[l]; i < min_width; i++) sb->scratch[i] = SB_BLANK;
+    return sb->scratch;
+}
+
+// Decoded rows of a packed block, from the cache or freshly unpacked into the LRU slot
+static DecodedBlock* decode_cached(ScrollbackStore* sb, const void* key, const uint8_t* packed,
+                                   size_t packed_size, int line_count, int stride) {
+    for (int i = 0; i < SB_DECODE_CACHE; i++) {
+        if (sb->cache[i].key == key && sb->cache[i].stride >= stride) {
+            sb->cache[i].last_use = ++sb->clock;
+            return &sb->cache[i];
+        }
+    }
+
+    invalidate_cache(sb, key);
+    DecodedBlock* slot = &sb->cache[0];
+    for (int i = 1; i < SB_DECODE_CACHE; i++) {
+        if (sb->cache[i].last_use < slot->last_use) slot = &sb->cache[i];
+    }
+    free(slot->cells);
+    *slot = (DecodedBlock){0};
+
+    Cell* cells = malloc(sizeof(Cell) * (size_t)stride * SCROLLBACK_BLOCK_LINES);
+    if (!cells) return NULL;
+    if (!unpack_block(packed, packed_size, line_count, cells, stride, slot->flags)) {
+        free(cells);
+        return NULL;
+    }
+    slot->key = key;
+    slot->cells = cells;
+    slot->stride = stride;
+    slot->last_use = ++sb->clock;
+    return slot;
+}
+
+const Cell* scrollback_line(ScrollbackStore* sb, size_t index, int min_width, uint8_t* flags) {
+    if (!sb || index >= sb->spilled_lines + sb->lines) return NULL;
+    int l = (int)(index % SCROLLBACK_BLOCK_LINES);
+    DecodedBlock* slot;
+
+    if (index < sb->spilled_lines) {
+        // Spilled blocks are always full, so the index entry is a division away
+        size_t size = 0;
+        int lines = 0;
+        const uint8_t* packed = spill_block(sb->spill, index / SCROLLBACK_BLOCK_LINES, &size, &lines);
+        if (!packed) return NULL;
+        slot = decode_cached(sb, packed, packed, size, lines, min_width);
+    } else {
+        // Same for every in-memory block but the newest
+        index -= sb->spilled_lines;
+        ScrollbackBlock* block = sb->blocks[(sb->first + index / SCROLLBACK_BLOCK_LINES) % sb->cap];
+
+        if (block->raw) {
+            if (flags) *flags = block->raw->flags[l];
+            return padded_raw_line(sb, block->raw, l, min_width);
+        }
+
+        int stride = block->max_width > min_width ? block->max_width : min_width;
+        slot = decode_cached(sb, block, block->packed, block->packed_size, block->line_count, stride);
+    }
+
+    if (!slot) return NULL;
+    if (flags) *flags = slot->flags[l];
+    return slot->cells + (size_t)l * (size_t)slot->stride;
+}
+
+void scrollback_mark_styles(ScrollbackStore* sb, struct StyleTable* table) {
+    if (!sb) return;
+
+    for (size_t b = 0; b < sb->spilled_lines / SCROLLBACK_BLOCK_LINES; b++) {
+        size_t size = 0;
+        int lines = 0;
+        const uint8_t* packed = spill_block(sb->spill, b, &size, &lines);
+        if (packed) mark_packed_styles(packed, size, table);
+    }
+
+    // The packer only reads raw lines, and only this thread frees them
+    for (size_t b = 0; b < sb->count; b++) {
+        const ScrollbackBlock* block = sb->blocks[(sb->first + b) % sb->cap];
+        if (!block->raw) {
+            mark_packed_styles(block->packed, block->packed_size, table);
+            continue;
+        }
+        for (int l = 0; l < block->line_count; l++) {
+            const Cell* cells = raw_line(block->raw, l);
+            for (int i = 0; i < block->raw->widths[l]; i++) style_gc_mark(table, cells[i].style);
+        }
+    }
+}
+
+void scrollback_clear(ScrollbackStore* sb) {
+    if (!sb) return;
+    SpillFile* spill = sb->spill;
+    sb->spill = NULL; // evict without spilling
+    while (sb->count > 0) evict_oldest(sb);
+    sb->spill = spill;
+    spill_reset(sb->spill);
+
+    for (int i = 0; i < SB_DECODE_CACHE; i++) {
+        free(sb->cache[i].cells);
+        sb->cache[i] = (DecodedBlock){0};
+    }
+    sb->open = NULL;
+    sb->lines = 0;
+    sb->spilled_lines = 0;
+}
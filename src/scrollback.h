@@ -0,0 +1,70 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include "types.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Cold scrollback tier
+ * Lines that fall out of the grid's uncompressed history ring are grouped into blocks of
+ * SCROLLBACK_BLOCK_LINES. A background thread packs every full block into attribute runs
+ * plus UTF-8 text and LZ-compresses the result. Blocks are only decompressed when a line
+ * in them is read, and the oldest blocks are dropped once the memory budget is exceeded.
+ */
+
+#define SCROLLBACK_BLOCK_LINES 128
+
+typedef struct ScrollbackStore ScrollbackStore;
+
+/**
+ * Creates an empty store and starts its packing thread
+ * @param budget_bytes - Memory allowed for cold lines before the oldest blocks are evicted
+ * @return New store, or NULL if it could not be allocated
+ */
+ScrollbackStore* scrollback_create(size_t budget_bytes);
+
+/** Stops the packing thread and frees every block */
+void scrollback_destroy(ScrollbackStore* sb);
+
+/**
+ * Spills blocks evicted by the memory budget to disk instead of dropping them
+ * @return 1 if the spill file is active, 0 if it could not be created
+ */
+int scrollback_enable_spill(ScrollbackStore* sb);
+
+/**
+ * Appends a line as the newest cold line, copying its cells
+ * @param cells - Array of width cells, still owned by the caller
+ * @param width - Number of cells in the line
+ * @param flags - Row flags to keep with the line
+ */
+void scrollback_push(ScrollbackStore* sb, const Cell* cells, int width, uint8_t flags);
+
+/** Number of lines currently held, spilled lines included (dropped lines are not counted) */
+size_t scrollback_line_count(const ScrollbackStore* sb);
+
+/**
+ * Cells of a cold line, decompressing its block if needed
+ * The returned row holds at least min_width cells (padded with blanks) and stays valid
+ * until the next scrollback_push or scrollback_clear on the same store.
+ * @param index - Line index, 0 is the oldest line held
+ * @param min_width - Minimum number of cells the caller will read
+ * @param flags - Receives the row flags when not NULL
+ * @return Pointer to the cells, or NULL if index is out of range
+ */
+const Cell* scrollback_line(ScrollbackStore* sb, size_t index, int min_width, uint8_t* flags);
+
+/**
+ * Passes the style ID of every cell held to style_gc_mark, spilled lines included
+ * Packed blocks are decompressed but their text is not decoded.
+ */
+void scrollback_mark_styles(ScrollbackStore* sb, struct StyleTable* table);
+
+/** Drops every line */
+void scrollback_clear(ScrollbackStore* sb);
+
+/** Bytes currently charged against the budget */
+size_t scrollback_memory_usage(const ScrollbackStore* sb);
+
+#endif // SCROLLBACK_H
@@ -0,0 +1,430 @@
+#include "search.h"
+#include "terminal_logic.h"
+#include "byte_scan.h"
+#include "utf8.h"
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct SearchState {
+    int active;
+    int regex;
+    int regex_error;
+    int regex_compiled;
+    regex_t compiled;
+    char query[SEARCH_QUERY_MAX];
+    size_t query_len;
+
+    // Packed text of lines first_line .. first_line + line_count - 1, each '\0'-terminated.
+    // The first history_lines lines (history_bytes of text) are history and never change
+    // until the grid's history epoch moves; the screen rows after them are re-read on
+    // every update.
+    int indexed;
+    uint32_t epoch;
+    uint64_t first_line;
+    uint64_t indexed_until;  // ID of the oldest line not yet indexed as history
+    char* text;
+    size_t text_len;
+    size_t text_cap;
+    size_t* starts;          // byte offset of each line in text
+    size_t line_count;
+    size_t line_cap;
+    size_t history_lines;
+    size_t history_bytes;
+
+    // Matches in text order (and so in line order), with their byte offsets. They answer
+    // scanned_query for the first scanned_bytes of history plus the screen.
+    SearchMatch* matches;
+    size_t* offsets;
+    size_t match_count;
+    size_t match_cap;
+    size_t current;
+    int results_valid;
+    int scanned_regex;
+    char scanned_query[SEARCH_QUERY_MAX];
+    size_t scanned_len;
+    size_t scanned_bytes;
+};
+
+SearchState* search_create(void) {
+    SearchState* search = calloc(1, sizeof(SearchState));
+    if (!search) {
+        fprintf(stderr, "Search state could not be allocated");
+        abort();
+    }
+    return search;
+}
+
+static void free_index(SearchState* search) {
+    free(search->text);
+    free(search->starts);
+    free(search->matches);
+    free(search->offsets);
+    search->text = NULL;
+    search->starts = NULL;
+    search->matches = NULL;
+    search->offsets = NULL;
+    search->text_len = search->text_cap = 0;
+    search->line_count = search->line_cap = 0;
+    search->match_count = search->match_cap = 0;
+    search->indexed = 0;
+    search->results_valid = 0;
+}
+
+void search_destroy(SearchState* search) {
+    if (!search) return;
+    free_index(search);
+    if (search->regex_compiled) regfree(&search->compiled);
+    free(search);
+}
+
+static void text_reserve(SearchState* search, size_t extra) {
+    if (search->text_len + extra <= search->text_cap) return;
+    size_t cap = search->text_cap ? search->text_cap : 1 << 16;
+    while (cap < search->text_len + extra) cap *= 2;
+    char* text = realloc(search->text, cap);
+    if (!text) {
+        fprintf(stderr, "Search index could not be allocated");
+        abort();
+    }
+    search->text = text;
+    search->text_cap = cap;
+}
+
+// Append one row to the index: blank cells become spaces, trailing blanks are dropped
+static void index_row(SearchState* search, const Cell* cells, int width) {
+    if (search->line_count == search->line_cap) {
+        size_t cap = search->line_cap ? search->line_cap * 2 : 1024;
+        size_t* starts = realloc(search->starts, cap * sizeof(size_t));
+        if (!starts) {
+            fprintf(stderr, "Search index could not be allocated");
+            abort();
+        }
+        search->starts = starts;
+        search->line_cap = cap;
+    }
+    search->starts[search->line_count++] = search->text_len;
+
+    int len = 0;
+    if (cells) {
+        len = width;
+        while (len > 0 && cells[len - 1].rune == 0) len--;
+    }
+    text_reserve(search, (size_t)len * 4 + 1);
+    for (int i = 0; i < len; i++) {
+        uint32_t rune = cells[i].rune;
+        if (rune < 0x80) {
+            search->text[search->text_len++] = rune ? (char)rune : ' ';
+        } else {
+            search->text_len += (size_t)utf8_encode(rune, search->text + search->text_len);
+        }
+    }
+    search->text[search->text_len++] = '\0';
+}
+
+// Bring the index up to date with the grid. Returns 1 when the history part was rebuilt.
+static int sync_index(SearchState* search, TerminalGrid* grid) {
+    int history = grid_history_lines(grid);  // finishes a pending reflow (which moves the epoch)
+    uint64_t screen_first = grid_line_id(grid, 0);
+    uint64_t oldest = screen_first - (uint64_t)history;
+    int rebuilt = 0;
+
+    // Lines that were rewritten, or that left the grid before we saw them, mean starting over
+    if (!search->indexed || search->epoch != grid->history_epoch || oldest > search->indexed_until) {
+        search->indexed = 1;
+        search->epoch = grid->history_epoch;
+        search->first_line = oldest;
+        search->indexed_until = oldest;
+        search->history_lines = 0;
+        search->history_bytes = 0;
+        search->results_valid = 0;
+        rebuilt = 1;
+    }
+
+    // Drop the screen rows, then append whatever scrolled into history since the last sync
+    search->line_count = search->history_lines;
+    search->text_len = search->history_bytes;
+    for (uint64_t id = search->indexed_until; id < screen_first; id++) {
+        index_row(search, grid_row(grid, (int)(int64_t)(id - screen_first)), grid->width);
+    }
+    search->indexed_until = screen_first;
+    search->history_lines = search->line_count;
+    search->history_bytes = search->text_len;
+
+    for (int row = 0; row < grid->height; row++) index_row(search, grid_row(grid, row), grid->width);
+    return rebuilt;
+}
+
+// Code points in text[from, to), which is also the number of cells they came from
+static int count_cells(const char* text, size_t from, size_t to) {
+    int cells = 0;
+    for (size_t i = from; i < to; i++) {
+        if (((unsigned char)text[i] & 0xC0) != 0x80) cells++;
+    }
+    return cells;
+}
+
+static void add_match(SearchState* search, size_t line, size_t offset, size_t len) {
+    if (search->match_count == search->match_cap) {
+        size_t cap = search->match_cap ? search->match_cap * 2 : 256;
+        SearchMatch* matches = realloc(search->matches, cap * sizeof(SearchMatch));
+        size_t* offsets = realloc(search->offsets, cap * sizeof(size_t));
+        if (!matches || !offsets) {
+            fprintf(stderr, "Search results could not be allocated");
+            abort();
+        }
+        search->matches = matches;
+        search->offsets = offsets;
+        search->match_cap = cap;
+    }
+    size_t start = search->starts[line];
+    SearchMatch* match = &search->matches[search->match_count];
+    match->line = search->first_line + line;
+    match->col = count_cells(search->text, start, offset);
+    match->len = count_cells(search->text, offset, offset + len);
+    search->offsets[search->match_count++] = offset;
+}
+
+// Index of the line containing byte offset
+static size_t line_at(const SearchState* search, size_t offset) {
+    size_t lo = 0, hi = search->line_count;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (search->starts[mid] <= offset) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Literal: one vectorized scan over the packed text. Every start position is recorded, even
+// overlapping ones, so that a longer query's matches are always a subset of these.
+static void scan_literal(SearchState* search, size_t from) {
+    const char* text = search->text;
+    size_t end = search->text_len;
+    size_t line = line_at(search, from);
+    size_t pos = from;
+    while (pos < end) {
+        size_t hit = pos + scan_find(text + pos, end - pos, search->query, search->query_len);
+        if (hit >= end) break;
+        while (line + 1 < search->line_count && search->starts[line + 1] <= hit) line++;
+        add_match(search, line, hit, search->query_len);
+        pos = hit + 1;
+    }
+}
+
+// Regex: each line is its own '\0'-terminated string, so matches never cross lines
+static void scan_regex(SearchState* search, size_t from) {
+    for (size_t line = line_at(search, from); line < search->line_count; line++) {
+        const char* start = search->text + search->starts[line];
+        const char* p = start;
+        int eflags = 0;
+        regmatch_t m;
+        while (*p && regexec(&search->compiled, p, 1, &m, eflags) == 0) {
+            size_t offset = (size_t)(p - search->text) + (size_t)m.rm_so;
+            if (m.rm_eo > m.rm_so) add_match(search, line, offset, (size_t)(m.rm_eo - m.rm_so));
+            p += m.rm_eo > m.rm_so ? m.rm_eo : m.rm_so + 1;
+            eflags = REG_NOTBOL;
+        }
+    }
+}
+
+// Recompute the matches, reusing the previous results where the query allows it
+static void rescan(SearchState* search) {
+    if (search->query_len == 0 || (search->regex && search->regex_error)) {
+        search->match_count = 0;
+        search->results_valid = 0;
+        return;
+    }
+
+    int same = search->results_valid && search->scanned_regex == search->regex &&
+               search->scanned_len == search->query_len &&
+               memcmp(search->scanned_query, search->query, search->query_len) == 0;
+    // A literal query that only grew matches a subset of the old starts
+    int narrow = search->results_valid && !search->regex && !search->scanned_regex &&
+                 search->query_len > search->scanned_len &&
+                 memcmp(search->scanned_query, search->query, search->scanned_len) == 0;
+
+    size_t from = 0;
+    if (same || narrow) {
+        // History matches stay; screen matches are dropped because the screen was re-read
+        size_t kept = 0;
+        for (size_t i = 0; i < search->match_count; i++) {
+            size_t offset = search->offsets[i];
+            if (offset >= search->scanned_bytes) break;
+            if (narrow) {
+                if (offset + search->query_len > search->text_len ||
+                    memcmp(search->text + offset, search->query, search->query_len) != 0) continue;
+                search->matches[i].len = count_cells(search->text, offset, offset + search->query_len);
+            }
+            search->matches[kept] = search->matches[i];
+            search->offsets[kept] = offset;
+            kept++;
+        }
+        search->match_count = kept;
+        from = search->scanned_bytes;
+    } else {
+        search->match_count = 0;
+    }
+
+    if (search->regex) scan_regex(search, from);
+    else scan_literal(search, from);
+
+    search->results_valid = 1;
+    search->scanned_regex = search->regex;
+    memcpy(search->scanned_query, search->query, search->query_len);
+    search->scanned_len = search->query_len;
+    search->scanned_bytes = search->history_bytes;
+}
+
+// First match on a line at or after `line`
+static size_t lower_bound(const SearchState* search, uint64_t line) {
+    size_t lo = 0, hi = search->match_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (search->matches[mid].line < line) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Scroll the view so the current match is on screen, near the middle if it has to move
+static void reveal_current(SearchState* search, TerminalGrid* grid) {
+    if (search->match_count == 0) return;
+    int64_t row = (int64_t)(search->matches[search->current].line - grid_line_id(grid, 0));
+    int64_t view_top = -grid->view_offset;
+    if (row >= view_top && row < view_top + grid->height) return;
+    int64_t target = grid->height / 2 - row;
+    grid_scroll_view(grid, (int)(target - grid->view_offset));
+}
+
+// A new query starts from the newest match that is not below the view
+static void pick_current(SearchState* search, TerminalGrid* grid) {
+    uint64_t bottom = grid_line_id(grid, grid->height - 1 - grid->view_offset);
+    size_t i = lower_bound(search, bottom + 1);
+    search->current = i > 0 ? i - 1 : 0;
+}
+
+// Re-index, rescan and pick the current match after the query or mode changed
+static void query_changed(SearchState* search, TerminalGrid* grid) {
+    if (search->regex) {
+        if (search->regex_compiled) regfree(&search->compiled);
+        search->regex_compiled = 0;
+        search->regex_error = 0;
+        if (search->query_len > 0) {
+            search->regex_error = regcomp(&search->compiled, search->query, REG_EXTENDED) != 0;
+            search->regex_compiled = !search->regex_error;
+        }
+    }
+    if (!search->active) return;
+    sync_index(search, grid);
+    rescan(search);
+    pick_current(search, grid);
+    reveal_current(search, grid);
+    grid_damage_all(grid);
+}
+
+void search_open(SearchState* search, TerminalGrid* grid) {
+    if (search->active) return;
+    search->active = 1;
+    query_changed(search, grid);
+}
+
+void search_close(SearchState* search) {
+    search->active = 0;
+    free_index(search);
+}
+
+int search_is_active(const SearchState* search) {
+    return search->active;
+}
+
+void search_append(SearchState* search, TerminalGrid* grid, uint32_t codepoint) {
+    char bytes[4];
+    int n = utf8_encode(codepoint, bytes);
+    if (codepoint == 0 || search->query_len + (size_t)n >= SEARCH_QUERY_MAX) return;
+    memcpy(search->query + search->query_len, bytes, (size_t)n);
+    search->query_len += (size_t)n;
+    search->query[search->query_len] = '\0';
+    query_changed(search, grid);
+}
+
+void search_backspace(SearchState* search, TerminalGrid* grid) {
+    if (search->query_len == 0) return;
+    do {
+        search->query_len--;
+    } while (search->query_len > 0 && ((unsigned char)search->query[search->query_len] & 0xC0) == 0x80);
+    search->query[search->query_len] = '\0';
+    query_changed(search, grid);
+}
+
+void search_toggle_regex(SearchState* search, TerminalGrid* grid) {
+    search->regex = !search->regex;
+    if (!search->regex && search->regex_compiled) {
+        regfree(&search->compiled);
+        search->regex_compiled = 0;
+    }
+    search->regex_error = 0;
+    query_changed(search, grid);
+}
+
+void search_refresh(SearchState* search, TerminalGrid* grid) {
+    if (!search->active) return;
+    // Follow the current match through the rescan by its line and column
+    SearchMatch current = {0};
+    int had_current = search->match_count > 0;
+    if (had_current) current = search->matches[search->current];
+
+    int rebuilt = sync_index(search, grid);
+    rescan(search);
+
+    if (rebuilt || !had_current) {
+        pick_current(search, grid);
+    } else {
+        size_t i = lower_bound(search, current.line);
+        while (i < search->match_count && search->matches[i].line == current.line &&
+               search->matches[i].col < current.col) i++;
+        search->current = i < search->match_count ? i : (search->match_count ? search->match_count - 1 : 0);
+    }
+    grid_damage_all(grid);
+}
+
+void search_step(SearchState* search, TerminalGrid* grid, int direction) {
+    if (!search->active || search->match_count == 0) return;
+    if (direction < 0) search->current = search->current > 0 ? search->current - 1 : search->match_count - 1;
+    else search->current = search->current + 1 < search->match_count ? search->current + 1 : 0;
+    reveal_current(search, grid);
+    grid_damage_all(grid);
+}
+
+size_t search_line_matches(const SearchState* search, uint64_t line, const SearchMatch** first, int* current) {
+    if (current) *current = -1;
+    size_t i = lower_bound(search, line);
+    size_t n = 0;
+    while (i + n < search->match_count && search->matches[i + n].line == line) n++;
+    if (n > 0) {
+        *first = &search->matches[i];
+        if (current && search->current >= i && search->current < i + n) *current = (int)(search->current - i);
+    }
+    return n;
+}
+
+const char* search_query(const SearchState* search) {
+    return search->query;
+}
+
+int search_is_regex(const SearchState* search) {
+    return search->regex;
+}
+
+int search_has_error(const SearchState* search) {
+    return search->regex && search->regex_error;
+}
+
+size_t search_match_count(const SearchState* search) {
+    return search->match_count;
+}
+
+size_t search_current_index(const SearchState* search) {
+    return search->current;
+}
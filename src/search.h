@@ -0,0 +1,92 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "types.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Scrollback search
+ * The history and screen are flattened once into a packed UTF-8 text index (one
+ * '\0'-terminated string per line) that is scanned with the vectorized byte search.
+ * History lines are appended to the index as they scroll in and only the screen rows
+ * are re-read on refresh. Typing another character narrows the previous literal result
+ * instead of rescanning; regex mode runs POSIX extended expressions line by line.
+ */
+
+#define SEARCH_QUERY_MAX 256
+
+typedef struct SearchState SearchState;
+
+// One hit, in grid cells
+typedef struct {
+	uint64_t line;   // grid_line_id of the row
+	int col;         // first cell
+	int len;         // cells covered
+} SearchMatch;
+
+/** Creates an inactive search with an empty query */
+SearchState* search_create(void);
+
+/** Frees the index, the results and the state itself */
+void search_destroy(SearchState* search);
+
+/**
+ * Opens the query bar and indexes the grid on first use
+ * The previous query is kept, so reopening shows its matches again.
+ */
+void search_open(SearchState* search, TerminalGrid* grid);
+
+/** Closes the query bar and frees the index */
+void search_close(SearchState* search);
+
+/** 1 while the query bar is open */
+int search_is_active(const SearchState* search);
+
+/**
+ * Appends a code point to the query and updates the matches
+ * A literal query that only grew is answered by narrowing the previous matches.
+ */
+void search_append(SearchState* search, TerminalGrid* grid, uint32_t codepoint);
+
+/** Removes the last code point of the query and rescans */
+void search_backspace(SearchState* search, TerminalGrid* grid);
+
+/** Switches between literal and regex matching and rescans */
+void search_toggle_regex(SearchState* search, TerminalGrid* grid);
+
+/**
+ * Picks up output that arrived since the last update: new history lines are appended to
+ * the index, the screen rows are re-read, and only that new text is scanned
+ */
+void search_refresh(SearchState* search, TerminalGrid* grid);
+
+/**
+ * Moves the current match and scrolls the view to show it
+ * @param direction - Negative steps towards older lines, positive towards newer ones
+ */
+void search_step(SearchState* search, TerminalGrid* grid, int direction);
+
+/**
+ * Matches that start on a line, in column order
+ * @param line - grid_line_id of the row
+ * @param first - Receives the first match on the line (unchanged when there is none)
+ * @param current - Receives the index within *first of the current match, or -1
+ * @return Number of matches on the line
+ */
+size_t search_line_matches(const SearchState* search, uint64_t line, const SearchMatch** first, int* current);
+
+/** Query as typed, '\0'-terminated */
+const char* search_query(const SearchState* search);
+
+/** 1 in regex mode */
+int search_is_regex(const SearchState* search);
+
+/** 1 when the regex does not compile */
+int search_has_error(const SearchState* search);
+
+/** Total matches and the 0-based position of the current one (meaningless when count is 0) */
+size_t search_match_count(const SearchState* search);
+size_t search_current_index(const SearchState* search);
+
+#endif // SEARCH_H
@@ -0,0 +1,354 @@
+#include "session_log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Ring between the terminal thread and the writer thread, a power of two
+#define RECORDER_RING_SIZE ((size_t)4 << 20)
+
+#define SESSION_HEADER_SIZE 12
+
+struct SessionRecorder {
+    int fd;
+    char* ring;
+    _Atomic size_t head;     // bytes ever appended, only the terminal thread writes it
+    _Atomic size_t tail;     // bytes ever written to disk, only the writer thread writes it
+    atomic_int stop;
+    atomic_int sleeping;     // writer is (about to be) blocked on wake, set under lock
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int failed;              // writer hit an I/O error, the rest is discarded
+    pthread_t writer;
+    uint64_t last_us;        // timestamp of the previous record
+    size_t stalls;           // times the terminal thread found the ring full
+};
+
+struct SessionReplay {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    int cols;
+    int rows;
+    int realtime;
+    int started;
+    double start;            // `now` of the first session_replay_next call
+    uint64_t time_us;        // timestamp of the last record handed out
+    int finished;
+};
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static int write_all(int fd, const void* buf, size_t len) {
+    const char* p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+// Blocks until the terminal thread appends past tail or asks the writer to stop. sleeping is
+// set before head is looked at again, and the terminal thread stores head before it reads
+// sleeping, so at least one side sees the other and no wakeup is lost.
+static void wait_for_data(SessionRecorder* rec, size_t tail) {
+    pthread_mutex_lock(&rec->lock);
+    atomic_store(&rec->sleeping, 1);
+    while (atomic_load(&rec->head) == tail && !atomic_load(&rec->stop)) {
+        pthread_cond_wait(&rec->wake, &rec->lock);
+    }
+    atomic_store(&rec->sleeping, 0);
+    pthread_mutex_unlock(&rec->lock);
+}
+
+// Only a writer that found the ring empty sleeps, so the lock is taken on the empty to
+// non-empty transition and on stop, never while output streams
+static void wake_writer(SessionRecorder* rec) {
+    if (!atomic_load(&rec->sleeping)) return;
+    pthread_mutex_lock(&rec->lock);
+    pthread_cond_signal(&rec->wake);
+    pthread_mutex_unlock(&rec->lock);
+}
+
+static void* writer_main(void* arg) {
+    SessionRecorder* rec = arg;
+    for (;;) {
+        size_t tail = atomic_load_explicit(&rec->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&rec->head, memory_order_acquire);
+        if (head == tail) {
+            if (atomic_load_explicit(&rec->stop, memory_order_acquire)) {
+                // The producer stops before setting stop, so a last look settles it
+                if (atomic_load_explicit(&rec->head, memory_order_acquire) == tail) break;
+                continue;
+            }
+            wait_for_data(rec, tail);
+            continue;
+        }
+
+        // Write up to the end of the ring, the wrapped part goes out on the next pass
+        size_t offset = tail & (RECORDER_RING_SIZE - 1);
+        size_t len = head - tail;
+        if (len > RECORDER_RING_SIZE - offset) len = RECORDER_RING_SIZE - offset;
+        if (!rec->failed && !write_all(rec->fd, rec->ring + offset, len)) {
+            fprintf(stderr, "Session log write failed: %s\n", strerror(errno));
+            rec->failed = 1;
+        }
+        atomic_store_explicit(&rec->tail, tail + len, memory_order_release);
+    }
+    return NULL;
+}
+
+SessionRecorder* session_recorder_open(const char* path, int cols, int rows) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Could not create session log '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    uint8_t header[SESSION_HEADER_SIZE];
+    memcpy(header, SESSION_LOG_MAGIC, 8);
+    header[8] = (uint8_t)cols;
+    header[9] = (uint8_t)(cols >> 8);
+    header[10] = (uint8_t)rows;
+    header[11] = (uint8_t)(rows >> 8);
+    if (!write_all(fd, header, sizeof(header))) {
+        fprintf(stderr, "Could not write session log '%s': %s\n", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    SessionRecorder* rec = calloc(1, sizeof(SessionRecorder));
+    char* ring = malloc(RECORDER_RING_SIZE);
+    if (!rec || !ring) {
+        fprintf(stderr, "Session recorder could not be allocated");
+        abort();
+    }
+    rec->fd = fd;
+    rec->ring = ring;
+    atomic_init(&rec->head, 0);
+    atomic_init(&rec->tail, 0);
+    atomic_init(&rec->stop, 0);
+    atomic_init(&rec->sleeping, 0);
+    pthread_mutex_init(&rec->lock, NULL);
+    pthread_cond_init(&rec->wake, NULL);
+    rec->last_us = monotonic_us();
+
+    if (pthread_create(&rec->writer, NULL, writer_main, rec) != 0) {
+        fprintf(stderr, "Session log writer thread could not be started\n");
+        pthread_mutex_destroy(&rec->lock);
+        pthread_cond_destroy(&rec->wake);
+        close(fd);
+        free(ring);
+        free(rec);
+        return NULL;
+    }
+    return rec;
+}
+
+// Copy bytes into the ring, waiting for the writer only when the ring is full
+static void ring_put(SessionRecorder* rec, const void* data, size_t len) {
+    const char* p = data;
+    size_t head = atomic_load_explicit(&rec->head, memory_order_relaxed);
+    while (len > 0) {
+        size_t used = head - atomic_load_explicit(&rec->tail, memory_order_acquire);
+        size_t space = RECORDER_RING_SIZE - used;
+        if (space == 0) {
+            rec->stalls++;
+            sched_yield();
+            continue;
+        }
+        size_t offset = head & (RECORDER_RING_SIZE - 1);
+        size_t n = len;
+        if (n > space) n = space;
+        if (n > RECORDER_RING_SIZE - offset) n = RECORDER_RING_SIZE - offset;
+        memcpy(rec->ring + offset, p, n);
+        head += n;
+        p += n;
+        len -= n;
+        atomic_store(&rec->head, head);
+        wake_writer(rec);
+    }
+}
+
+static size_t put_varint(uint8_t* out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+void session_record(SessionRecorder* rec, SessionRecordKind kind, const void* data, size_t len) {
+    if (!rec) return;
+    uint64_t now = monotonic_us();
+    uint8_t header[1 + 10 + 10];
+    size_t n = 0;
+    header[n++] = (uint8_t)kind;
+    n += put_varint(header + n, now - rec->last_us);
+    n += put_varint(header + n, len);
+    rec->last_us = now;
+    ring_put(rec, header, n);
+    ring_put(rec, data, len);
+}
+
+void session_record_resize(SessionRecorder* rec, int cols, int rows) {
+    uint8_t size[4] = {(uint8_t)cols, (uint8_t)(cols >> 8), (uint8_t)rows, (uint8_t)(rows >> 8)};
+    session_record(rec, SESSION_RESIZE, size, sizeof(size));
+}
+
+void session_recorder_close(SessionRecorder* rec) {
+    if (!rec) return;
+    atomic_store(&rec->stop, 1);
+    wake_writer(rec);
+    pthread_join(rec->writer, NULL);
+    pthread_mutex_destroy(&rec->lock);
+    pthread_cond_destroy(&rec->wake);
+    if (rec->stalls > 0) {
+        fprintf(stderr, "Session log: the writer fell behind %zu times, those records were delayed\n", rec->stalls);
+    }
+    close(rec->fd);
+    free(rec->ring);
+    free(rec);
+}
+
+SessionReplay* session_replay_open(const char* path, int realtime) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open session log '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < SESSION_HEADER_SIZE) {
+        fprintf(stderr, "'%s' is not a session log\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    // Fault the whole log in now so replay timing never waits on the disk
+    flags |= MAP_POPULATE;
+#endif
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Could not map session log '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    if (memcmp(data, SESSION_LOG_MAGIC, 8) != 0) {
+        fprintf(stderr, "'%s' is not a session log\n", path);
+        munmap(data, (size_t)st.st_size);
+        return NULL;
+    }
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    SessionReplay* replay = calloc(1, sizeof(SessionReplay));
+    if (!replay) {
+        fprintf(stderr, "Session replay could not be allocated");
+        abort();
+    }
+    replay->data = data;
+    replay->size = (size_t)st.st_size;
+    replay->pos = SESSION_HEADER_SIZE;
+    replay->cols = replay->data[8] | replay->data[9] << 8;
+    replay->rows = replay->data[10] | replay->data[11] << 8;
+    replay->realtime = realtime;
+    return replay;
+}
+
+void session_replay_size(const SessionReplay* replay, int* cols, int* rows) {
+    *cols = replay->cols;
+    *rows = replay->rows;
+}
+
+static int read_varint(const SessionReplay* replay, size_t* pos, uint64_t* value) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64 && *pos < replay->size; shift += 7) {
+        uint8_t byte = replay->data[(*pos)++];
+        v |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = v;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int session_replay_next(SessionReplay* replay, double now, SessionRecord* record) {
+    if (replay->finished) return 0;
+    if (!replay->started) {
+        replay->started = 1;
+        replay->start = now;
+    }
+
+    // A record cut short (the recorder was killed mid-write) ends the replay
+    size_t pos = replay->pos;
+    uint64_t delta, len;
+    if (pos >= replay->size) {
+        replay->finished = 1;
+        return 0;
+    }
+    uint8_t kind = replay->data[pos++];
+    if (!read_varint(replay, &pos, &delta) || !read_varint(replay, &pos, &len) || len > replay->size - pos) {
+        replay->finished = 1;
+        return 0;
+    }
+
+    uint64_t time_us = replay->time_us + delta;
+    if (replay->realtime && (now - replay->start) * 1e6 < (double)time_us) return 0;
+
+    record->kind = (SessionRecordKind)kind;
+    record->time = time_us / 1e6;
+    record->data = (const char*)replay->data + pos;
+    record->len = (size_t)len;
+    record->cols = record->rows = 0;
+    if (record->kind == SESSION_RESIZE && len >= 4) {
+        const uint8_t* p = replay->data + pos;
+        record->cols = p[0] | p[1] << 8;
+        record->rows = p[2] | p[3] << 8;
+    }
+
+    replay->time_us = time_us;
+    replay->pos = pos + (size_t)len;
+    return 1;
+}
+
+double session_replay_wait(const SessionReplay* replay, double now) {
+    if (session_replay_finished(replay)) return -1.0;
+    if (!replay->realtime || !replay->started) return 0.0;
+
+    size_t pos = replay->pos + 1;
+    uint64_t delta;
+    if (!read_varint(replay, &pos, &delta)) return 0.0;   // the next call ends the replay
+    double due = replay->start + (replay->time_us + delta) / 1e6;
+    return due > now ? due - now : 0.0;
+}
+
+int session_replay_finished(const SessionReplay* replay) {
+    return replay->finished || replay->pos >= replay->size;
+}
+
+void session_replay_close(SessionReplay* replay) {
+    if (!replay) return;
+    munmap((void*)replay->data, replay->size);
+    free(replay);
+}
@@ -0,0 +1,92 @@
+#ifndef SESSION_LOG_H
+#define SESSION_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Session recording and replay
+ * A log is the 8 byte magic "MAGTLOG1" and the initial grid size (two little-endian
+ * uint16: cols, rows), followed by records:
+ *   kind (1 byte) | microseconds since the previous record (varint) | length (varint) | payload
+ * Output records hold exactly the bytes of one PTY read, so replay reproduces the original
+ * chunk boundaries. Resize payloads are two little-endian uint16 (cols, rows).
+ *
+ * The recorder copies records into a single-producer / single-consumer ring that a
+ * background thread writes to disk, so the terminal thread never waits on I/O. The replay
+ * side maps the whole log and hands out pointers into the mapping.
+ */
+
+#define SESSION_LOG_MAGIC "MAGTLOG1"
+
+typedef enum {
+    SESSION_OUTPUT = 0,   // bytes read from the PTY
+    SESSION_INPUT = 1,    // bytes written to the PTY
+    SESSION_RESIZE = 2,   // grid size sent to the PTY
+} SessionRecordKind;
+
+typedef struct {
+    SessionRecordKind kind;
+    double time;          // seconds since the start of the recording
+    const char* data;     // payload, points into the mapped log
+    size_t len;
+    int cols;             // new size, for SESSION_RESIZE
+    int rows;
+} SessionRecord;
+
+typedef struct SessionRecorder SessionRecorder;
+typedef struct SessionReplay SessionReplay;
+
+/**
+ * Creates (or truncates) a log file and starts its writer thread
+ * @param cols - Grid columns at the start of the session
+ * @param rows - Grid rows at the start of the session
+ * @return New recorder, or NULL if the file could not be created
+ */
+SessionRecorder* session_recorder_open(const char* path, int cols, int rows);
+
+/**
+ * Appends a record stamped with the current monotonic time
+ * Never blocks on I/O; only waits if the writer thread has fallen a full ring behind.
+ */
+void session_record(SessionRecorder* rec, SessionRecordKind kind, const void* data, size_t len);
+
+/** Appends a SESSION_RESIZE record */
+void session_record_resize(SessionRecorder* rec, int cols, int rows);
+
+/** Flushes every record, stops the writer thread and closes the file */
+void session_recorder_close(SessionRecorder* rec);
+
+/**
+ * Maps a log for replay
+ * @param realtime - 1 to hand out records at their recorded times, 0 as fast as asked for
+ * @return New replay, or NULL if the file is missing or not a session log
+ */
+SessionReplay* session_replay_open(const char* path, int realtime);
+
+/** Grid size stored in the log header */
+void session_replay_size(const SessionReplay* replay, int* cols, int* rows);
+
+/**
+ * Next record if it is due
+ * @param now - Current time in seconds on any monotonic clock; the first call is time 0
+ * @param record - Receives the record, its data stays valid until session_replay_close
+ * @return 1 when a record was returned, 0 when the next one is not due yet or the log ended
+ */
+int session_replay_next(SessionReplay* replay, double now, SessionRecord* record);
+
+/**
+ * Seconds until the next record is due, for sleeping between records
+ * @param now - Same clock as session_replay_next
+ * @return 0 when a record is due now (always, for a replay that is not realtime), -1 once
+ *         the log has ended
+ */
+double session_replay_wait(const SessionReplay* replay, double now);
+
+/** 1 once every record has been returned (a truncated last record counts as the end) */
+int session_replay_finished(const SessionReplay* replay);
+
+/** Unmaps the log */
+void session_replay_close(SessionReplay* replay);
+
+#endif // SESSION_LOG_H
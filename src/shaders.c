@@ -1,26 +1,48 @@
 #include "shaders.h"
 
-/** Vertex shader source code - Handles text quad positioning and texture coordinate mapping */
-const char* vertexShaderSrc =
+/**
+ * Grid vertex shader - One instance per quad, expanded from a unit quad. The instance carries
+ * its pixel rectangle, an atlas rectangle, an RGBA colour and its kind: 0 solid fill, 1 bitmap
+ * glyph, 2 signed distance field glyph.
+ */
+const char* gridVertexShaderSrc =
 "#version 330 core\n"
-"layout(location = 0) in vec4 vertex;\n"
+"layout(location = 0) in vec2 corner;\n"
+"layout(location = 1) in vec4 rect;\n"
+"layout(location = 2) in vec4 uv;\n"
+"layout(location = 3) in vec4 color;\n"
+"layout(location = 4) in uint kind;\n"
 "out vec2 TexCoords;\n"
-"uniform mat4 projection;\n"
+"flat out vec4 QuadColor;\n"
+"flat out uint Kind;\n"
+"uniform vec2 screen;\n"
 "void main() {\n"
-"    gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);\n"
-"    TexCoords = vertex.zw;\n"
+"    vec2 pos = rect.xy + corner * rect.zw;\n"
+"    gl_Position = vec4(pos / screen * 2.0 - 1.0, 0.0, 1.0);\n"
+"    TexCoords = vec2(mix(uv.x, uv.z, corner.x), mix(uv.w, uv.y, corner.y));\n"
+"    QuadColor = color;\n"
+"    Kind = kind;\n"
 "}\n";
 
-/** Fragment shader source code - Renders textured quads with alpha blending for text */
-const char* fragmentShaderSrc =
+/**
+ * Grid fragment shader - Solid fills use the instance colour, bitmap glyphs take coverage from
+ * the atlas. A distance field is 0.5 on the outline and grows inwards; coverage ramps across
+ * the width of one screen pixel around 0.5, whatever the scale.
+ */
+const char* gridFragmentShaderSrc =
 "#version 330 core\n"
 "in vec2 TexCoords;\n"
+"flat in vec4 QuadColor;\n"
+"flat in uint Kind;\n"
 "out vec4 FragColor;\n"
-"uniform sampler2D text;\n"
-"uniform vec3 textColor;\n"
+"uniform sampler2D atlas;\n"
 "void main() {\n"
-"    float alpha = texture(text, vec2(TexCoords.x, 1.0 - TexCoords.y)).r;\n"
-"    FragColor = vec4(textColor, alpha);\n"
+"    float texel = texture(atlas, TexCoords).r;\n"
+"    float edge = max(fwidth(texel) * 0.5, 1.0 / 255.0);\n"
+"    float alpha = texel;\n"
+"    if (Kind == 0u) alpha = 1.0;\n"
+"    else if (Kind == 2u) alpha = smoothstep(0.5 - edge, 0.5 + edge, texel);\n"
+"    FragColor = vec4(QuadColor.rgb, QuadColor.a * alpha);\n"
 "}\n";
 
 /**
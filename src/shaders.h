@@ -9,11 +9,11 @@
  * Handles compilation of vertex and fragment shaders and linking them into programs
  */
 
-/** Vertex shader source code - Handles text quad positioning and texture coordinate mapping */
-extern const char* vertexShaderSrc;
+/** Grid vertex shader source code - Expands instanced quads (cell backgrounds and glyphs) */
+extern const char* gridVertexShaderSrc;
 
-/** Fragment shader source code - Renders textured quads with alpha blending for text */
-extern const char* fragmentShaderSrc;
+/** Grid fragment shader source code - Solid fills, atlas-sampled glyph coverage or distance fields */
+extern const char* gridFragmentShaderSrc;
 
 /**
  * Compiles a single shader from source code
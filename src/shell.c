@@ -1,5 +1,6 @@
 
 #include "shell.h"
+#include "session_log.h"
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -8,17 +9,21 @@
 #include <sys/wait.h>
 #include <string.h>
 #include <signal.h>
+#include <sys/ioctl.h>
 #ifdef __APPLE__
     #include <util.h>
 #else
     #include <pty.h>
 #endif
 
-ShellPTY launch_shell(const char* shell_path) {
+ShellPTY launch_shell(const char* shell_path, int cols, int rows) {
     ShellPTY shell = {0};
+    struct winsize size = {0};
+    size.ws_col = (unsigned short)cols;
+    size.ws_row = (unsigned short)rows;
 
     // forkpty opens a new PTY and forks
-    shell.child_pid = forkpty(&shell.master_fd, NULL, NULL, NULL);
+    shell.child_pid = forkpty(&shell.master_fd, NULL, NULL, &size);
     if (shell.child_pid < 0) {
         perror("forkpty failed");
         exit(1);
@@ -40,15 +45,31 @@ ShellPTY launch_shell(const char* shell_path) {
 }
 
 void shell_send(ShellPTY* shell, const char* input) {
-    if (!shell) return;
+    if (!shell || shell->master_fd < 0) return;
     write(shell->master_fd, input, strlen(input));
     write(shell->master_fd, "\n", 1); // simulate Enter
+    if (shell->recorder) {
+        session_record(shell->recorder, SESSION_INPUT, input, strlen(input));
+        session_record(shell->recorder, SESSION_INPUT, "\n", 1);
+    }
+}
+
+void shell_resize(ShellPTY* shell, int cols, int rows, int width_px, int height_px) {
+    if (!shell) return;
+    struct winsize size = {0};
+    size.ws_col = (unsigned short)cols;
+    size.ws_row = (unsigned short)rows;
+    size.ws_xpixel = (unsigned short)width_px;
+    size.ws_ypixel = (unsigned short)height_px;
+    if (ioctl(shell->master_fd, TIOCSWINSZ, &size) < 0) perror("TIOCSWINSZ failed");
+    if (shell->recorder) session_record_resize(shell->recorder, cols, rows);
 }
 
 ssize_t shell_receive(ShellPTY* shell, char* buffer, size_t bufsize) {
     if (!shell) return -1;
     ssize_t n = read(shell->master_fd, buffer, bufsize - 1);
     if (n > 0) buffer[n] = '\0'; // null terminate
+    if (n > 0 && shell->recorder) session_record(shell->recorder, SESSION_OUTPUT, buffer, (size_t)n);
     return n;
 }
 
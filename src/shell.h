@@ -3,13 +3,19 @@
 #include <stddef.h>
 #include <sys/types.h>
 
+struct SessionRecorder;
+
 typedef struct ShellPTY {
     int master_fd;   // PTY master
     pid_t child_pid; // shell process PID
+    struct SessionRecorder* recorder; // when set, every read, write and resize is logged
 } ShellPTY;
 
-// Launch a shell, return ShellPTY struct
-ShellPTY launch_shell(const char* shell_path);
+// Launch a shell on a PTY of cols x rows cells, return ShellPTY struct
+ShellPTY launch_shell(const char* shell_path, int cols, int rows);
+
+// Tell the shell its terminal is now cols x rows cells (TIOCSWINSZ, the shell gets SIGWINCH)
+void shell_resize(ShellPTY* shell, int cols, int rows, int width_px, int height_px);
 
 // Send a command string to the shell
 void shell_send(ShellPTY* shell, const char* input);
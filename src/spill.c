@@ -0,0 +1,153 @@
+#include "spill.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Address space reserved up front so the mappings never move while pointers are out
+#define SPILL_DATA_RESERVE ((size_t)1 << 37)
+#define SPILL_INDEX_RESERVE ((size_t)1 << 32)
+
+typedef struct {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t lines;
+} SpillIndexEntry;
+
+struct SpillFile {
+    int data_fd;
+    int index_fd;
+    const uint8_t* data;
+    const SpillIndexEntry* index;
+    uint64_t data_size;
+    size_t blocks;
+};
+
+// Creates a new file under a random name in dir and unlinks it. mkstemp opens with O_EXCL,
+// so a file or symlink planted at that name makes it try another instead of following it.
+static int open_unlinked(const char* dir) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/scroll-XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "Could not create scrollback spill in '%s': %s\n", dir, strerror(errno));
+        return -1;
+    }
+    unlink(path);
+    return fd;
+}
+
+// The directory may live in a shared /tmp, where anyone could have created it first
+static int dir_is_private(const char* dir) {
+    struct stat st;
+    if (lstat(dir, &st) != 0) {
+        fprintf(stderr, "Could not check '%s': %s\n", dir, strerror(errno));
+        return 0;
+    }
+    if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 0777) != 0700) {
+        fprintf(stderr, "Not using '%s' for scrollback: it must be a directory owned by this user with mode 0700\n",
+                dir);
+        return 0;
+    }
+    return 1;
+}
+
+static int write_all(int fd, const void* buf, size_t len, uint64_t offset) {
+    const uint8_t* p = buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 1;
+}
+
+SpillFile* spill_open(void) {
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    if (!runtime || !*runtime) runtime = "/tmp";
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/mag-terminal", runtime);
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create '%s': %s\n", dir, strerror(errno));
+        return NULL;
+    }
+    if (!dir_is_private(dir)) return NULL;
+
+    SpillFile* spill = calloc(1, sizeof(SpillFile));
+    if (!spill) return NULL;
+    spill->data_fd = -1;
+    spill->index_fd = -1;
+
+    spill->data_fd = open_unlinked(dir);
+    spill->index_fd = open_unlinked(dir);
+    if (spill->data_fd < 0 || spill->index_fd < 0) {
+        spill_close(spill);
+        return NULL;
+    }
+
+    // Mapping past the end of the file is fine as long as only written bytes are read
+    void* data = mmap(NULL, SPILL_DATA_RESERVE, PROT_READ, MAP_SHARED, spill->data_fd, 0);
+    void* index = mmap(NULL, SPILL_INDEX_RESERVE, PROT_READ, MAP_SHARED, spill->index_fd, 0);
+    spill->data = data == MAP_FAILED ? NULL : data;
+    spill->index = index == MAP_FAILED ? NULL : index;
+    if (!spill->data || !spill->index) {
+        fprintf(stderr, "Could not map scrollback spill: %s\n", strerror(errno));
+        spill_close(spill);
+        return NULL;
+    }
+
+    return spill;
+}
+
+void spill_close(SpillFile* spill) {
+    if (!spill) return;
+    if (spill->data) munmap((void*)spill->data, SPILL_DATA_RESERVE);
+    if (spill->index) munmap((void*)spill->index, SPILL_INDEX_RESERVE);
+    if (spill->data_fd >= 0) close(spill->data_fd);
+    if (spill->index_fd >= 0) close(spill->index_fd);
+    free(spill);
+}
+
+int spill_append(SpillFile* spill, const uint8_t* data, size_t size, int lines) {
+    if (!spill || size > UINT32_MAX) return 0;
+    if (spill->data_size + size > SPILL_DATA_RESERVE) return 0;
+    if ((spill->blocks + 1) * sizeof(SpillIndexEntry) > SPILL_INDEX_RESERVE) return 0;
+
+    SpillIndexEntry entry = {spill->data_size, (uint32_t)size, (uint32_t)lines};
+    if (!write_all(spill->data_fd, data, size, spill->data_size)) return 0;
+    if (!write_all(spill->index_fd, &entry, sizeof(entry), spill->blocks * sizeof(entry))) return 0;
+
+    spill->data_size += size;
+    spill->blocks++;
+    return 1;
+}
+
+size_t spill_block_count(const SpillFile* spill) {
+    return spill ? spill->blocks : 0;
+}
+
+const uint8_t* spill_block(const SpillFile* spill, size_t index, size_t* size, int* lines) {
+    if (!spill || index >= spill->blocks) return NULL;
+    const SpillIndexEntry* entry = &spill->index[index];
+    if (size) *size = entry->size;
+    if (lines) *lines = (int)entry->lines;
+    return spill->data + entry->offset;
+}
+
+void spill_reset(SpillFile* spill) {
+    if (!spill) return;
+    if (ftruncate(spill->data_fd, 0) != 0 || ftruncate(spill->index_fd, 0) != 0) {
+        fprintf(stderr, "Could not truncate scrollback spill: %s\n", strerror(errno));
+    }
+    spill->data_size = 0;
+    spill->blocks = 0;
+}
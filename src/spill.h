@@ -0,0 +1,51 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * On-disk scrollback spill
+ * Packed scrollback blocks evicted from memory are appended to
+ * a file in $XDG_RUNTIME_DIR/mag-terminal (or /tmp/mag-terminal, which must be a 0700
+ * directory owned by the user), with a fixed-size entry per block in a companion index file. Both files are mapped read-only so lookups hand out pointers
+ * straight into the page cache, and both are unlinked as soon as they are open, so the
+ * kernel deletes them when the session ends, however it ends.
+ */
+
+typedef struct SpillFile SpillFile;
+
+/**
+ * Creates and maps the spill files for this process
+ * @return New spill, or NULL (with a message on stderr) if the files could not be set up
+ */
+SpillFile* spill_open(void);
+
+/** Unmaps and closes the spill files, which releases them on disk */
+void spill_close(SpillFile* spill);
+
+/**
+ * Appends one packed block
+ * @param data - Packed block bytes
+ * @param size - Number of bytes
+ * @param lines - Number of lines the block holds
+ * @return 1 on success, 0 if the write failed or the reserved mapping is full
+ */
+int spill_append(SpillFile* spill, const uint8_t* data, size_t size, int lines);
+
+/** Number of blocks stored */
+size_t spill_block_count(const SpillFile* spill);
+
+/**
+ * Zero-copy access to a stored block
+ * @param index - Block index, 0 is the oldest
+ * @param size - Receives the packed size
+ * @param lines - Receives the line count
+ * @return Pointer into the mapping, or NULL if index is out of range
+ */
+const uint8_t* spill_block(const SpillFile* spill, size_t index, size_t* size, int* lines);
+
+/** Drops every stored block and gives the disk space back */
+void spill_reset(SpillFile* spill);
+
+#endif // SPILL_H
@@ -0,0 +1,208 @@
+#include "style.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A collection that frees fewer IDs than STYLE_GC_RETRY holds off the next one for a number
+// of new styles that starts at STYLE_GC_RETRY and doubles with every such collection
+#define STYLE_GC_RETRY 4096
+#define STYLE_GC_RETRY_MAX (1u << 24)
+
+// Hash slots hold id + 1 so that 0 marks an empty slot
+struct StyleTable {
+    Style* styles;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t* slots;
+    uint32_t slot_mask;
+    int warned_full;
+
+    // Allocated by the first collection; until then every ID below count is in use
+    uint8_t* marks;           // per ID, nonzero while the ID is in use
+    StyleId* free_ids;        // IDs freed by the last collection, lowest last
+    uint32_t free_count;
+    uint32_t gc_deferred;     // style_gc_due calls left before the next collection
+    uint32_t gc_backoff;      // deferral after the next collection if it frees little
+};
+
+static void* style_alloc(void* ptr, size_t size) {
+    void* p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "Style table could not be allocated");
+        abort();
+    }
+    return p;
+}
+
+static uint32_t style_hash(const Style* s) {
+    uint64_t h = (uint64_t)s->fg * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)s->bg * 0xC2B2AE3D27D4EB4Full;
+    h ^= (uint64_t)s->underline_color * 0x165667B19E3779F9ull;
+    h ^= ((uint64_t)s->attrs << 16 | s->hyperlink) * 0x27D4EB2F165667C5ull;
+    h ^= h >> 29;
+    return (uint32_t)h;
+}
+
+static int id_in_use(const StyleTable* table, uint32_t id) {
+    return !table->marks || table->marks[id];
+}
+
+static void insert_slot(StyleTable* table, uint32_t id) {
+    uint32_t i = style_hash(&table->styles[id]) & table->slot_mask;
+    while (table->slots[i]) i = (i + 1) & table->slot_mask;
+    table->slots[i] = id + 1;
+}
+
+static void rebuild_slots(StyleTable* table, uint32_t size) {
+    free(table->slots);
+    table->slots = calloc(size, sizeof(uint32_t));
+    if (!table->slots) {
+        fprintf(stderr, "Style table could not be allocated");
+        abort();
+    }
+    table->slot_mask = size - 1;
+    for (uint32_t id = 0; id < table->count; id++) {
+        if (id_in_use(table, id)) insert_slot(table, id);
+    }
+}
+
+// Keep the hash at most half full
+static void grow_slots(StyleTable* table) {
+    rebuild_slots(table, (table->slot_mask + 1) * 2);
+}
+
+StyleTable* style_table_create(void) {
+    StyleTable* table = calloc(1, sizeof(StyleTable));
+    if (!table) {
+        fprintf(stderr, "Style table could not be allocated");
+        abort();
+    }
+    table->capacity = 64;
+    table->styles = style_alloc(NULL, sizeof(Style) * table->capacity);
+    table->slot_mask = 63;
+    grow_slots(table);
+
+    Style def = {0};
+    table->styles[0] = def;
+    table->count = 1;
+    insert_slot(table, 0);
+    return table;
+}
+
+void style_table_destroy(StyleTable* table) {
+    if (!table) return;
+    free(table->styles);
+    free(table->slots);
+    free(table->marks);
+    free(table->free_ids);
+    free(table);
+}
+
+// Slot holding the style, or the empty slot where it would be inserted
+static uint32_t find_slot(const StyleTable* table, const Style* style) {
+    uint32_t i = style_hash(style) & table->slot_mask;
+    while (table->slots[i]) {
+        uint32_t id = table->slots[i] - 1;
+        if (memcmp(&table->styles[id], style, sizeof(Style)) == 0) break;
+        i = (i + 1) & table->slot_mask;
+    }
+    return i;
+}
+
+int style_find(const StyleTable* table, const Style* style, StyleId* id) {
+    uint32_t i = find_slot(table, style);
+    if (!table->slots[i]) return 0;
+    *id = (StyleId)(table->slots[i] - 1);
+    return 1;
+}
+
+StyleId style_intern(StyleTable* table, const Style* style) {
+    uint32_t i = find_slot(table, style);
+    if (table->slots[i]) return (StyleId)(table->slots[i] - 1);
+
+    if (table->free_count > 0) {
+        uint32_t id = table->free_ids[--table->free_count];
+        table->marks[id] = 1;
+        table->styles[id] = *style;
+        table->slots[i] = id + 1;
+        return (StyleId)id;
+    }
+
+    if (table->count >= STYLE_MAX_COUNT) {
+        if (!table->warned_full) {
+            fprintf(stderr, "Style table full, new styles fall back to the default\n");
+            table->warned_full = 1;
+        }
+        return STYLE_DEFAULT;
+    }
+
+    if (table->count == table->capacity) {
+        table->capacity *= 2;
+        table->styles = style_alloc(table->styles, sizeof(Style) * table->capacity);
+    }
+    uint32_t id = table->count++;
+    table->styles[id] = *style;
+    if (table->marks) table->marks[id] = 1;
+
+    if (table->count * 2 > table->slot_mask + 1) grow_slots(table);
+    else table->slots[i] = id + 1;
+    return (StyleId)id;
+}
+
+const Style* style_get(const StyleTable* table, StyleId id) {
+    return &table->styles[id < table->count ? id : STYLE_DEFAULT];
+}
+
+uint32_t style_count(const StyleTable* table) {
+    return table->count - table->free_count;
+}
+
+int style_gc_due(StyleTable* table, uint32_t headroom) {
+    if (style_count(table) + headroom <= STYLE_MAX_COUNT) return 0;
+    if (table->gc_deferred > 0) {
+        table->gc_deferred--;
+        return 0;
+    }
+    return 1;
+}
+
+void style_gc_begin(StyleTable* table) {
+    if (!table->marks) {
+        table->marks = malloc(STYLE_MAX_COUNT);
+        table->free_ids = malloc(sizeof(StyleId) * STYLE_MAX_COUNT);
+        if (!table->marks || !table->free_ids) {
+            fprintf(stderr, "Style table could not be allocated");
+            abort();
+        }
+    }
+    memset(table->marks, 0, STYLE_MAX_COUNT);
+    table->marks[STYLE_DEFAULT] = 1;
+}
+
+void style_gc_mark(StyleTable* table, StyleId id) {
+    table->marks[id] = 1;
+}
+
+uint32_t style_gc_end(StyleTable* table) {
+    // Freed styles read back as the default style until their ID is reused
+    Style def = {0};
+    uint32_t previously_free = table->free_count;
+    table->free_count = 0;
+    for (uint32_t id = table->count; id-- > 1; ) {
+        if (table->marks[id]) continue;
+        table->styles[id] = def;
+        table->free_ids[table->free_count++] = (StyleId)id;
+    }
+    rebuild_slots(table, table->slot_mask + 1);
+
+    uint32_t freed = table->free_count - previously_free;
+    if (freed < STYLE_GC_RETRY) {
+        if (table->gc_backoff < STYLE_GC_RETRY) table->gc_backoff = STYLE_GC_RETRY;
+        table->gc_deferred = table->gc_backoff;
+        if (table->gc_backoff < STYLE_GC_RETRY_MAX) table->gc_backoff *= 2;
+    } else {
+        table->gc_deferred = 0;
+        table->gc_backoff = STYLE_GC_RETRY;
+    }
+    return freed;
+}
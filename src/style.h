@@ -0,0 +1,90 @@
+#ifndef STYLE_H
+#define STYLE_H
+
+#include "types.h"
+#include <stdint.h>
+
+/**
+ * Interned cell styles
+ * Every distinct combination of colours and attributes is stored once per terminal and
+ * cells refer to it by a 16-bit ID. ID 0 is always the default style.
+ */
+
+// Style attribute bits
+#define STYLE_BOLD      0x0001u
+#define STYLE_UNDERLINE 0x0002u
+#define STYLE_ITALIC    0x0004u
+#define STYLE_INVERSE   0x0008u
+#define STYLE_DIM       0x0010u
+#define STYLE_BLINK     0x0020u
+#define STYLE_HIDDEN    0x0040u
+#define STYLE_STRIKE    0x0080u
+
+#define STYLE_DEFAULT 0
+#define STYLE_MAX_COUNT 65536
+
+typedef uint16_t StyleId;
+
+/**
+ * Style struct - Everything a cell can carry besides its code point
+ * Has no padding, so two styles are equal exactly when their bytes are.
+ */
+typedef struct {
+    CellColor fg;
+    CellColor bg;
+    CellColor underline_color;  /**< CELL_COLOR_DEFAULT follows fg */
+    uint16_t attrs;             /**< STYLE_* bits */
+    uint16_t hyperlink;         /**< OSC 8 link ID, 0 for none */
+} Style;
+
+typedef struct StyleTable StyleTable;
+
+/**
+ * Creates a table holding only the default style
+ * @return New table, aborts if it could not be allocated
+ */
+StyleTable* style_table_create(void);
+
+void style_table_destroy(StyleTable* table);
+
+/**
+ * ID of a style, adding it to the table if it is new
+ * IDs freed by the last collection are handed out first. Once STYLE_MAX_COUNT styles are in
+ * use new ones fall back to STYLE_DEFAULT.
+ */
+StyleId style_intern(StyleTable* table, const Style* style);
+
+/**
+ * Looks a style up without adding it
+ * @param id - Receives the ID when the style is in the table
+ * @return 1 if the style was found, 0 otherwise
+ */
+int style_find(const StyleTable* table, const Style* style, StyleId* id);
+
+/** Style for an ID returned by style_intern, the default style for unknown IDs */
+const Style* style_get(const StyleTable* table, StyleId id);
+
+/** Number of distinct styles in the table, the default style included */
+uint32_t style_count(const StyleTable* table);
+
+/*
+ * Reclaiming IDs
+ * The table does not know which cells still refer to a style. Its owner calls
+ * style_gc_begin, marks every ID it still stores anywhere and calls style_gc_end, which
+ * frees the unmarked IDs for reuse. No style_intern may happen in between.
+ */
+
+/**
+ * True when fewer than headroom IDs are left and a collection is worth running
+ * After a collection that freed little, the next calls return 0 for a while, longer after
+ * every such collection, so that a table full of live styles is not rescanned over and over.
+ */
+int style_gc_due(StyleTable* table, uint32_t headroom);
+
+void style_gc_begin(StyleTable* table);
+void style_gc_mark(StyleTable* table, StyleId id);
+
+/** @return Number of IDs freed */
+uint32_t style_gc_end(StyleTable* table);
+
+#endif // STYLE_H
@@ -1,8 +1,10 @@
 #include "globals.h"
-#include "renderer.h"
 #include "types.h"
-#include "font.h"
 #include "terminal_logic.h"
+#include "byte_scan.h"
+#include "utf8.h"
+#include "scrollback.h"
+#include "style.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,83 +14,611 @@ void setCursorPosition(Cursor *cursor, int row, int column) {
     cursor ->row = row;
 }
 
-void writeCell(TerminalGrid* grid, int x, int y, uint32_t rune, color3* fg, color3* bg) {
-    grid ->grid[y * grid ->width + x].rune = rune;
-    if(fg) grid ->grid[y * grid ->width + x].fg = *fg;
-    if (bg) grid ->grid[y * grid ->width + x].bg = *bg;
+unsigned int scrollbackLines = 1000;
+unsigned int scrollbackBudgetMB = 64;
+bool scrollbackSpill = false;
+
+static const Cell BLANK_CELL = {.rune = 0, .flags = 0, .style = STYLE_DEFAULT};
+
+// Ring slot holding screen row `row` (negative rows reach back into history)
+static int ring_index(const TerminalGrid* grid, int row) {
+    int idx = (grid->top + row) % grid->capacity;
+    return idx < 0 ? idx + grid->capacity : idx;
+}
+
+static int clamp_int(int v, int lo, int hi) {
+    if (v < lo) return lo;
+    if (v > hi) return hi;
+    return v;
+}
+
+static void fill_blank(Cell* cells, int count) {
+    for (int i = 0; i < count; i++) cells[i] = BLANK_CELL;
+}
+
+static Cell* alloc_cells(int width) {
+    Cell* cells = malloc(sizeof(Cell) * (size_t)width);
+    if (!cells) {
+        fprintf(stderr, "Grid row could not be allocated");
+        abort();
+    }
+    fill_blank(cells, width);
+    return cells;
+}
+
+// Row storage is allocated the first time a slot is used, so an empty scrollback costs nothing.
+// Slots left over from before a resize are brought to the current width on reuse.
+static Row* ring_row(TerminalGrid* grid, int row) {
+    Row* r = &grid->rows[ring_index(grid, row)];
+    if (!r->cells) {
+        r->cells = alloc_cells(grid->width);
+        r->width = grid->width;
+        r->flags = 0;
+    } else if (r->width != grid->width) {
+        Cell* cells = alloc_cells(grid->width);
+        memcpy(cells, r->cells, sizeof(Cell) * (size_t)(r->width < grid->width ? r->width : grid->width));
+        free(r->cells);
+        r->cells = cells;
+        r->width = grid->width;
+    }
+    return r;
+}
+
+static int history_count(const TerminalGrid* grid) {
+    // The compressed tier belongs to the primary screen
+    if (grid->alt_active) return grid->history;
+    return grid->history + (int)scrollback_line_count(grid->cold);
+}
+
+int grid_history_lines(TerminalGrid* grid) {
+    if (grid->reflow_pending) grid_reflow_history(grid);
+    return history_count(grid);
+}
+
+Cell* grid_row(TerminalGrid* grid, int row) {
+    if (row >= grid->height) return NULL;
+    if (row < 0 && grid->reflow_pending) grid_reflow_history(grid);
+    if (row >= -grid->history) return ring_row(grid, row)->cells;
+
+    // Older than the ring: row -history-1 is the newest cold line
+    long cold_index = (long)scrollback_line_count(grid->cold) + row + grid->history;
+    if (cold_index < 0) return NULL;
+    return (Cell*)scrollback_line(grid->cold, (size_t)cold_index, grid->width, NULL);
+}
+
+Cell* grid_view_row(TerminalGrid* grid, int row) {
+    return grid_row(grid, row - grid->view_offset);
+}
+
+void grid_damage_rows(TerminalGrid* grid, int top, int bottom) {
+    if (top < 0) top = 0;
+    if (bottom >= grid->height) bottom = grid->height - 1;
+    for (int row = top; row <= bottom; row++) {
+        if (!grid->dirty[row]) {
+            grid->dirty[row] = 1;
+            grid->dirty_count++;
+        }
+    }
 }
 
-void writeAtCursor(TerminalGrid* grid, char rune, color3* fg, color3* bg) {
-    if (!grid) return;
+void grid_damage_all(TerminalGrid* grid) {
+    memset(grid->dirty, 1, (size_t)grid->height);
+    grid->dirty_count = grid->height;
+}
+
+int grid_take_damage(TerminalGrid* grid, uint8_t* rows) {
+    int count = grid->dirty_count;
+    if (rows) memcpy(rows, grid->dirty, (size_t)grid->height);
+    if (count > 0) {
+        memset(grid->dirty, 0, (size_t)grid->height);
+        grid->dirty_count = 0;
+    }
+    return count;
+}
 
-    int x = grid ->cursor.col;
-    int y = grid ->cursor.row;
+static void blank_row(TerminalGrid* grid, int row) {
+    Row* r = ring_row(grid, row);
+    fill_blank(r->cells, grid->width);
+    r->flags = 0;
+    grid_damage_rows(grid, row, row);
+}
 
-    if (x < 0 || x >= grid ->width) return;
-    if (y < 0 || y >= grid ->height) return;
+void grid_scroll_up(TerminalGrid* grid, int top, int bottom, int count, int to_history) {
+    if (top < 0 || bottom >= grid->height || top > bottom) return;
+    if (count > bottom - top + 1) count = bottom - top + 1;
 
-    Cell* c = &grid ->grid[y * grid->width + x];
+    if (to_history && top == 0 && bottom == grid->height - 1) {
+        // Full screen: screen row 0 becomes the newest history line and the slot
+        // after the screen (free, or the oldest history line) becomes the new bottom row
+        for (int i = 0; i < count; i++) {
+            grid->top = ring_index(grid, 1);
+            if (!grid->alt_active) grid->scrolled_lines++;
+            if (grid->history < grid->capacity - grid->height) {
+                grid->history++;
+            } else if (grid->cold && !grid->alt_active) {
+                // The ring is full: its oldest line is copied to the compressed tier and its
+                // buffer becomes the new bottom row
+                Row* oldest = &grid->rows[ring_index(grid, grid->height - 1)];
+                if (oldest->cells) scrollback_push(grid->cold, oldest->cells, oldest->width, oldest->flags);
+            }
+            // Keep the lines being looked at in place while output continues
+            int total = history_count(grid);
+            if (grid->view_offset > 0 && grid->view_offset < total) grid->view_offset++;
+            else if (grid->view_offset > total) grid->view_offset = total;
+            blank_row(grid, grid->height - 1);
+        }
+        grid_damage_all(grid);
+        return;
+    }
 
-    c ->rune = rune;
-    if (fg) c->fg = *fg;
-    if (bg) c->bg = *bg;
+    // Scroll region, or lines that are discarded: rotate the row handles, the cells themselves never move
+    for (int i = 0; i < count; i++) {
+        Row saved = grid->rows[ring_index(grid, top)];
+        for (int r = top; r < bottom; r++) {
+            grid->rows[ring_index(grid, r)] = grid->rows[ring_index(grid, r + 1)];
+        }
+        grid->rows[ring_index(grid, bottom)] = saved;
+        blank_row(grid, bottom);
+    }
+    grid_damage_rows(grid, top, bottom);
 }
 
-TerminalGrid createTerminalGrid(void) {
-    int largestWidth = 1;
-    int largestHeight = 1;
+void grid_scroll_down(TerminalGrid* grid, int top, int bottom, int count) {
+    if (top < 0 || bottom >= grid->height || top > bottom) return;
+    if (count > bottom - top + 1) count = bottom - top + 1;
 
-    Cursor newCursor = {0, 0};
+    for (int i = 0; i < count; i++) {
+        Row saved = grid->rows[ring_index(grid, bottom)];
+        for (int r = bottom; r > top; r--) {
+            grid->rows[ring_index(grid, r)] = grid->rows[ring_index(grid, r - 1)];
+        }
+        grid->rows[ring_index(grid, top)] = saved;
+        blank_row(grid, top);
+    }
+    grid_damage_rows(grid, top, bottom);
+}
 
-    for (int i = 0; i < 128; i++) {
-        if (Characters[i].Width > largestWidth) {largestWidth = Characters[i].Width;}
-        if (Characters[i].Height > largestHeight) {largestHeight = Characters[i].Height;}
-    } // If array size for characters changes this needs to change too
+void grid_scroll_view(TerminalGrid* grid, int lines) {
+    // History is only rewrapped after a resize once somebody actually looks at it
+    if (grid->view_offset + lines > 0 && grid->reflow_pending) grid_reflow_history(grid);
 
-    int numOfHoriCells = bufferScreenWidth/largestWidth;
-    int numOfVertCells = bufferScreenHeight/largestHeight;
+    int offset = grid->view_offset + lines;
+    if (offset < 0) offset = 0;
+    if (offset > grid_history_lines(grid)) offset = grid_history_lines(grid);
+    if (offset != grid->view_offset) grid_damage_all(grid);
+    grid->view_offset = offset;
+}
 
-    TerminalGrid newGrid;
+void grid_clear_history(TerminalGrid* grid) {
+    grid->history = 0;
+    grid->history_epoch++;
+    if (grid->view_offset != 0) grid_damage_all(grid);
+    grid->view_offset = 0;
+    scrollback_clear(grid->cold);
+}
 
+void writeCell(TerminalGrid* grid, int x, int y, Cell cell) {
+    if (x < 0 || x >= grid->width || y < 0 || y >= grid->height) return;
+    grid_row(grid, y)[x] = cell;
+    grid_damage_rows(grid, y, y);
+}
+
+TerminalGrid createTerminalGridSized(int cols, int rows, int scrollback) {
+    TerminalGrid newGrid = {0};
+
+    if (cols < 1) cols = 1;
+    if (rows < 1) rows = 1;
+    if (scrollback < 0) scrollback = 0;
 
-    newGrid.cursor = newCursor;
-    newGrid.height = numOfVertCells;
-    newGrid.width = numOfHoriCells;
-    newGrid.grid = malloc(sizeof(Cell) * numOfHoriCells * numOfVertCells);
+    newGrid.width = cols;
+    newGrid.height = rows;
+    newGrid.capacity = rows + scrollback;
+    newGrid.scroll_top = 0;
+    newGrid.scroll_bottom = rows - 1;
+    newGrid.rows = calloc((size_t)newGrid.capacity, sizeof(Row));
 
-    if (!newGrid.grid) {
+    if (!newGrid.rows) {
         fprintf(stderr, "Grid array could not be allocated");
         abort();
     }
 
-    for (int y = 0; y < numOfVertCells; y++) {
-        for (int x = 0; x < numOfHoriCells; x++) {
-            setCursorPosition(&newGrid.cursor, x, y);            
-            writeAtCursor(&newGrid, ' ', &COLOR_WHITE, &COLOR_BLACK);
-        }
+    newGrid.dirty = malloc((size_t)rows);
+    if (!newGrid.dirty) {
+        fprintf(stderr, "Grid damage flags could not be allocated");
+        abort();
     }
+    grid_damage_all(&newGrid);
+
+    for (int y = 0; y < rows; y++) ring_row(&newGrid, y);
+    newGrid.styles = style_table_create();
+
+    return newGrid;
+}
+
+TerminalGrid createTerminalGrid(int cols, int rows) {
+    TerminalGrid newGrid = createTerminalGridSized(cols, rows, (int)scrollbackLines);
+    if (scrollbackBudgetMB > 0) newGrid.cold = scrollback_create((size_t)scrollbackBudgetMB << 20);
 
     return newGrid;
 }
 
+static void free_surface(GridSurface* surface) {
+    if (!surface->rows) return;
+    for (int i = 0; i < surface->capacity; i++) free(surface->rows[i].cells);
+    free(surface->rows);
+    surface->rows = NULL;
+}
+
 void freeGrid(TerminalGrid* grid) {
-    if (!grid) return;
+    if (!grid || !grid->rows) return;
 
-    free(grid ->grid);
-    grid ->grid = NULL;
+    for (int i = 0; i < grid->capacity; i++) free(grid->rows[i].cells);
+    free(grid->rows);
+    grid->rows = NULL;
+    free_surface(&grid->inactive);
+    free(grid->dirty);
+    grid->dirty = NULL;
+    scrollback_destroy(grid->cold);
+    grid->cold = NULL;
+    style_table_destroy(grid->styles);
+    grid->styles = NULL;
 }
 
-void clear_screen(TerminalGrid* grid) {
-    if (!grid || !grid->grid) return;
-    for (int i = 0; i < grid->width * grid->height; i++) {
-        grid->grid[i].rune = 0;
-        grid->grid[i].fg = (color3){1.0f, 1.0f, 1.0f};
-        grid->grid[i].bg = (color3){0.0f, 0.0f, 0.0f};
-        grid->grid[i].flags = 0;
+/*
+ * Resize and reflow
+ *
+ * Auto-wrapped rows carry ROW_WRAPPED, so the rows of one logical line can be joined and
+ * cut again at the new width. The screen is reflowed as soon as the size changes; the ring
+ * history keeps its old rows until it is first looked at (grid_reflow_history). Lines in
+ * the compressed tier are never rewrapped, they are clipped or padded when read.
+ */
+
+typedef struct {
+    Row* rows;
+    int count;
+    int capacity;
+} RowList;
+
+static void row_list_push(RowList* list, Row row) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        Row* rows = realloc(list->rows, sizeof(Row) * (size_t)capacity);
+        if (!rows) {
+            fprintf(stderr, "Reflow rows could not be allocated");
+            abort();
+        }
+        list->rows = rows;
+        list->capacity = capacity;
+    }
+    list->rows[list->count++] = row;
+}
+
+static int cell_is_blank(const Cell* c) {
+    return c->rune == 0 && c->style == STYLE_DEFAULT;
+}
+
+// Cells up to and including the last non-blank one
+static int row_content_length(const Row* r) {
+    if (!r->cells) return 0;
+    int len = r->width;
+    while (len > 0 && cell_is_blank(&r->cells[len - 1])) len--;
+    return len;
+}
+
+// Rewrap the logical lines in src to `width` columns, appending the new rows to out.
+// When cursor_row is inside src the cursor is carried along into *new_row / *new_col
+// (a row index into out). Source cells are left untouched.
+static void reflow_rows(const Row* src, int count, int width, RowList* out,
+                        int cursor_row, int cursor_col, int* new_row, int* new_col) {
+    // Trailing blanks are dropped from every row, wrapped or not: a wrapped row is only
+    // partly filled when its line was cut by an earlier reflow at the history boundary
+    int* lens = malloc(sizeof(int) * (size_t)(count > 0 ? count : 1));
+    if (!lens) {
+        fprintf(stderr, "Reflow rows could not be allocated");
+        abort();
+    }
+    for (int k = 0; k < count; k++) lens[k] = row_content_length(&src[k]);
+
+    int i = 0;
+    while (i < count) {
+        int last = i;
+        while (last < count - 1 && (src[last].flags & ROW_WRAPPED)) last++;
+
+        long len = 0;
+        for (int k = i; k <= last; k++) len += lens[k];
+
+        long cursor_offset = -1;
+        if (cursor_row >= i && cursor_row <= last) {
+            cursor_offset = cursor_col;
+            for (int k = i; k < cursor_row; k++) cursor_offset += lens[k];
+        }
+
+        long rows_needed = len > 0 ? (len + width - 1) / width : 1;
+        int first_out = out->count;
+        if (cursor_offset >= 0) {
+            // A cursor sitting right after the last cell keeps its pending wrap instead of
+            // opening a new row
+            long crow = cursor_offset / width;
+            if (cursor_offset > 0 && cursor_offset >= len && cursor_offset % width == 0) crow--;
+            if (crow + 1 > rows_needed) rows_needed = crow + 1;
+            *new_row = first_out + (int)crow;
+            *new_col = (int)(cursor_offset - crow * width);
+        }
+
+        int src_row = i, src_col = 0;
+        long copied = 0;
+        for (long r = 0; r < rows_needed; r++) {
+            Row row = {alloc_cells(width), width, 0};
+            for (int c = 0; c < width && copied < len; c++, copied++) {
+                while (src_col >= lens[src_row]) {
+                    src_row++;
+                    src_col = 0;
+                }
+                row.cells[c] = src[src_row].cells[src_col];
+                src_col++;
+            }
+            if (r < rows_needed - 1) row.flags = ROW_WRAPPED;
+            else row.flags = src[last].flags;
+            row_list_push(out, row);
+        }
+        i = last + 1;
+    }
+    free(lens);
+}
+
+static void free_row_cells(Row* rows, int count) {
+    for (int i = 0; i < count; i++) {
+        free(rows[i].cells);
+        rows[i].cells = NULL;
+    }
+}
+
+// Lay out history + screen rows into a fresh ring. History beyond the scrollback limit moves
+// to the compressed tier (or is dropped without one). Takes ownership of every row.
+static void rebuild_ring(TerminalGrid* grid, Row* history, int history_count, Row* screen, int screen_count) {
+    int limit = grid->capacity - grid->height;
+    int skip = history_count > limit ? history_count - limit : 0;
+    for (int i = 0; i < skip; i++) {
+        if (grid->cold && history[i].cells) {
+            scrollback_push(grid->cold, history[i].cells, history[i].width, history[i].flags);
+        }
+        free(history[i].cells);
+    }
+    history_count -= skip;
+
+    Row* rows = calloc((size_t)grid->capacity, sizeof(Row));
+    if (!rows) {
+        fprintf(stderr, "Grid array could not be allocated");
+        abort();
+    }
+    // history is NULL when there is none, and memcpy must not see NULL even for 0 bytes
+    if (history_count > 0) memcpy(rows, history + skip, sizeof(Row) * (size_t)history_count);
+    if (screen_count > 0) memcpy(rows + history_count, screen, sizeof(Row) * (size_t)screen_count);
+
+    free(grid->rows);
+    grid->rows = rows;
+    grid->history = history_count;
+    grid->top = history_count % grid->capacity;
+}
+
+// Ring history rows, oldest first; the ring keeps ownership
+static Row* collect_history(const TerminalGrid* grid) {
+    Row* history = malloc(sizeof(Row) * (size_t)(grid->history > 0 ? grid->history : 1));
+    if (!history) {
+        fprintf(stderr, "Reflow rows could not be allocated");
+        abort();
     }
+    for (int i = 0; i < grid->history; i++) history[i] = grid->rows[ring_index(grid, i - grid->history)];
+    return history;
 }
 
-static color3 ansi_colors[8] = {
+void grid_reflow_history(TerminalGrid* grid) {
+    if (!grid->reflow_pending) return;
+    grid->reflow_pending = 0;
+    grid->history_epoch++;
+
+    Row* history = collect_history(grid);
+    Row* screen = malloc(sizeof(Row) * (size_t)grid->height);
+    if (!screen) {
+        fprintf(stderr, "Reflow rows could not be allocated");
+        abort();
+    }
+    for (int i = 0; i < grid->height; i++) screen[i] = *ring_row(grid, i);
+
+    RowList out = {0};
+    int unused_row, unused_col;
+    reflow_rows(history, grid->history, grid->width, &out, -1, 0, &unused_row, &unused_col);
+
+    // Free slots above the history are not carried over
+    for (int i = 0; i < grid->capacity - grid->height - grid->history; i++) {
+        free(grid->rows[ring_index(grid, grid->height + i)].cells);
+    }
+    free_row_cells(history, grid->history);
+    free(history);
+
+    int old_history = grid->history;
+    rebuild_ring(grid, out.rows, out.count, screen, grid->height);
+    free(out.rows);
+    free(screen);
+
+    // Keep the viewport on roughly the same content
+    if (grid->view_offset > 0 && old_history > 0) {
+        grid->view_offset = (int)((long)grid->view_offset * grid->history / old_history);
+    }
+    if (grid->view_offset > history_count(grid)) grid->view_offset = history_count(grid);
+    grid_damage_all(grid);
+}
+
+// Exchange the active ring with the parked surface; only the handles move, never cells
+static void swap_surface(TerminalGrid* grid) {
+    GridSurface active = {grid->rows, grid->capacity, grid->top, grid->history, grid->reflow_pending};
+    grid->rows = grid->inactive.rows;
+    grid->capacity = grid->inactive.capacity;
+    grid->top = grid->inactive.top;
+    grid->history = grid->inactive.history;
+    grid->reflow_pending = grid->inactive.reflow_pending;
+    grid->inactive = active;
+    grid->alt_active = !grid->alt_active;
+}
+
+void grid_set_alternate_screen(TerminalGrid* grid, int enable) {
+    enable = enable != 0;
+    if (enable == grid->alt_active) return;
+
+    if (enable && !grid->inactive.rows) {
+        // First use: a plain screen-sized ring, kept for every later switch
+        grid->inactive.rows = calloc((size_t)grid->height, sizeof(Row));
+        if (!grid->inactive.rows) {
+            fprintf(stderr, "Alternate screen could not be allocated");
+            abort();
+        }
+        grid->inactive.capacity = grid->height;
+        grid->inactive.top = 0;
+        grid->inactive.history = 0;
+        grid->inactive.reflow_pending = 0;
+    }
+
+    swap_surface(grid);
+    grid->history_epoch++;
+    grid->view_offset = 0;
+    grid_damage_all(grid);
+}
+
+static void resize_surface(TerminalGrid* grid, ParserState* state, int cols, int rows) {
+    int cursor_row = clamp_int(state->cursor_row, 0, grid->height - 1);
+    int cursor_col = clamp_int(state->cursor_col, 0, grid->width);
+
+    Row* screen = malloc(sizeof(Row) * (size_t)grid->height);
+    if (!screen) {
+        fprintf(stderr, "Reflow rows could not be allocated");
+        abort();
+    }
+    for (int i = 0; i < grid->height; i++) screen[i] = *ring_row(grid, i);
+
+    // Blank rows below the cursor would only push real content into history when shrinking
+    int used = grid->height;
+    while (used > cursor_row + 1 && row_content_length(&screen[used - 1]) == 0) used--;
+
+    RowList out = {0};
+    int new_row = 0, new_col = 0;
+    if (cols == grid->width) {
+        // Height change only: the rows can be moved over as they are
+        for (int i = 0; i < used; i++) {
+            row_list_push(&out, screen[i]);
+            screen[i].cells = NULL;
+        }
+        new_row = cursor_row;
+        new_col = cursor_col;
+    } else {
+        reflow_rows(screen, used, cols, &out, cursor_row, cursor_col, &new_row, &new_col);
+    }
+
+    Row* history = collect_history(grid);
+    int history_count = grid->history;
+    int reflow_pending = grid->reflow_pending || (history_count > 0 && cols != grid->width);
+
+    // Everything that is neither history nor screen is a free slot
+    for (int i = 0; i < grid->capacity - grid->height - grid->history; i++) {
+        free(grid->rows[ring_index(grid, grid->height + i)].cells);
+    }
+    free_row_cells(screen, grid->height);
+    free(screen);
+
+    // Reflowed rows that no longer fit above the cursor become history
+    int overflow = out.count > rows ? out.count - rows : 0;
+    if (new_row - overflow < 0) overflow = new_row;
+    grid->scrolled_lines += (uint64_t)overflow;
+    grid->history_epoch++;
+    Row* combined = malloc(sizeof(Row) * (size_t)(history_count + overflow + 1));
+    if (!combined) {
+        fprintf(stderr, "Reflow rows could not be allocated");
+        abort();
+    }
+    memcpy(combined, history, sizeof(Row) * (size_t)history_count);
+    memcpy(combined + history_count, out.rows, sizeof(Row) * (size_t)overflow);
+    free(history);
+
+    // Rows past the new bottom (only possible below the cursor) are dropped
+    int screen_count = out.count - overflow;
+    if (screen_count > rows) {
+        free_row_cells(out.rows + overflow + rows, screen_count - rows);
+        screen_count = rows;
+    }
+
+    int scrollback = grid->capacity - grid->height;
+    grid->width = cols;
+    grid->height = rows;
+    grid->capacity = rows + scrollback;
+    rebuild_ring(grid, combined, history_count + overflow, out.rows + overflow, screen_count);
+    grid->reflow_pending = reflow_pending;
+    free(combined);
+    free(out.rows);
+
+    uint8_t* dirty = realloc(grid->dirty, (size_t)rows);
+    if (!dirty) {
+        fprintf(stderr, "Grid damage flags could not be allocated");
+        abort();
+    }
+    grid->dirty = dirty;
+    grid_damage_all(grid);
+
+    grid->scroll_top = 0;
+    grid->scroll_bottom = rows - 1;
+    grid->view_offset = 0;
+
+    state->cursor_row = clamp_int(new_row - overflow, 0, rows - 1);
+    state->cursor_col = clamp_int(new_col, 0, cols);
+    grid->cursor.row = state->cursor_row;
+    grid->cursor.col = state->cursor_col;
+}
+
+void grid_resize(TerminalGrid* grid, ParserState* state, int cols, int rows) {
+    if (cols < 1) cols = 1;
+    if (rows < 1) rows = 1;
+    if (cols == grid->width && rows == grid->height) return;
+
+    if (!grid->alt_active) {
+        // The parked alternate screen is simply reallocated at the new size on its next use
+        free_surface(&grid->inactive);
+        resize_surface(grid, state, cols, rows);
+        return;
+    }
+
+    // Alternate screen active: reflow the parked primary around the cursor it returns to
+    swap_surface(grid);
+    ParserState primary = *state;
+    primary.cursor_row = state->saved_cursor[0].row;
+    primary.cursor_col = state->saved_cursor[0].col;
+    resize_surface(grid, &primary, cols, rows);
+    state->saved_cursor[0].row = primary.cursor_row;
+    state->saved_cursor[0].col = primary.cursor_col;
+    swap_surface(grid);
+
+    // Full screen applications redraw on SIGWINCH, so the alternate screen starts out blank
+    for (int i = 0; i < grid->capacity; i++) free(grid->rows[i].cells);
+    free(grid->rows);
+    grid->rows = calloc((size_t)rows, sizeof(Row));
+    if (!grid->rows) {
+        fprintf(stderr, "Alternate screen could not be allocated");
+        abort();
+    }
+    grid->capacity = rows;
+    grid->top = 0;
+    grid->history = 0;
+    grid->reflow_pending = 0;
+
+    state->cursor_row = clamp_int(state->cursor_row, 0, rows - 1);
+    state->cursor_col = clamp_int(state->cursor_col, 0, cols);
+    grid->cursor.row = state->cursor_row;
+    grid->cursor.col = state->cursor_col;
+}
+
+void clear_screen(TerminalGrid* grid) {
+    if (!grid || !grid->rows) return;
+    for (int row = 0; row < grid->height; row++) blank_row(grid, row);
+}
+
+static color3 ansi_colors[16] = {
     {0.0f, 0.0f, 0.0f},
     {1.0f, 0.0f, 0.0f},
     {0.0f, 1.0f, 0.0f},
@@ -97,158 +627,836 @@ static color3 ansi_colors[8] = {
     {1.0f, 0.0f, 1.0f},
     {0.0f, 1.0f, 1.0f},
     {1.0f, 1.0f, 1.0f},
+    // Bright variants (SGR 90-97 / 100-107)
+    {0.5f, 0.5f, 0.5f},
+    {1.0f, 0.33f, 0.33f},
+    {0.33f, 1.0f, 0.33f},
+    {1.0f, 1.0f, 0.33f},
+    {0.36f, 0.36f, 1.0f},
+    {1.0f, 0.33f, 1.0f},
+    {0.33f, 1.0f, 1.0f},
+    {1.0f, 1.0f, 1.0f},
 };
 
+// xterm 256 color palette: the 16 ANSI colors, a 6x6x6 cube and a 24 step gray ramp
+static color3 palette[256];
+static int palette_ready = 0;
+
+static void build_palette(void) {
+    static const float cube_levels[6] = {0.0f, 95 / 255.0f, 135 / 255.0f, 175 / 255.0f, 215 / 255.0f, 1.0f};
+
+    for (int i = 0; i < 16; i++) palette[i] = ansi_colors[i];
+    for (int i = 0; i < 216; i++) {
+        color3 c = {cube_levels[i / 36], cube_levels[(i / 6) % 6], cube_levels[i % 6]};
+        palette[16 + i] = c;
+    }
+    for (int i = 0; i < 24; i++) {
+        float level = (8 + 10 * i) / 255.0f;
+        color3 c = {level, level, level};
+        palette[232 + i] = c;
+    }
+    palette_ready = 1;
+}
+
 color3 get_color_from_code(int color_code) {
-    if (color_code >= 0 && color_code < 8) return ansi_colors[color_code];
-    return ansi_colors[7];
-}
-
-// Decode UTF-8 sequence starting at buf[pos], return codepoint and bytes consumed
-static int decode_utf8(const char* buf, size_t len, size_t pos, uint32_t* codepoint) {
-    if (pos >= len) return 0;
-    unsigned char c = (unsigned char)buf[pos];
-    
-    // Single byte (ASCII)
-    if ((c & 0x80) == 0) {
-        *codepoint = c;
-        return 1;
-    }
-    // 2-byte sequence
-    if ((c & 0xE0) == 0xC0) {
-        if (pos + 1 >= len) return 0;
-        unsigned char c1 = (unsigned char)buf[pos + 1];
-        *codepoint = ((c & 0x1F) << 6) | (c1 & 0x3F);
-        return 2;
-    }
-    // 3-byte sequence
-    if ((c & 0xF0) == 0xE0) {
-        if (pos + 2 >= len) return 0;
-        unsigned char c1 = (unsigned char)buf[pos + 1];
-        unsigned char c2 = (unsigned char)buf[pos + 2];
-        *codepoint = ((c & 0x0F) << 12) | ((c1 & 0x3F) << 6) | (c2 & 0x3F);
-        return 3;
-    }
-    // 4-byte sequence
-    if ((c & 0xF8) == 0xF0) {
-        if (pos + 3 >= len) return 0;
-        unsigned char c1 = (unsigned char)buf[pos + 1];
-        unsigned char c2 = (unsigned char)buf[pos + 2];
-        unsigned char c3 = (unsigned char)buf[pos + 3];
-        *codepoint = ((c & 0x07) << 18) | ((c1 & 0x3F) << 12) | 
-                     ((c2 & 0x3F) << 6) | (c3 & 0x3F);
-        return 4;
-    }
-    // Invalid sequence, treat as single byte
-    *codepoint = c;
-    return 1;
-}
-
-int parse_escape_sequence(const char* raw, size_t len, ParserState* state) {
-    if (len < 2 || raw[0] != 27 || raw[1] != '[') return 0;
-    const char* p = raw + 2;
-    int param1 = 0, param2 = 0;
-    char final_byte = '\0';
-
-    while ((size_t)(p - raw) < len && *p && !(*p >= '@' && *p <= '~')) {
-        if (*p >= '0' && *p <= '9') {
-            param1 = param1 * 10 + (*p - '0');
-        } else if (*p == ';') {
-            param2 = param1;
-            param1 = 0;
-        }
-        p++;
-    }
-    if ((size_t)(p - raw) < len) {
-        final_byte = *p;
-        p++;
-    }
-
-    switch (final_byte) {
-        case 'H':
-        case 'f':
-            // CSI row;col H  (row is first parameter)
-            state->cursor_row = (param1 > 0) ? param1 - 1 : 0;
-            state->cursor_col = (param2 > 0) ? param2 - 1 : 0;
-            break;
-        case 'A':
-            state->cursor_row -= (param1 > 0) ? param1 : 1;
-            if (state->cursor_row < 0) state->cursor_row = 0;
-            break;
-        case 'B':
-            state->cursor_row += (param1 > 0) ? param1 : 1;
-            break;
-        case 'C':
-            state->cursor_col += (param1 > 0) ? param1 : 1;
-            break;
-        case 'D':
-            state->cursor_col -= (param1 > 0) ? param1 : 1;
-            if (state->cursor_col < 0) state->cursor_col = 0;
-            break;
-        case 'J':
-            // Clear display: 0=cursor to end, 1=start to cursor, 2=entire screen
-            // For now, treat all as clear entire screen (most common with 'clear' command)
-            // Store this in state so process_output_bytes can handle it
-            state->fg_color = -2; // Use -2 as a signal to clear screen
-            break;
-        case 'm':
-            if (param1 == 0) {
-                state->fg_color = -1;
-                state->bg_color = -1;
-                state->bold = 0;
-                state->underline = 0;
-            } else if (param1 >= 30 && param1 <= 37) {
-                state->fg_color = param1 - 30;
-            } else if (param1 >= 40 && param1 <= 47) {
-                state->bg_color = param1 - 40;
-            } else if (param1 == 1) {
-                state->bold = 1;
-            } else if (param1 == 4) {
-                state->underline = 1;
+    if (!palette_ready) build_palette();
+    if (color_code >= 0 && color_code < 256) return palette[color_code];
+    return palette[7];
+}
+
+color3 resolve_cell_color(CellColor color, color3 default_color) {
+    if (color & CELL_COLOR_RGB) {
+        color3 rgb = {
+            ((color >> 16) & 0xFF) / 255.0f,
+            ((color >> 8) & 0xFF) / 255.0f,
+            (color & 0xFF) / 255.0f,
+        };
+        return rgb;
+    }
+    if (color & CELL_COLOR_INDEXED) return get_color_from_code((int)(color & 0xFF));
+    return default_color;
+}
+
+/*
+ * VT parser
+ *
+ * Table driven DEC/ECMA-48 state machine. Every (state, byte) pair maps to one
+ * packed entry: the low nibble is the next state (or VT_STAY), the high nibble
+ * is the action to perform. Entry/exit actions are looked up per state, so the
+ * hot loop never branches on which state it is in.
+ */
+
+typedef enum {
+    VT_ACTION_NONE = 0,
+    VT_ACTION_PRINT,
+    VT_ACTION_EXECUTE,
+    VT_ACTION_CLEAR,
+    VT_ACTION_COLLECT,
+    VT_ACTION_PARAM,
+    VT_ACTION_ESC_DISPATCH,
+    VT_ACTION_CSI_DISPATCH,
+    VT_ACTION_HOOK,
+    VT_ACTION_PUT,
+    VT_ACTION_UNHOOK,
+    VT_ACTION_OSC_START,
+    VT_ACTION_OSC_PUT,
+    VT_ACTION_OSC_END,
+    VT_ACTION_IGNORE,
+} VtAction;
+
+#define VT_STAY 0x0F
+#define VT_ENTRY(action, next) ((uint8_t)(((action) << 4) | (next)))
+
+static uint8_t vt_table[VT_STATE_COUNT][256];
+static int vt_tables_ready = 0;
+
+static const uint8_t vt_entry_action[VT_STATE_COUNT] = {
+    [VT_STATE_ESCAPE] = VT_ACTION_CLEAR,
+    [VT_STATE_CSI_ENTRY] = VT_ACTION_CLEAR,
+    [VT_STATE_DCS_ENTRY] = VT_ACTION_CLEAR,
+    [VT_STATE_DCS_PASSTHROUGH] = VT_ACTION_HOOK,
+    [VT_STATE_OSC_STRING] = VT_ACTION_OSC_START,
+};
+
+static const uint8_t vt_exit_action[VT_STATE_COUNT] = {
+    [VT_STATE_DCS_PASSTHROUGH] = VT_ACTION_UNHOOK,
+    [VT_STATE_OSC_STRING] = VT_ACTION_OSC_END,
+};
+
+static void vt_range(int state, int lo, int hi, VtAction action, int next) {
+    for (int b = lo; b <= hi; b++) vt_table[state][b] = VT_ENTRY(action, next);
+}
+
+// C0 controls other than CAN, SUB and ESC, which are handled as "anywhere" transitions
+static void vt_c0(int state, VtAction action) {
+    vt_range(state, 0x00, 0x17, action, VT_STAY);
+    vt_range(state, 0x19, 0x19, action, VT_STAY);
+    vt_range(state, 0x1C, 0x1F, action, VT_STAY);
+}
+
+static void vt_build_tables(void) {
+    for (int s = 0; s < VT_STATE_COUNT; s++) {
+        vt_range(s, 0x00, 0xFF, VT_ACTION_IGNORE, VT_STAY);
+    }
+
+    // Ground: printable ASCII and every high byte feed the UTF-8 printer
+    vt_c0(VT_STATE_GROUND, VT_ACTION_EXECUTE);
+    vt_range(VT_STATE_GROUND, 0x20, 0x7E, VT_ACTION_PRINT, VT_STAY);
+    vt_range(VT_STATE_GROUND, 0x80, 0xFF, VT_ACTION_PRINT, VT_STAY);
+
+    vt_c0(VT_STATE_ESCAPE, VT_ACTION_EXECUTE);
+    vt_range(VT_STATE_ESCAPE, 0x20, 0x2F, VT_ACTION_COLLECT, VT_STATE_ESCAPE_INTERMEDIATE);
+    vt_range(VT_STATE_ESCAPE, 0x30, 0x7E, VT_ACTION_ESC_DISPATCH, VT_STATE_GROUND);
+    vt_range(VT_STATE_ESCAPE, 'P', 'P', VT_ACTION_NONE, VT_STATE_DCS_ENTRY);
+    vt_range(VT_STATE_ESCAPE, 'X', 'X', VT_ACTION_NONE, VT_STATE_SOS_PM_APC_STRING);
+    vt_range(VT_STATE_ESCAPE, '^', '_', VT_ACTION_NONE, VT_STATE_SOS_PM_APC_STRING);
+    vt_range(VT_STATE_ESCAPE, '[', '[', VT_ACTION_NONE, VT_STATE_CSI_ENTRY);
+    vt_range(VT_STATE_ESCAPE, ']', ']', VT_ACTION_NONE, VT_STATE_OSC_STRING);
+
+    vt_c0(VT_STATE_ESCAPE_INTERMEDIATE, VT_ACTION_EXECUTE);
+    vt_range(VT_STATE_ESCAPE_INTERMEDIATE, 0x20, 0x2F, VT_ACTION_COLLECT, VT_STAY);
+    vt_range(VT_STATE_ESCAPE_INTERMEDIATE, 0x30, 0x7E, VT_ACTION_ESC_DISPATCH, VT_STATE_GROUND);
+
+    vt_c0(VT_STATE_CSI_ENTRY, VT_ACTION_EXECUTE);
+    vt_range(VT_STATE_CSI_ENTRY, 0x20, 0x2F, VT_ACTION_COLLECT, VT_STATE_CSI_INTERMEDIATE);
+    vt_range(VT_STATE_CSI_ENTRY, 0x30, 0x39, VT_ACTION_PARAM, VT_STATE_CSI_PARAM);
+    vt_range(VT_STATE_CSI_ENTRY, 0x3A, 0x3A, VT_ACTION_PARAM, VT_STATE_CSI_PARAM);
+    vt_range(VT_STATE_CSI_ENTRY, 0x3B, 0x3B, VT_ACTION_PARAM, VT_STATE_CSI_PARAM);
+    vt_range(VT_STATE_CSI_ENTRY, 0x3C, 0x3F, VT_ACTION_COLLECT, VT_STATE_CSI_PARAM);
+    vt_range(VT_STATE_CSI_ENTRY, 0x40, 0x7E, VT_ACTION_CSI_DISPATCH, VT_STATE_GROUND);
+
+    vt_c0(VT_STATE_CSI_PARAM, VT_ACTION_EXECUTE);
+    vt_range(VT_STATE_CSI_PARAM, 0x20, 0x2F, VT_ACTION_COLLECT, VT_STATE_CSI_INTERMEDIATE);
+    vt_range(VT_STATE_CSI_PARAM, 0x30, 0x39, VT_ACTION_PARAM, VT_STAY);
+    vt_range(VT_STATE_CSI_PARAM, 0x3A, 0x3A, VT_ACTION_PARAM, VT_STAY);
+    vt_range(VT_STATE_CSI_PARAM, 0x3B, 0x3B, VT_ACTION_PARAM, VT_STAY);
+    vt_range(VT_STATE_CSI_PARAM, 0x3C, 0x3F, VT_ACTION_NONE, VT_STATE_CSI_IGNORE);
+    vt_range(VT_STATE_CSI_PARAM, 0x40, 0x7E, VT_ACTION_CSI_DISPATCH, VT_STATE_GROUND);
+
+    vt_c0(VT_STATE_CSI_INTERMEDIATE, VT_ACTION_EXECUTE);
+    vt_range(VT_STATE_CSI_INTERMEDIATE, 0x20, 0x2F, VT_ACTION_COLLECT, VT_STAY);
+    vt_range(VT_STATE_CSI_INTERMEDIATE, 0x30, 0x3F, VT_ACTION_NONE, VT_STATE_CSI_IGNORE);
+    vt_range(VT_STATE_CSI_INTERMEDIATE, 0x40, 0x7E, VT_ACTION_CSI_DISPATCH, VT_STATE_GROUND);
+
+    vt_c0(VT_STATE_CSI_IGNORE, VT_ACTION_EXECUTE);
+    vt_range(VT_STATE_CSI_IGNORE, 0x40, 0x7E, VT_ACTION_NONE, VT_STATE_GROUND);
+
+    vt_range(VT_STATE_DCS_ENTRY, 0x20, 0x2F, VT_ACTION_COLLECT, VT_STATE_DCS_INTERMEDIATE);
+    vt_range(VT_STATE_DCS_ENTRY, 0x30, 0x39, VT_ACTION_PARAM, VT_STATE_DCS_PARAM);
+    vt_range(VT_STATE_DCS_ENTRY, 0x3A, 0x3A, VT_ACTION_NONE, VT_STATE_DCS_IGNORE);
+    vt_range(VT_STATE_DCS_ENTRY, 0x3B, 0x3B, VT_ACTION_PARAM, VT_STATE_DCS_PARAM);
+    vt_range(VT_STATE_DCS_ENTRY, 0x3C, 0x3F, VT_ACTION_COLLECT, VT_STATE_DCS_PARAM);
+    vt_range(VT_STATE_DCS_ENTRY, 0x40, 0x7E, VT_ACTION_NONE, VT_STATE_DCS_PASSTHROUGH);
+
+    vt_range(VT_STATE_DCS_PARAM, 0x20, 0x2F, VT_ACTION_COLLECT, VT_STATE_DCS_INTERMEDIATE);
+    vt_range(VT_STATE_DCS_PARAM, 0x30, 0x39, VT_ACTION_PARAM, VT_STAY);
+    vt_range(VT_STATE_DCS_PARAM, 0x3A, 0x3A, VT_ACTION_NONE, VT_STATE_DCS_IGNORE);
+    vt_range(VT_STATE_DCS_PARAM, 0x3B, 0x3B, VT_ACTION_PARAM, VT_STAY);
+    vt_range(VT_STATE_DCS_PARAM, 0x3C, 0x3F, VT_ACTION_NONE, VT_STATE_DCS_IGNORE);
+    vt_range(VT_STATE_DCS_PARAM, 0x40, 0x7E, VT_ACTION_NONE, VT_STATE_DCS_PASSTHROUGH);
+
+    vt_range(VT_STATE_DCS_INTERMEDIATE, 0x20, 0x2F, VT_ACTION_COLLECT, VT_STAY);
+    vt_range(VT_STATE_DCS_INTERMEDIATE, 0x30, 0x3F, VT_ACTION_NONE, VT_STATE_DCS_IGNORE);
+    vt_range(VT_STATE_DCS_INTERMEDIATE, 0x40, 0x7E, VT_ACTION_NONE, VT_STATE_DCS_PASSTHROUGH);
+
+    vt_c0(VT_STATE_DCS_PASSTHROUGH, VT_ACTION_PUT);
+    vt_range(VT_STATE_DCS_PASSTHROUGH, 0x20, 0x7E, VT_ACTION_PUT, VT_STAY);
+    vt_range(VT_STATE_DCS_PASSTHROUGH, 0x80, 0xFF, VT_ACTION_PUT, VT_STAY);
+
+    // OSC strings end on ST (ESC \) or, xterm style, on BEL
+    vt_range(VT_STATE_OSC_STRING, 0x07, 0x07, VT_ACTION_NONE, VT_STATE_GROUND);
+    vt_range(VT_STATE_OSC_STRING, 0x20, 0x7F, VT_ACTION_OSC_PUT, VT_STAY);
+    vt_range(VT_STATE_OSC_STRING, 0x80, 0xFF, VT_ACTION_OSC_PUT, VT_STAY);
+
+    // "Anywhere" transitions win over everything above
+    for (int s = 0; s < VT_STATE_COUNT; s++) {
+        vt_table[s][0x18] = VT_ENTRY(VT_ACTION_EXECUTE, VT_STATE_GROUND);
+        vt_table[s][0x1A] = VT_ENTRY(VT_ACTION_EXECUTE, VT_STATE_GROUND);
+        vt_table[s][0x1B] = VT_ENTRY(VT_ACTION_NONE, VT_STATE_ESCAPE);
+    }
+
+    vt_tables_ready = 1;
+}
+
+// Parameter idx, or def when it is missing or zero (ECMA-48 default semantics)
+static int vt_param(const ParserState* state, int idx, int def) {
+    if (idx >= state->param_count || state->params[idx] == 0) return def;
+    return state->params[idx];
+}
+
+// Blank cells [col_start, col_end) of a row
+static void erase_cells(TerminalGrid* grid, int row, int col_start, int col_end) {
+    if (row < 0 || row >= grid->height) return;
+    col_start = clamp_int(col_start, 0, grid->width);
+    col_end = clamp_int(col_end, 0, grid->width);
+    Cell* line = grid_row(grid, row);
+    for (int col = col_start; col < col_end; col++) line[col] = BLANK_CELL;
+    if (col_start < col_end) grid_damage_rows(grid, row, row);
+}
+
+// LF / IND: move down, scrolling the region when the cursor sits on its bottom margin
+static void line_feed(TerminalGrid* grid, ParserState* state) {
+    if (state->cursor_row == grid->scroll_bottom) {
+        grid_scroll_up(grid, grid->scroll_top, grid->scroll_bottom, 1, 1);
+    } else if (state->cursor_row < grid->height - 1) {
+        state->cursor_row++;
+    }
+}
+
+// RI: move up, scrolling the region down when the cursor sits on its top margin
+static void reverse_index(TerminalGrid* grid, ParserState* state) {
+    if (state->cursor_row == grid->scroll_top) {
+        grid_scroll_down(grid, grid->scroll_top, grid->scroll_bottom, 1);
+    } else if (state->cursor_row > 0) {
+        state->cursor_row--;
+    }
+}
+
+// Blank cell carrying the current SGR style
+static Cell pen_cell(const ParserState* state) {
+    Cell cell = BLANK_CELL;
+    cell.style = state->style_id;
+    return cell;
+}
+
+// Auto-wrap: the current row is marked as continuing, so a resize can rejoin the line
+static void wrap_line(TerminalGrid* grid, ParserState* state) {
+    if (state->cursor_row >= 0 && state->cursor_row < grid->height) {
+        ring_row(grid, state->cursor_row)->flags |= ROW_WRAPPED;
+    }
+    state->cursor_col = 0;
+    line_feed(grid, state);
+}
+
+static void print_codepoint(TerminalGrid* grid, ParserState* state, uint32_t codepoint) {
+    if (state->cursor_col >= grid->width) wrap_line(grid, state);
+    if (state->cursor_row >= 0 && state->cursor_row < grid->height && state->cursor_col >= 0) {
+        Cell cell = pen_cell(state);
+        cell.rune = codepoint;
+        writeCell(grid, state->cursor_col, state->cursor_row, cell);
+    }
+    state->cursor_col++;
+}
+
+// Write a run of printable ASCII starting at the cursor, building the pen once for the whole run
+static void print_ascii_run(TerminalGrid* grid, ParserState* state, const char* run, size_t len) {
+    Cell pen = pen_cell(state);
+
+    while (len > 0) {
+        if (state->cursor_col >= grid->width) wrap_line(grid, state);
+        size_t chunk = (size_t)(grid->width - state->cursor_col);
+        if (chunk > len) chunk = len;
+
+        if (state->cursor_row >= 0 && state->cursor_row < grid->height && state->cursor_col >= 0) {
+            Cell* cell = &grid_row(grid, state->cursor_row)[state->cursor_col];
+            for (size_t k = 0; k < chunk; k++) {
+                pen.rune = (unsigned char)run[k];
+                cell[k] = pen;
             }
+            grid_damage_rows(grid, state->cursor_row, state->cursor_row);
+        }
+        state->cursor_col += (int)chunk;
+        run += chunk;
+        len -= chunk;
+    }
+}
+
+// Print a run of text (printable ASCII and UTF-8) up to the next control byte.
+// ASCII stretches take the vectorized path, everything else goes through the UTF-8 DFA.
+// Returns the number of bytes consumed.
+static size_t print_text(TerminalGrid* grid, ParserState* state, const char* buf, size_t len) {
+    const unsigned char* p = (const unsigned char*)buf;
+    size_t i = 0;
+
+    while (i < len) {
+        if (p[i] < 0x80) {
+            if (state->utf8_state != UTF8_ACCEPT) {
+                // Truncated sequence followed by ASCII
+                state->utf8_state = UTF8_ACCEPT;
+                print_codepoint(grid, state, UTF8_REPLACEMENT);
+            }
+            size_t run = scan_printable_ascii(buf + i, len - i);
+            if (run == 0) break; // Control byte or DEL: back to the state machine
+            print_ascii_run(grid, state, buf + i, run);
+            i += run;
+            continue;
+        }
+
+        uint32_t prev = state->utf8_state;
+        switch (utf8_decode_step(&state->utf8_state, &state->utf8_codepoint, p[i])) {
+            case UTF8_ACCEPT:
+                print_codepoint(grid, state, state->utf8_codepoint);
+                i++;
+                break;
+            case UTF8_REJECT:
+                // One U+FFFD per maximal invalid subpart; a byte that broke a sequence
+                // is re-read as the possible start of the next one
+                state->utf8_state = UTF8_ACCEPT;
+                print_codepoint(grid, state, UTF8_REPLACEMENT);
+                if (prev == UTF8_ACCEPT) i++;
+                break;
+            default:
+                i++; // Waiting for continuation bytes, possibly in the next read
+                break;
+        }
+    }
+    return i;
+}
+
+static void vt_execute(TerminalGrid* grid, ParserState* state, unsigned char c) {
+    switch (c) {
+        case '\b':
+            if (state->cursor_col > 0) state->cursor_col--;
+            break;
+        case '\t':
+            state->cursor_col = (state->cursor_col / 8 + 1) * 8;
+            if (state->cursor_col >= grid->width) state->cursor_col = grid->width - 1;
+            break;
+        case '\n':
+        case '\v':
+        case '\f':
+            line_feed(grid, state);
+            break;
+        case '\r':
+            state->cursor_col = 0;
+            break;
+        default:
+            // BEL and the remaining C0 controls have no visible effect
             break;
     }
-    return (int)(p - raw);
 }
 
-void process_output_bytes(TerminalGrid* grid, const char* temp, ssize_t n, ParserState* state) {
-    for (ssize_t i = 0; i < n; ) {
-        unsigned char c = (unsigned char)temp[i];
-        // Check if clear screen was signaled
-        if (state->fg_color == -2) {
+// DECSC: each screen has its own slot, as in xterm
+static void vt_save_cursor(TerminalGrid* grid, ParserState* state) {
+    SavedCursor* saved = &state->saved_cursor[grid->alt_active];
+    saved->row = state->cursor_row;
+    saved->col = state->cursor_col;
+    saved->pen = state->pen;
+    saved->style_id = state->style_id;
+}
+
+// DECRC: without an earlier DECSC the slot is zeroed, which homes the cursor with default attributes
+static void vt_restore_cursor(TerminalGrid* grid, ParserState* state) {
+    const SavedCursor* saved = &state->saved_cursor[grid->alt_active];
+    state->cursor_row = clamp_int(saved->row, 0, grid->height - 1);
+    state->cursor_col = clamp_int(saved->col, 0, grid->width);
+    state->pen = saved->pen;
+    state->style_id = saved->style_id;
+}
+
+static void vt_esc_dispatch(TerminalGrid* grid, ParserState* state, unsigned char final) {
+    if (state->intermediate_count > 0) return; // charset designations etc. are not supported
+
+    switch (final) {
+        case '7': // DECSC
+            vt_save_cursor(grid, state);
+            break;
+        case '8': // DECRC
+            vt_restore_cursor(grid, state);
+            break;
+        case 'D': // IND
+            line_feed(grid, state);
+            break;
+        case 'E': // NEL
+            state->cursor_col = 0;
+            line_feed(grid, state);
+            break;
+        case 'M': // RI
+            reverse_index(grid, state);
+            break;
+        case 'c': // RIS
+            grid_set_alternate_screen(grid, 0);
+            memset(state->saved_cursor, 0, sizeof(state->saved_cursor));
             clear_screen(grid);
-            state->fg_color = -1; // Reset signal
+            grid_clear_history(grid);
+            grid->scroll_top = 0;
+            grid->scroll_bottom = grid->height - 1;
+            state->cursor_row = 0;
+            state->cursor_col = 0;
+            memset(&state->pen, 0, sizeof(state->pen));
+            state->style_id = STYLE_DEFAULT;
+            state->sync_update = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+static int vt_is_sub_param(const ParserState* state, int idx) {
+    return idx < state->param_count && (state->param_subs >> idx & 1u);
+}
+
+// Extended colour after SGR 38 / 48 / 58 starting at parameter i. Handles both the colon
+// form (38:5:n, 38:2::r:g:b, 38:2:r:g:b) and the semicolon form (38;5;n, 38;2;r;g;b).
+// Returns the index of the last parameter consumed; *color is left alone if malformed.
+static int vt_sgr_extended_color(const ParserState* state, int i, CellColor* color) {
+    int n = state->param_count;
+
+    if (vt_is_sub_param(state, i + 1)) {
+        int end = i + 1;
+        while (vt_is_sub_param(state, end + 1)) end++;
+        int subs = end - i;
+        int kind = state->params[i + 1];
+        if (kind == 5 && subs >= 2) {
+            *color = CELL_COLOR_PALETTE(state->params[i + 2] & 0xFF);
+        } else if (kind == 2 && subs >= 4) {
+            // With 5 or more sub parameters the first one after the 2 is a colour space ID
+            int rgb = subs >= 5 ? i + 3 : i + 2;
+            *color = CELL_COLOR_TRUE(state->params[rgb], state->params[rgb + 1], state->params[rgb + 2]);
+        }
+        return end;
+    }
+
+    if (i + 1 >= n) return i;
+    int kind = state->params[i + 1];
+    if (kind == 5) {
+        if (i + 2 >= n) return n - 1;
+        *color = CELL_COLOR_PALETTE(state->params[i + 2] & 0xFF);
+        return i + 2;
+    }
+    if (kind == 2) {
+        if (i + 4 >= n) return n - 1;
+        *color = CELL_COLOR_TRUE(state->params[i + 2], state->params[i + 3], state->params[i + 4]);
+        return i + 4;
+    }
+    return i + 1;
+}
+
+static void mark_row_styles(StyleTable* table, const Row* rows, int capacity) {
+    for (int i = 0; i < capacity; i++) {
+        for (int x = 0; x < rows[i].width && rows[i].cells; x++) style_gc_mark(table, rows[i].cells[x].style);
+    }
+}
+
+// Frees the style IDs no cell, pen or saved cursor refers to any more. Every ring slot is
+// marked, stale ones included, which keeps the walk simple and frees slightly less.
+static void collect_styles(TerminalGrid* grid, ParserState* state) {
+    StyleTable* table = grid->styles;
+    style_gc_begin(table);
+    style_gc_mark(table, state->style_id);
+    style_gc_mark(table, state->saved_cursor[0].style_id);
+    style_gc_mark(table, state->saved_cursor[1].style_id);
+    mark_row_styles(table, grid->rows, grid->capacity);
+    if (grid->inactive.rows) mark_row_styles(table, grid->inactive.rows, grid->inactive.capacity);
+    scrollback_mark_styles(grid->cold, table);
+    style_gc_end(table);
+}
+
+// IDs kept back for styles without truecolour once truecolour styles have used up the rest
+#define STYLE_PALETTE_RESERVE 4096
+
+static const int cube_levels[6] = {0, 95, 135, 175, 215, 255};
+
+static int nearest_cube_level(int v) {
+    int best = 0;
+    for (int i = 1; i < 6; i++) {
+        if (abs(v - cube_levels[i]) < abs(v - cube_levels[best])) best = i;
+    }
+    return best;
+}
+
+// Nearest entry of the 256-colour cube or grey ramp for a truecolour value, others unchanged
+static CellColor round_to_palette(CellColor color) {
+    if (!(color & CELL_COLOR_RGB)) return color;
+    int r = (int)(color >> 16) & 0xFF, g = (int)(color >> 8) & 0xFF, b = (int)color & 0xFF;
+
+    int ri = nearest_cube_level(r), gi = nearest_cube_level(g), bi = nearest_cube_level(b);
+    int dr = r - cube_levels[ri], dg = g - cube_levels[gi], db = b - cube_levels[bi];
+    int cube_dist = dr * dr + dg * dg + db * db;
+
+    int grey = clamp_int(((r + g + b) / 3 - 8 + 5) / 10, 0, 23);
+    int level = 8 + 10 * grey;
+    int grey_dist = (r - level) * (r - level) + (g - level) * (g - level) + (b - level) * (b - level);
+
+    return CELL_COLOR_PALETTE(grey_dist < cube_dist ? 232 + grey : 16 + 36 * ri + 6 * gi + bi);
+}
+
+static int style_has_truecolor(const Style* style) {
+    return ((style->fg | style->bg | style->underline_color) & CELL_COLOR_RGB) != 0;
+}
+
+// ID of the pen, reclaiming unused IDs first when the table is running out of them. Truecolour
+// styles may not take the last STYLE_PALETTE_RESERVE IDs; past that they are rounded to the
+// palette, so a stream of distinct 24-bit colours degrades to close colours, not the default.
+static StyleId intern_pen(TerminalGrid* grid, ParserState* state, const Style* pen) {
+    StyleId id;
+    if (style_find(grid->styles, pen, &id)) return id;
+
+    uint32_t headroom = style_has_truecolor(pen) ? STYLE_PALETTE_RESERVE : 1;
+    if (style_gc_due(grid->styles, headroom)) collect_styles(grid, state);
+    if (style_count(grid->styles) + headroom <= STYLE_MAX_COUNT) return style_intern(grid->styles, pen);
+
+    Style rounded = *pen;
+    rounded.fg = round_to_palette(pen->fg);
+    rounded.bg = round_to_palette(pen->bg);
+    rounded.underline_color = round_to_palette(pen->underline_color);
+    return style_intern(grid->styles, &rounded);
+}
+
+// Apply SGR parameters to the pen; the style ID is only looked up again when the pen changed
+static void vt_select_graphic_rendition(TerminalGrid* grid, ParserState* state) {
+    Style pen = state->pen;
+    int count = state->param_count > 0 ? state->param_count : 1;
+    for (int i = 0; i < count; i++) {
+        int p = i < state->param_count ? state->params[i] : 0;
+
+        // Sub parameters other than the ones read below (e.g. 4:3 curly underline)
+        int sub = vt_is_sub_param(state, i + 1) ? state->params[i + 1] : -1;
+
+        switch (p) {
+            case 0: memset(&pen, 0, sizeof(pen)); break;
+            case 1: pen.attrs |= STYLE_BOLD; break;
+            case 2: pen.attrs |= STYLE_DIM; break;
+            case 3: pen.attrs |= STYLE_ITALIC; break;
+            case 4:
+                if (sub == 0) pen.attrs &= ~STYLE_UNDERLINE;
+                else pen.attrs |= STYLE_UNDERLINE;
+                break;
+            case 5: case 6: pen.attrs |= STYLE_BLINK; break;
+            case 7: pen.attrs |= STYLE_INVERSE; break;
+            case 8: pen.attrs |= STYLE_HIDDEN; break;
+            case 9: pen.attrs |= STYLE_STRIKE; break;
+            case 21: pen.attrs |= STYLE_UNDERLINE; break;
+            case 22: pen.attrs &= ~(STYLE_BOLD | STYLE_DIM); break;
+            case 23: pen.attrs &= ~STYLE_ITALIC; break;
+            case 24: pen.attrs &= ~STYLE_UNDERLINE; break;
+            case 25: pen.attrs &= ~STYLE_BLINK; break;
+            case 27: pen.attrs &= ~STYLE_INVERSE; break;
+            case 28: pen.attrs &= ~STYLE_HIDDEN; break;
+            case 29: pen.attrs &= ~STYLE_STRIKE; break;
+            case 38: i = vt_sgr_extended_color(state, i, &pen.fg); continue;
+            case 39: pen.fg = CELL_COLOR_DEFAULT; break;
+            case 48: i = vt_sgr_extended_color(state, i, &pen.bg); continue;
+            case 49: pen.bg = CELL_COLOR_DEFAULT; break;
+            case 58: i = vt_sgr_extended_color(state, i, &pen.underline_color); continue;
+            case 59: pen.underline_color = CELL_COLOR_DEFAULT; break;
+            default:
+                if (p >= 30 && p <= 37) pen.fg = CELL_COLOR_PALETTE(p - 30);
+                else if (p >= 40 && p <= 47) pen.bg = CELL_COLOR_PALETTE(p - 40);
+                else if (p >= 90 && p <= 97) pen.fg = CELL_COLOR_PALETTE(p - 90 + 8);
+                else if (p >= 100 && p <= 107) pen.bg = CELL_COLOR_PALETTE(p - 100 + 8);
+                break;
+        }
+
+        // Skip sub parameters of anything that was not an extended colour
+        while (vt_is_sub_param(state, i + 1)) i++;
+    }
+
+    if (memcmp(&pen, &state->pen, sizeof(pen)) == 0) return;
+    state->pen = pen;
+    state->style_id = intern_pen(grid, state, &pen);
+}
+
+// DECSET / DECRST (CSI ? Pm h / CSI ? Pm l)
+static void vt_set_private_mode(TerminalGrid* grid, ParserState* state, int mode, int enable) {
+    switch (mode) {
+        case 47: // Alternate screen, contents kept
+            grid_set_alternate_screen(grid, enable);
+            break;
+        case 1047: // Alternate screen, cleared when leaving it
+            if (!enable && grid->alt_active) clear_screen(grid);
+            grid_set_alternate_screen(grid, enable);
+            break;
+        case 1048: // Save / restore cursor
+            if (enable) vt_save_cursor(grid, state);
+            else vt_restore_cursor(grid, state);
+            break;
+        case 1049: // Save cursor and switch to a cleared alternate screen / switch back and restore
+            if (enable) {
+                if (grid->alt_active) break;
+                vt_save_cursor(grid, state);
+                grid_set_alternate_screen(grid, 1);
+                clear_screen(grid);
+            } else {
+                if (!grid->alt_active) break;
+                grid_set_alternate_screen(grid, 0);
+                vt_restore_cursor(grid, state);
+            }
+            break;
+        case 2026: // Synchronized output: the consumer holds presentation until it is reset
+            state->sync_update = enable;
+            break;
+        default:
+            break;
+    }
+}
+
+static void vt_csi_dispatch(TerminalGrid* grid, ParserState* state, unsigned char final) {
+    if (state->private_marker == '?' && state->intermediate_count == 0 && (final == 'h' || final == 'l')) {
+        for (int i = 0; i < state->param_count; i++) {
+            vt_set_private_mode(grid, state, state->params[i], final == 'h');
         }
-        if (c == '\r') { i++; continue; }
-        if (c == '\n') {
-            state->cursor_row++;
+        return;
+    }
+
+    // Other private sequences and sequences with intermediates are not handled yet
+    if (state->private_marker || state->intermediate_count > 0) return;
+    // Colon sub parameters only carry meaning for SGR
+    if (state->param_subs && final != 'm') return;
+
+    int row = state->cursor_row;
+    int col = state->cursor_col;
+
+    switch (final) {
+        case 'A': // CUU
+            state->cursor_row = clamp_int(row - vt_param(state, 0, 1), 0, grid->height - 1);
+            break;
+        case 'B': // CUD
+            state->cursor_row = clamp_int(row + vt_param(state, 0, 1), 0, grid->height - 1);
+            break;
+        case 'C': // CUF
+            state->cursor_col = clamp_int(col + vt_param(state, 0, 1), 0, grid->width - 1);
+            break;
+        case 'D': // CUB
+            state->cursor_col = clamp_int(col - vt_param(state, 0, 1), 0, grid->width - 1);
+            break;
+        case 'E': // CNL
+            state->cursor_row = clamp_int(row + vt_param(state, 0, 1), 0, grid->height - 1);
             state->cursor_col = 0;
-            grid->cursor.row = state->cursor_row;
-            grid->cursor.col = state->cursor_col;
-            i++;
-            continue;
+            break;
+        case 'F': // CPL
+            state->cursor_row = clamp_int(row - vt_param(state, 0, 1), 0, grid->height - 1);
+            state->cursor_col = 0;
+            break;
+        case 'G': // CHA
+            state->cursor_col = clamp_int(vt_param(state, 0, 1) - 1, 0, grid->width - 1);
+            break;
+        case 'd': // VPA
+            state->cursor_row = clamp_int(vt_param(state, 0, 1) - 1, 0, grid->height - 1);
+            break;
+        case 'H': // CUP
+        case 'f': // HVP
+            state->cursor_row = clamp_int(vt_param(state, 0, 1) - 1, 0, grid->height - 1);
+            state->cursor_col = clamp_int(vt_param(state, 1, 1) - 1, 0, grid->width - 1);
+            break;
+        case 'J': // ED: 0 = cursor to end, 1 = start to cursor, 2 = entire screen, 3 = scrollback
+            switch (vt_param(state, 0, 0)) {
+                case 0:
+                    erase_cells(grid, row, col, grid->width);
+                    for (int r = row + 1; r < grid->height; r++) erase_cells(grid, r, 0, grid->width);
+                    break;
+                case 1:
+                    for (int r = 0; r < row; r++) erase_cells(grid, r, 0, grid->width);
+                    erase_cells(grid, row, 0, col + 1);
+                    break;
+                case 3: // xterm: drop the scrollback, the screen is left alone
+                    grid_clear_history(grid);
+                    break;
+                default:
+                    clear_screen(grid);
+                    break;
+            }
+            break;
+        case 'K': // EL: 0 = cursor to end, 1 = start to cursor, 2 = whole line
+            switch (vt_param(state, 0, 0)) {
+                case 0: erase_cells(grid, row, col, grid->width); break;
+                case 1: erase_cells(grid, row, 0, col + 1); break;
+                default: erase_cells(grid, row, 0, grid->width); break;
+            }
+            break;
+        case 'X': // ECH
+            erase_cells(grid, row, col, col + vt_param(state, 0, 1));
+            break;
+        case 'P': // DCH
+        case '@': { // ICH
+            if (row < 0 || row >= grid->height || col >= grid->width) break;
+            int n = clamp_int(vt_param(state, 0, 1), 1, grid->width - col);
+            Cell* line = grid_row(grid, row);
+            if (final == 'P') {
+                memmove(&line[col], &line[col + n], sizeof(Cell) * (size_t)(grid->width - col - n));
+                erase_cells(grid, row, grid->width - n, grid->width);
+            } else {
+                memmove(&line[col + n], &line[col], sizeof(Cell) * (size_t)(grid->width - col - n));
+                erase_cells(grid, row, col, col + n);
+            }
+            break;
         }
-        if (c == 27) {
-            int consumed = parse_escape_sequence(temp + i, (size_t)(n - i), state);
-            if (consumed > 0) { i += consumed; continue; }
-        }
-        
-        // Decode UTF-8 character
-        uint32_t codepoint = 0;
-        int bytes_consumed = decode_utf8(temp, (size_t)n, (size_t)i, &codepoint);
-        if (bytes_consumed > 0) {
-            if (state->cursor_row >= 0 && state->cursor_col >= 0) {
-                color3 fg = get_color_from_code(state->fg_color >= 0 ? state->fg_color : 7);
-                color3 bg = get_color_from_code(state->bg_color >= 0 ? state->bg_color : 0);
-                writeCell(grid, state->cursor_col, state->cursor_row, codepoint, &fg, &bg);
-                state->cursor_col++;
-                grid->cursor.row = state->cursor_row;
-                grid->cursor.col = state->cursor_col;
+        case 'L': // IL
+        case 'M': // DL
+            if (row < grid->scroll_top || row > grid->scroll_bottom) break;
+            if (final == 'L') grid_scroll_down(grid, row, grid->scroll_bottom, vt_param(state, 0, 1));
+            else grid_scroll_up(grid, row, grid->scroll_bottom, vt_param(state, 0, 1), 0);
+            state->cursor_col = 0;
+            break;
+        case 'S': // SU
+            grid_scroll_up(grid, grid->scroll_top, grid->scroll_bottom, vt_param(state, 0, 1), 0);
+            break;
+        case 'T': // SD
+            grid_scroll_down(grid, grid->scroll_top, grid->scroll_bottom, vt_param(state, 0, 1));
+            break;
+        case 'r': { // DECSTBM
+            int top = vt_param(state, 0, 1) - 1;
+            int bottom = vt_param(state, 1, grid->height) - 1;
+            if (bottom >= grid->height) bottom = grid->height - 1;
+            if (top < bottom) {
+                grid->scroll_top = top;
+                grid->scroll_bottom = bottom;
+                state->cursor_row = 0;
+                state->cursor_col = 0;
             }
-            i += bytes_consumed;
-        } else {
-            i++; // Skip invalid byte
+            break;
         }
+        case 'm': // SGR
+            vt_select_graphic_rendition(grid, state);
+            break;
+        case 's': // SCOSC
+            if (state->param_count == 0) vt_save_cursor(grid, state);
+            break;
+        case 'u': // SCORC
+            if (state->param_count == 0) vt_restore_cursor(grid, state);
+            break;
+        default:
+            break;
     }
 }
 
+static void vt_osc_dispatch(ParserState* state) {
+    // OSC 0 / OSC 2: window title. Everything else (hyperlinks, cwd, ...) is ignored for now.
+    const char* s = state->osc_buf;
+    if ((s[0] == '0' || s[0] == '2') && s[1] == ';') {
+        snprintf(state->title, sizeof(state->title), "%s", s + 2);
+        state->title_changed = 1;
+    }
+}
+
+static void vt_perform(TerminalGrid* grid, ParserState* state, uint8_t action, unsigned char c) {
+    switch (action) {
+        case VT_ACTION_EXECUTE:
+            vt_execute(grid, state, c);
+            break;
+        case VT_ACTION_CLEAR:
+            state->private_marker = 0;
+            state->intermediate_count = 0;
+            state->param_count = 0;
+            state->param_subs = 0;
+            memset(state->params, 0, sizeof(state->params));
+            break;
+        case VT_ACTION_COLLECT:
+            if (c >= 0x3C && c <= 0x3F) {
+                state->private_marker = c;
+            } else if (state->intermediate_count < VT_MAX_INTERMEDIATES) {
+                state->intermediates[state->intermediate_count++] = (char)c;
+            }
+            break;
+        case VT_ACTION_PARAM:
+            if (state->param_count == 0) state->param_count = 1;
+            if (c == ';' || c == ':') {
+                if (state->param_count < VT_MAX_PARAMS) {
+                    if (c == ':') state->param_subs |= 1u << state->param_count;
+                    state->param_count++;
+                }
+            } else {
+                uint16_t* p = &state->params[state->param_count - 1];
+                unsigned v = *p * 10u + (unsigned)(c - '0');
+                *p = (uint16_t)(v > 65535u ? 65535u : v);
+            }
+            break;
+        case VT_ACTION_ESC_DISPATCH:
+            vt_esc_dispatch(grid, state, c);
+            break;
+        case VT_ACTION_CSI_DISPATCH:
+            vt_csi_dispatch(grid, state, c);
+            break;
+        case VT_ACTION_HOOK:
+        case VT_ACTION_PUT:
+        case VT_ACTION_UNHOOK:
+            // No DCS consumers yet (sixel, DECRQSS, ...): the payload is swallowed
+            break;
+        case VT_ACTION_OSC_START:
+            state->osc_len = 0;
+            break;
+        case VT_ACTION_OSC_PUT:
+            if (state->osc_len < VT_OSC_MAX - 1) state->osc_buf[state->osc_len++] = (char)c;
+            break;
+        case VT_ACTION_OSC_END:
+            state->osc_buf[state->osc_len] = '\0';
+            vt_osc_dispatch(state);
+            break;
+        default:
+            break;
+    }
+}
+
+void process_output_bytes(TerminalGrid* grid, const char* temp, ssize_t n, ParserState* state) {
+    if (!vt_tables_ready) vt_build_tables();
+
+    for (ssize_t i = 0; i < n; ) {
+        unsigned char c = (unsigned char)temp[i];
+        uint8_t entry = vt_table[state->vt_state][c];
+        uint8_t action = entry >> 4;
+        uint8_t next = entry & 0x0F;
+
+        if (action == VT_ACTION_PRINT) {
+            // Only reachable from ground, which never changes state on print
+            size_t consumed = print_text(grid, state, temp + i, (size_t)(n - i));
+            if (consumed > 0) {
+                i += (ssize_t)consumed;
+                continue;
+            }
+        }
+
+        if (state->utf8_state != UTF8_ACCEPT) {
+            // A control or escape interrupted a multi-byte sequence
+            state->utf8_state = UTF8_ACCEPT;
+            print_codepoint(grid, state, UTF8_REPLACEMENT);
+        }
+
+        if (next == VT_STAY) {
+            vt_perform(grid, state, action, c);
+        } else {
+            vt_perform(grid, state, vt_exit_action[state->vt_state], c);
+            vt_perform(grid, state, action, c);
+            state->vt_state = next;
+            vt_perform(grid, state, vt_entry_action[next], c);
+        }
+        i++;
+    }
+
+    // The cursor is drawn over its row, so moving it damages where it was and where it is now
+    if (grid->cursor.row != state->cursor_row || grid->cursor.col != state->cursor_col) {
+        grid_damage_rows(grid, grid->cursor.row, grid->cursor.row);
+        grid_damage_rows(grid, state->cursor_row, state->cursor_row);
+    }
+    grid->cursor.row = state->cursor_row;
+    grid->cursor.col = state->cursor_col;
+}
@@ -1,30 +1,138 @@
+#ifndef TERMINAL_LOGIC_H
+#define TERMINAL_LOGIC_H
+
 #include "types.h"
+#include "style.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
+// States of the DEC/ECMA-48 escape sequence parser (after Paul Williams' VT500 model)
+typedef enum {
+	VT_STATE_GROUND = 0,
+	VT_STATE_ESCAPE,
+	VT_STATE_ESCAPE_INTERMEDIATE,
+	VT_STATE_CSI_ENTRY,
+	VT_STATE_CSI_PARAM,
+	VT_STATE_CSI_INTERMEDIATE,
+	VT_STATE_CSI_IGNORE,
+	VT_STATE_DCS_ENTRY,
+	VT_STATE_DCS_PARAM,
+	VT_STATE_DCS_INTERMEDIATE,
+	VT_STATE_DCS_PASSTHROUGH,
+	VT_STATE_DCS_IGNORE,
+	VT_STATE_OSC_STRING,
+	VT_STATE_SOS_PM_APC_STRING,
+	VT_STATE_COUNT
+} VtState;
+
+#define VT_MAX_PARAMS 32
+#define VT_MAX_INTERMEDIATES 2
+#define VT_OSC_MAX 512
+#define VT_TITLE_MAX 256
+
+// Cursor state kept by DECSC / DECRC (ESC 7 / ESC 8)
+typedef struct {
+	int row;
+	int col;
+	Style pen;
+	StyleId style_id;
+} SavedCursor;
+
+// Everything the parser needs to resume a sequence split across two reads lives here
 typedef struct {
 	int cursor_row;
 	int cursor_col;
-	int fg_color;
-	int bg_color;
-	int bold;
-	int underline;
+	Style pen;                                     // attributes set by SGR, zeroed is the default style
+	StyleId style_id;                              // interned ID of pen, written into printed cells
+
+	uint32_t utf8_state;                           // UTF-8 DFA state, UTF8_ACCEPT between characters
+	uint32_t utf8_codepoint;                       // code point being assembled
+
+	uint8_t vt_state;                              // current VtState
+	uint8_t private_marker;                        // '?', '>', '<' or '=' after CSI / DCS, 0 if none
+	uint8_t intermediate_count;
+	char intermediates[VT_MAX_INTERMEDIATES];
+	int param_count;                               // 0 when no parameter bytes were seen
+	uint32_t param_subs;                           // bit i set when params[i] followed a ':' (sub parameter)
+	uint16_t params[VT_MAX_PARAMS];
+
+	size_t osc_len;
+	char osc_buf[VT_OSC_MAX];
+
+	char title[VT_TITLE_MAX];                      // last title set through OSC 0 / OSC 2
+	int title_changed;                             // set by the parser, cleared by the consumer
+
+	int sync_update;                               // set while a synchronized update (CSI ?2026h) is open
+
+	SavedCursor saved_cursor[2];                   // DECSC slots of the primary [0] and alternate [1] screen
 } ParserState;
 
 void setCursorPosition(Cursor *cursor, int row, int column);
-TerminalGrid createTerminalGrid(void);
+// Grid of cols x rows with the configured scrollback (scrollbackLines, scrollbackBudgetMB)
+TerminalGrid createTerminalGrid(int cols, int rows);
+TerminalGrid createTerminalGridSized(int cols, int rows, int scrollback);
 void freeGrid(TerminalGrid* grid);
-void writeCell(TerminalGrid* grid, int x, int y, uint32_t rune, color3* fg, color3* bg);
-void setCursorPosition(Cursor *cursor, int row, int column);
+void writeCell(TerminalGrid* grid, int x, int y, Cell cell);
 
-// Parse a CSI escape starting at raw (if present), return bytes consumed
-int parse_escape_sequence(const char* raw, size_t len, ParserState* state);
+// Total scrollback lines: the uncompressed ring history plus the compressed tier.
+// Finishes a pending history reflow first, so the count matches what grid_row returns.
+int grid_history_lines(TerminalGrid* grid);
+
+// Cells of screen row `row`; negative rows (down to -grid_history_lines) are scrollback.
+// Compressed rows are decoded on demand and must not be written. NULL when out of range.
+Cell* grid_row(TerminalGrid* grid, int row);
+
+// Stable ID of screen row `row` (negative rows are scrollback). IDs grow by one for every line
+// the primary screen scrolls into history; they stay valid until history_epoch changes.
+static inline uint64_t grid_line_id(const TerminalGrid* grid, int row) {
+    return grid->scrolled_lines + (uint64_t)(int64_t)row;
+}
+
+// Cells of the row shown at screen position `row`, taking the scrollback view offset into account
+Cell* grid_view_row(TerminalGrid* grid, int row);
+
+// Scroll rows [top, bottom] up / down by count lines. A full-screen scroll up with to_history set
+// (line feeds: LF, IND, NEL) pushes the lines into scrollback; otherwise they are discarded.
+void grid_scroll_up(TerminalGrid* grid, int top, int bottom, int count, int to_history);
+void grid_scroll_down(TerminalGrid* grid, int top, int bottom, int count);
+
+// Mark screen rows [top, bottom] (clamped to the screen) as needing a redraw
+void grid_damage_rows(TerminalGrid* grid, int top, int bottom);
+void grid_damage_all(TerminalGrid* grid);
+
+// Query and reset the damage since the last call. Rows are screen rows of the live screen;
+// moving the view offset damages every row. When rows is not NULL it receives grid->height
+// flags, nonzero for each row that changed. Returns the number of damaged rows.
+int grid_take_damage(TerminalGrid* grid, uint8_t* rows);
+
+// Resize the screen to cols x rows. Auto-wrapped lines on screen are rewrapped to the new
+// width right away and the parser's cursor follows its text; rows pushed off the top become
+// history. History is rewrapped lazily, the first time it is viewed or read.
+void grid_resize(TerminalGrid* grid, ParserState* state, int cols, int rows);
+
+// Switch between the primary screen and the alternate screen (allocated on first use).
+// Only the ring handles are exchanged; the primary history is left untouched.
+void grid_set_alternate_screen(TerminalGrid* grid, int enable);
+
+// Rewrap the ring history to the current width if a resize left it at an old width
+void grid_reflow_history(TerminalGrid* grid);
+
+// Move the viewport `lines` rows back into history (negative moves towards the live screen)
+void grid_scroll_view(TerminalGrid* grid, int lines);
+void grid_clear_history(TerminalGrid* grid);
 
 // Map ANSI color codes to RGB
 color3 get_color_from_code(int color_code);
 
-// Process a chunk of shell output into grid with ANSI handling
+// Resolve a packed cell colour to RGB, CELL_COLOR_DEFAULT resolves to default_color
+color3 resolve_cell_color(CellColor color, color3 default_color);
+
+// Process a chunk of shell output into grid with ANSI handling.
+// Sequences may be split at any byte; the remainder is picked up on the next call.
 void process_output_bytes(TerminalGrid* grid, const char* buf, ssize_t n, ParserState* state);
 
 // Clear the terminal grid (for ESC[2J sequences)
 void clear_screen(TerminalGrid* grid);
+
+#endif // TERMINAL_LOGIC_H
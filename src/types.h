@@ -1,7 +1,6 @@
 #ifndef TYPES_H
 #define TYPES_H
 
-#include <glad/glad.h>
 #include <stdint.h>
 
 // Color structs for alpha and non alpha colors
@@ -23,31 +22,96 @@ typedef struct{
  * Stores texture data and metrics needed for rendering individual characters
  */
 typedef struct {
-    GLuint TextureID;      /**< Texture ID for the character glyph */
+    unsigned int TextureID; /**< Atlas page texture (GLuint) holding the glyph, 0 if it has no pixels */
     int Width;             /**< Width of the character bitmap */
     int Height;            /**< Height of the character bitmap */
     int BearingX;          /**< Offset from cursor x to left edge of glyph */
     int BearingY;          /**< Offset from baseline to top of glyph */
     unsigned int Advance;  /**< Distance to advance cursor for next character */
+    float u0, v0;          /**< Atlas texture coordinates of the bitmap's top-left corner */
+    float u1, v1;          /**< Atlas texture coordinates of the bitmap's bottom-right corner */
+    int Sdf;               /**< 1 if the bitmap is a signed distance field, metrics are then in field texels */
 } Character;
 
+/**
+ * Packed colour
+ * With CELL_COLOR_RGB set the low 24 bits are 0xRRGGBB, with CELL_COLOR_INDEXED set the
+ * low 8 bits index the palette. 0 (CELL_COLOR_DEFAULT) is the terminal's default
+ * foreground / background, so a zeroed style is the default style.
+ */
+typedef uint32_t CellColor;
+
+#define CELL_COLOR_DEFAULT 0u
+#define CELL_COLOR_RGB     0x01000000u
+#define CELL_COLOR_INDEXED 0x02000000u
+#define CELL_COLOR_PALETTE(index) (CELL_COLOR_INDEXED | (CellColor)(uint8_t)(index))
+#define CELL_COLOR_TRUE(r, g, b)  (CELL_COLOR_RGB | ((CellColor)(uint8_t)(r) << 16) | ((CellColor)(uint8_t)(g) << 8) | (CellColor)(uint8_t)(b))
+
+/**
+ * Cell struct - One character position on the grid, 8 bytes
+ * Colours and attributes live in the terminal's style table (style.h), the cell only
+ * keeps the ID of its style.
+ */
 typedef struct {
-    uint32_t rune;
-    color3 fg;
-    color3 bg;
-    uint8_t flags;
+    uint32_t rune : 21;    /**< Unicode code point, 0 for an empty cell */
+    uint32_t flags : 11;   /**< Per-cell bits that are not part of the style */
+    uint16_t style;        /**< StyleId, 0 is the default style */
 } Cell;
 
+_Static_assert(sizeof(Cell) == 8, "Cell is expected to pack into 8 bytes");
+
 typedef struct {
     int row;
     int col;
 } Cursor;
 
+// Row flag bits
+#define ROW_WRAPPED 0x01   /**< the line was auto-wrapped and continues on the next row */
+
+typedef struct {
+    Cell *cells;           /**< width cells, allocated the first time the row is used */
+    int width;             /**< cells allocated, differs from the grid width until a resize reflows the row */
+    uint8_t flags;         /**< ROW_* bits */
+} Row;
+
+/**
+ * Row storage of one screen: the primary ring with its history, or the alternate screen
+ * (a ring of exactly height rows that never gains history)
+ */
+typedef struct {
+    Row *rows;
+    int capacity;
+    int top;
+    int history;
+    int reflow_pending;
+} GridSurface;
+
+/**
+ * Terminal screen plus scrollback
+ * rows is a ring of row handles: the `history` rows directly above `top` are scrollback,
+ * the `height` rows starting at `top` are the screen. Scrolling the full screen moves
+ * `top`, scroll regions rotate handles, and no cells are ever copied.
+ */
 typedef struct {
     int width;
     int height;
     Cursor cursor;
-    Cell *grid;
+    Row *rows;             /**< ring of capacity row handles */
+    int capacity;          /**< height + scrollback limit */
+    int top;               /**< ring slot of screen row 0 */
+    int history;           /**< valid scrollback rows above the screen */
+    int scroll_top;        /**< DECSTBM top margin, screen row (inclusive) */
+    int scroll_bottom;     /**< DECSTBM bottom margin, screen row (inclusive) */
+    int view_offset;       /**< rows scrolled back into history, 0 follows the output */
+    int reflow_pending;    /**< history rows still have the width from before the last resize */
+    struct ScrollbackStore *cold; /**< compressed history older than the ring, may be NULL */
+    struct StyleTable *styles;    /**< styles referenced by cells, screen and scrollback alike */
+    GridSurface inactive;  /**< the screen not shown: the alternate screen (allocated on first use) or the parked primary */
+    int alt_active;        /**< the ring fields above belong to the alternate screen */
+    uint64_t scrolled_lines; /**< lines the primary screen has pushed into history, screen row r is line scrolled_lines + r */
+    uint32_t history_epoch;  /**< bumped whenever history lines are rewritten rather than appended */
+    uint8_t *dirty;        /**< one flag per screen row, set when the row has to be redrawn */
+    int dirty_count;       /**< number of flags set in dirty, 0 when nothing changed */
 } TerminalGrid;
 
 #endif // TYPES_H
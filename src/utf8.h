@@ -0,0 +1,65 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stdint.h>
+
+/**
+ * Streaming UTF-8 decoder
+ * Table driven DFA (after Bjoern Hoehrmann) that rejects overlong forms, surrogates and
+ * code points above U+10FFFF. The state is two integers, so a sequence cut off at the
+ * end of one read is completed by the next one.
+ */
+
+#define UTF8_ACCEPT 0
+#define UTF8_REJECT 12
+#define UTF8_REPLACEMENT 0xFFFD
+
+/** Byte classes (first 256 entries) followed by the state transition table */
+extern const uint8_t utf8_dfa[364];
+
+/**
+ * Feed one byte to the decoder
+ * @param state - Decoder state, UTF8_ACCEPT when idle
+ * @param codepoint - Partial code point, complete when the return value is UTF8_ACCEPT
+ * @param byte - Next input byte
+ * @return New state: UTF8_ACCEPT (code point ready), UTF8_REJECT (invalid input) or a
+ *         pending state waiting for continuation bytes
+ */
+static inline uint32_t utf8_decode_step(uint32_t* state, uint32_t* codepoint, uint8_t byte) {
+    uint32_t type = utf8_dfa[byte];
+    *codepoint = (*state != UTF8_ACCEPT) ? (byte & 0x3Fu) | (*codepoint << 6)
+                                         : (0xFFu >> type) & byte;
+    *state = utf8_dfa[256 + *state + type];
+    return *state;
+}
+
+/**
+ * Encode one code point
+ * @param codepoint - Code point to encode, at most U+10FFFF
+ * @param out - Receives up to 4 bytes
+ * @return Number of bytes written
+ */
+static inline int utf8_encode(uint32_t codepoint, char* out) {
+    if (codepoint < 0x80) {
+        out[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = (char)(0xC0 | (codepoint >> 6));
+        out[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = (char)(0xE0 | (codepoint >> 12));
+        out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (codepoint >> 18));
+    out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+#endif // UTF8_H
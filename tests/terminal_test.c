@@ -0,0 +1,294 @@
+// Parser / grid regression tests
+//
+// Each test drives process_output_bytes on a headless grid and checks the cells that come
+// out. Run through ctest; the process exits nonzero when any check fails.
+
+#include "globals.h"
+#include "terminal_logic.h"
+#include "scrollback.h"
+#include "spill.h"
+#include "style.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int failures;
+
+static void check(int ok, const char* fmt, ...) {
+    if (ok) return;
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    failures++;
+}
+
+static void feed(TerminalGrid* grid, ParserState* state, const char* fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    process_output_bytes(grid, buf, n, state);
+}
+
+// Distinct truecolour for every line number below 2^24
+static CellColor line_color(int line) {
+    return CELL_COLOR_TRUE(line >> 16, line >> 8, line);
+}
+
+static void feed_colored(TerminalGrid* grid, ParserState* state, int line, const char* text) {
+    CellColor c = line_color(line);
+    feed(grid, state, "\x1b[38;2;%u;%u;%um%s", (c >> 16) & 0xFF, (c >> 8) & 0xFF, c & 0xFF, text);
+}
+
+static CellColor cell_fg(TerminalGrid* grid, const Cell* cell) {
+    return style_get(grid->styles, cell->style)->fg;
+}
+
+// More distinct styles than there are IDs: the ones still on screen or in history keep their colour
+static void test_style_ids_reused(void) {
+    TerminalGrid grid = createTerminalGridSized(80, 24, 100);
+    ParserState state = {0};
+    int lines = STYLE_MAX_COUNT + 5000;
+    for (int i = 0; i < lines; i++) feed_colored(&grid, &state, i, "x\r\n");
+
+    // Screen row height - 1 is the empty line after the last newline
+    int history = grid_history_lines(&grid);
+    for (int row = -history; row < grid.height - 1; row++) {
+        int line = lines - (grid.height - 1) + row;
+        const Cell* cells = grid_row(&grid, row);
+        check(cells && cells[0].rune == 'x' && cell_fg(&grid, &cells[0]) == line_color(line),
+              "style reuse: row %d should show line %d in its own colour", row, line);
+    }
+    check(style_count(grid.styles) <= STYLE_MAX_COUNT, "style reuse: table over its limit");
+    freeGrid(&grid);
+}
+
+// Styles only referenced by compressed scrollback survive collections
+static void test_style_ids_kept_for_cold_scrollback(void) {
+    scrollbackLines = 0;
+    scrollbackBudgetMB = 1;
+    TerminalGrid grid = createTerminalGrid(40, 10);
+    ParserState state = {0};
+
+    int kept = 1000;
+    for (int i = 0; i < kept; i++) feed_colored(&grid, &state, i, "old\r\n");
+    // Overwrite one screen cell with new colours until the table has been collected
+    for (int i = 0; i < STYLE_MAX_COUNT + 5000; i++) {
+        feed(&grid, &state, "\x1b[H");
+        feed_colored(&grid, &state, kept + i, "y");
+    }
+
+    int history = grid_history_lines(&grid);
+    check(history >= kept - grid.height, "cold styles: history lost (%d lines)", history);
+    for (int row = -history; row < 0; row++) {
+        int line = kept - (grid.height - 1) + row;
+        const Cell* cells = grid_row(&grid, row);
+        check(cells && cell_fg(&grid, &cells[0]) == line_color(line),
+              "cold styles: history row %d lost the colour of line %d", row, line);
+    }
+    const Cell* top = grid_row(&grid, 0);
+    check(cell_fg(&grid, &top[0]) == line_color(kept + STYLE_MAX_COUNT + 4999),
+          "cold styles: newest colour not applied");
+    freeGrid(&grid);
+}
+
+// Every truecolour style still on screen: further ones are rounded to the palette, not dropped
+static void test_truecolor_rounded_when_table_full(void) {
+    TerminalGrid grid = createTerminalGridSized(256, 256, 0);
+    ParserState state = {0};
+    int cells = 255 * 256;
+    for (int i = 0; i < cells; i++) feed_colored(&grid, &state, i + 1, "x");
+
+    // The default style holds one of the IDs left to truecolour
+    int exact = STYLE_MAX_COUNT - 4096;
+    for (int i = 0; i < cells; i++) {
+        const Cell* cell = &grid_row(&grid, i / 256)[i % 256];
+        CellColor fg = cell_fg(&grid, cell);
+        if (i < exact) {
+            check(fg == line_color(i + 1), "truecolour: cell %d lost its colour", i);
+        } else {
+            check(fg & CELL_COLOR_INDEXED, "truecolour: cell %d was not rounded to the palette", i);
+        }
+    }
+
+    feed(&grid, &state, "\x1b[256;1H\x1b[38;2;250;10;10mr\x1b[38;2;130;130;130mg");
+    const Cell* last = grid_row(&grid, 255);
+    check(cell_fg(&grid, &last[0]) == CELL_COLOR_PALETTE(196), "truecolour: red not rounded to 196");
+    check(cell_fg(&grid, &last[1]) == CELL_COLOR_PALETTE(244), "truecolour: grey not rounded to 244");
+    freeGrid(&grid);
+}
+
+// DL deletes lines: at row 0 of a full-screen region they must not end up in scrollback
+static void test_delete_line_skips_history(void) {
+    TerminalGrid grid = createTerminalGridSized(20, 5, 100);
+    ParserState state = {0};
+    for (int i = 0; i < 8; i++) feed(&grid, &state, "line%d\r\n", i);
+    int history = grid_history_lines(&grid);
+
+    feed(&grid, &state, "\x1b[H\x1b[2M");
+    check(grid_history_lines(&grid) == history, "DL: history grew from %d to %d lines",
+          history, grid_history_lines(&grid));
+    // line4 and line5 were deleted, line6 moved up to the top
+    check(grid_row(&grid, 0)[4].rune == '6', "DL: row 0 should hold line6");
+    check(grid_row(&grid, -1)[4].rune == '3', "DL: newest history line should still be line3");
+    check(grid_row(&grid, 4)[0].rune == 0, "DL: bottom row should be blank");
+    freeGrid(&grid);
+}
+
+// Lines of 20 to 79 characters starting with their number, fed in 64 KiB reads
+static void feed_flood(TerminalGrid* grid, ParserState* state, int lines) {
+    static char buf[1 << 16];
+    size_t len = 0;
+    for (int i = 0; i < lines; i++) {
+        int n = snprintf(buf + len, sizeof(buf) - len, "%07d ", i);
+        for (int k = 0; k < 12 + i % 60; k++) buf[len + n++] = (char)('a' + (i + k) % 26);
+        buf[len + n++] = '\r';
+        buf[len + n++] = '\n';
+        len += (size_t)n;
+        if (len > sizeof(buf) - 128 || i == lines - 1) {
+            process_output_bytes(grid, buf, (ssize_t)len, state);
+            len = 0;
+        }
+    }
+}
+
+// ED 3 drops the scrollback only; what is on screen stays
+static void test_clear_history_keeps_screen(void) {
+    scrollbackLines = 100;
+    TerminalGrid grid = createTerminalGrid(40, 10);
+    ParserState state = {0};
+    for (int i = 0; i < 30; i++) feed(&grid, &state, "\r\nline %02d", i);
+    feed(&grid, &state, "\x1b[3J");
+    check(grid_history_lines(&grid) == 0, "ED 3: %d history lines left", grid_history_lines(&grid));
+    for (int row = 0; row < grid.height; row++) {
+        int line = 20 + row;
+        const Cell* cells = grid_row(&grid, row);
+        int ok = cells && cells[0].rune == 'l' && cells[5].rune == (uint32_t)('0' + line / 10) &&
+                 cells[6].rune == (uint32_t)('0' + line % 10);
+        if (!ok) {
+            check(0, "ED 3: screen row %d no longer holds line %d", row, line);
+            break;
+        }
+    }
+    freeGrid(&grid);
+}
+
+// A resize leaves history to be reflowed later; once ED 3 has emptied it, the reflow and the
+// next resize rebuild the ring from no history at all
+static void test_resize_after_history_cleared(void) {
+    scrollbackLines = 100;
+    TerminalGrid grid = createTerminalGrid(40, 10);
+    ParserState state = {0};
+    for (int i = 0; i < 20; i++) feed(&grid, &state, "line %d\r\n", i);
+    grid_resize(&grid, &state, 30, 10);
+    feed(&grid, &state, "\x1b[3Jkept");
+    grid_reflow_history(&grid);
+    grid_resize(&grid, &state, 50, 12);
+    check(grid_history_lines(&grid) == 0, "resize: %d history lines after ED 3", grid_history_lines(&grid));
+    const Cell* cells = grid_row(&grid, state.cursor_row);
+    check(cells && cells[0].rune == 'k' && cells[3].rune == 't', "resize: cursor line lost after ED 3");
+    freeGrid(&grid);
+}
+
+// A flood faster than the packing thread must not cost history the memory budget has room for
+static void test_flood_keeps_history(void) {
+    scrollbackLines = 100;
+    scrollbackBudgetMB = 64;
+    TerminalGrid grid = createTerminalGrid(80, 24);
+    ParserState state = {0};
+    int lines = 300000;
+    feed_flood(&grid, &state, lines);
+
+    int history = grid_history_lines(&grid);
+    int first = lines - (grid.height - 1) - history;
+    check(first == 0, "flood: only %d of %d lines kept", history + grid.height - 1, lines);
+    for (int row = -history; row < grid.height - 1; row++) {
+        int line = first + history + row;
+        const Cell* cells = grid_row(&grid, row);
+        char number[8];
+        snprintf(number, sizeof(number), "%07d", line);
+        int ok = cells != NULL;
+        for (int k = 0; ok && k < 7; k++) ok = cells[k].rune == (uint32_t)number[k];
+        if (!ok) {
+            check(0, "flood: row %d does not hold line %d", row, line);
+            break;
+        }
+    }
+    freeGrid(&grid);
+
+    // With a budget too small for all of it the oldest lines go, and memory stays bounded
+    scrollbackBudgetMB = 1;
+    grid = createTerminalGrid(80, 24);
+    memset(&state, 0, sizeof(state));
+    feed_flood(&grid, &state, lines);
+    history = grid_history_lines(&grid);
+    size_t used = scrollback_memory_usage(grid.cold);
+    check(history < lines / 2, "flood: a 1 MiB budget kept %d lines", history);
+    check(used < (size_t)4 << 20, "flood: %zu bytes used with a 1 MiB budget", used);
+    freeGrid(&grid);
+}
+
+// The spill directory can sit in a shared /tmp, so one this user does not own privately is refused
+static void test_spill_refuses_shared_dir(void) {
+    char root[] = "/tmp/magterm-test-XXXXXX";
+    if (!mkdtemp(root)) {
+        check(0, "spill: could not create %s", root);
+        return;
+    }
+    char dir[64], target[64];
+    snprintf(dir, sizeof(dir), "%s/mag-terminal", root);
+    snprintf(target, sizeof(target), "%s/elsewhere", root);
+    const char* saved = getenv("XDG_RUNTIME_DIR");
+    char* old = saved ? strdup(saved) : NULL;
+    setenv("XDG_RUNTIME_DIR", root, 1);
+
+    mkdir(target, 0700);
+    check(symlink(target, dir) == 0, "spill: could not create the symlink");
+    SpillFile* spill = spill_open();
+    check(spill == NULL, "spill: followed a symlinked directory");
+    spill_close(spill);
+    unlink(dir);
+
+    mkdir(dir, 0700);
+    chmod(dir, 0777);
+    spill = spill_open();
+    check(spill == NULL, "spill: used a world-writable directory");
+    spill_close(spill);
+
+    chmod(dir, 0700);
+    spill = spill_open();
+    check(spill != NULL, "spill: refused a private directory");
+    spill_close(spill);
+
+    rmdir(dir);
+    rmdir(target);
+    rmdir(root);
+    if (old) setenv("XDG_RUNTIME_DIR", old, 1);
+    else unsetenv("XDG_RUNTIME_DIR");
+    free(old);
+}
+
+int main(void) {
+    test_style_ids_reused();
+    test_style_ids_kept_for_cold_scrollback();
+    test_truecolor_rounded_when_table_full();
+    test_delete_line_skips_history();
+    test_clear_history_keeps_screen();
+    test_resize_after_history_cleared();
+    test_flood_keeps_history();
+    test_spill_refuses_shared_dir();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}